@@ -0,0 +1,460 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QSet>
+#include <QDebug>
+
+#ifdef Q_OS_LINUX
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+#include "opencv2/opencv.hpp"
+#include "utilities.h"
+#include "metrics.h"
+#include "libav_writer.h"
+#include "keyframe_index.h"
+#include "archive_transcoder.h"
+
+namespace {
+const char *TIER = "archivo";
+const AVRational MILLISECONDS = {1, 1000};
+
+// Grabaciones que quedaron más grandes al recodificar: no se reintentan
+QSet<QString> not_worth_it;
+
+// Duración del video según el contenedor, en ms; -1 si no se puede abrir
+qint64 durationMs(const QString &path)
+{
+    AVFormatContext *format = nullptr;
+    if (avformat_open_input(&format, path.toUtf8().constData(), nullptr, nullptr) < 0)
+        return -1;
+    qint64 duration = -1;
+    if (avformat_find_stream_info(format, nullptr) >= 0 && format->duration != AV_NOPTS_VALUE)
+        duration = av_rescale_q(format->duration, AV_TIME_BASE_Q, MILLISECONDS);
+    avformat_close_input(&format);
+    return duration;
+}
+
+// fsync de un archivo o de una carpeta (para que un rename quede en disco)
+bool syncPath(const QString &path)
+{
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    const bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+bool isArchived(const QString &path)
+{
+    AVFormatContext *format = nullptr;
+    if (avformat_open_input(&format, path.toUtf8().constData(), nullptr, nullptr) < 0)
+    {
+        return false;
+    }
+    const AVDictionaryEntry *tier = av_dict_get(format->metadata, "nivel", nullptr, 0);
+    const bool archived = tier != nullptr && QString(tier->value) == TIER;
+    avformat_close_input(&format);
+    return archived;
+}
+
+// La fecha de la grabación está en el nombre (ver Utilities::newSavedVideoName)
+QDateTime recordedAt(const QFileInfo &video)
+{
+    QDateTime time = QDateTime::fromString(video.completeBaseName(), "yyyy-MM-dd+HH:mm:ss");
+    return time.isValid() ? time : video.lastModified();
+}
+
+// Alguna cámara de este proceso descartando trabajo por sobrecarga
+bool camerasUnderPressure()
+{
+    const QJsonObject values = Metrics::snapshot();
+    for (auto it = values.begin(); it != values.end(); ++it)
+    {
+        if (it.key().endsWith(".nivel_carga") && it.value().toString() != "normal")
+            return true;
+    }
+    return false;
+}
+}
+
+ArchiveTranscoder::ArchiveTranscoder(QObject *parent) :
+    QThread(parent), last_total(0), last_busy(0), last_own_ns(0), stopping(false)
+{
+    settings = readSettings();
+}
+
+ArchiveTranscoder::~ArchiveTranscoder()
+{
+    stop();
+}
+
+bool ArchiveTranscoder::enabledInConfig()
+{
+    return Utilities::getParamInt("archivo_dias", 0) > 0;
+}
+
+ArchiveTranscoder::Settings ArchiveTranscoder::readSettings()
+{
+    Settings s;
+    s.days = Utilities::getParamInt("archivo_dias", 0);
+    s.width = qMax(64, Utilities::getParamInt("archivo_ancho", 640));
+    s.fps = Utilities::getParamDouble("archivo_fps", 0);
+    s.crf = Utilities::getParamInt("archivo_crf", 32);
+    s.preset = Utilities::getParam("archivo_preset");
+    if (s.preset.isEmpty())
+        s.preset = "medium";
+    s.cpu_max = Utilities::getParamInt("archivo_cpu_max", 50);
+    s.interval_min = qMax(1, Utilities::getParamInt("archivo_revision_min", 30));
+    return s;
+}
+
+int ArchiveTranscoder::runCli()
+{
+    ArchiveTranscoder transcoder;
+    if (transcoder.settings.days <= 0)
+    {
+        qWarning() << "archivo_dias no está configurado";
+        return 1;
+    }
+    lowerPriority();
+    transcoder.othersCpuPercent();
+    qDebug() << "Grabaciones archivadas:" << transcoder.scan();
+    return 0;
+}
+
+void ArchiveTranscoder::stop()
+{
+    {
+        QMutexLocker locker(&lock);
+        stopping = true;
+        wake.wakeAll();
+    }
+    wait();
+}
+
+// CPU con SCHED_IDLE (solo usa lo que nadie más pide) y disco en la clase idle
+void ArchiveTranscoder::lowerPriority()
+{
+#ifdef Q_OS_LINUX
+    const pid_t tid = pid_t(syscall(SYS_gettid));
+    struct sched_param param = {};
+    if (sched_setscheduler(tid, SCHED_IDLE, &param) != 0)
+    {
+        setpriority(PRIO_PROCESS, id_t(tid), 19);
+    }
+    const int IOPRIO_WHO_PROCESS = 1;
+    const int IOPRIO_CLASS_IDLE = 3;
+    const int IOPRIO_CLASS_SHIFT = 13;
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+#endif
+}
+
+void ArchiveTranscoder::run()
+{
+    lowerPriority();
+    othersCpuPercent(); // primera muestra
+    QMutexLocker locker(&lock);
+    while (!stopping)
+    {
+        locker.unlock();
+        scan();
+        locker.relock();
+        if (!stopping)
+            wake.wait(&lock, ulong(settings.interval_min) * 60 * 1000);
+    }
+}
+
+int ArchiveTranscoder::scan()
+{
+    QDir dir(Utilities::getDataPath());
+    const QFileInfoList videos = dir.entryInfoList(QStringList() << "*.mp4", QDir::Files, QDir::Name);
+    const QDateTime limit = QDateTime::currentDateTime().addDays(-settings.days);
+    int archived = 0;
+    foreach (const QFileInfo &video, videos)
+    {
+        if (recordedAt(video) > limit)
+            break; // ordenadas por nombre = por fecha
+        const QString name = video.completeBaseName();
+        if (not_worth_it.contains(name) || isArchived(video.filePath()))
+            continue;
+        if (!waitForIdleCpu())
+            break;
+        if (transcode(name))
+            archived++;
+    }
+    return archived;
+}
+
+bool ArchiveTranscoder::transcode(const QString &name)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const QString path = Utilities::getSavedVideoPath(name, "mp4");
+    const QString temp_path = Utilities::getSavedVideoPath("." + name + "." + TIER, "mp4");
+
+    AVFormatContext *format = nullptr;
+    AVCodecContext *codec = nullptr;
+    AVFrame *decoded = av_frame_alloc();
+    AVPacket *packet = av_packet_alloc();
+    SwsContext *scaler = nullptr;
+    LibavWriter writer;
+    bool ok = false;
+    bool aborted = false;
+    double frame_ms = 1000.0 / 30; // intervalo de la salida
+
+    int s = -1;
+    const AVCodec *decoder = nullptr;
+    if (avformat_open_input(&format, path.toUtf8().constData(), nullptr, nullptr) >= 0 &&
+        avformat_find_stream_info(format, nullptr) >= 0)
+    {
+        s = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, &decoder, 0);
+    }
+    if (s >= 0 && decoder != nullptr)
+    {
+        codec = avcodec_alloc_context3(decoder);
+        avcodec_parameters_to_context(codec, format->streams[s]->codecpar);
+        codec->thread_count = 1; // en segundo plano: no competir con las cámaras
+        if (avcodec_open2(codec, decoder, nullptr) < 0)
+            avcodec_free_context(&codec);
+    }
+
+    if (codec != nullptr)
+    {
+        AVStream *stream = format->streams[s];
+        const int64_t start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+
+        // Tasa nominal de la grabación (VFR: la deja LibavWriter en los metadatos)
+        double source_fps = av_q2d(stream->avg_frame_rate.num > 0 ? stream->avg_frame_rate : stream->r_frame_rate);
+        const AVDictionaryEntry *nominal = av_dict_get(format->metadata, "fps", nullptr, 0);
+        if (nominal != nullptr && atof(nominal->value) > 0)
+            source_fps = atof(nominal->value);
+        if (source_fps <= 0)
+            source_fps = 30;
+
+        LibavWriter::Options options;
+        options.fps = settings.fps > 0 ? qMin(settings.fps, source_fps) : source_fps;
+        const int width = qMin(settings.width, codec->width) & ~1;
+        options.size = cv::Size(width, int(int64_t(codec->height) * width / qMax(1, codec->width)) & ~1);
+        options.gop = qMax(1, qRound(options.fps));
+        options.preset = settings.preset;
+        options.crf = settings.crf;
+        options.threads = 1;
+        options.tier = TIER;
+        options.storage = StorageFile::optionsFromConfig(true); // de fondo: no le quita disco a las grabaciones
+
+        cv::Mat bgr(options.size, CV_8UC3);
+        frame_ms = 1000.0 / options.fps;
+        double next_ms = 0; // con archivo_fps menor se saltean frames
+        QElapsedTimer since_check;
+        since_check.start();
+
+        ok = writer.open(temp_path, options);
+        bool draining = false;
+        while (ok && !aborted)
+        {
+            int r = avcodec_receive_frame(codec, decoded);
+            if (r == AVERROR(EAGAIN) && !draining)
+            {
+                // Solo el fin del archivo vacía el decoder; cualquier otro error
+                // deja la recodificación incompleta y no se usa
+                const int read = av_read_frame(format, packet);
+                if (read == AVERROR_EOF)
+                {
+                    avcodec_send_packet(codec, nullptr);
+                    draining = true;
+                }
+                else if (read < 0)
+                {
+                    ok = false;
+                }
+                else
+                {
+                    if (packet->stream_index == s && avcodec_send_packet(codec, packet) < 0)
+                        ok = false;
+                    av_packet_unref(packet);
+                }
+                continue;
+            }
+            if (r == AVERROR_EOF)
+            {
+                break;
+            }
+            if (r < 0)
+            {
+                ok = false;
+                break;
+            }
+
+            const int64_t pts = decoded->best_effort_timestamp;
+            const qint64 pts_ms = pts == AV_NOPTS_VALUE ? qint64(next_ms)
+                                                        : av_rescale_q(pts - start, stream->time_base, MILLISECONDS);
+            if (pts_ms + 0.5 >= next_ms)
+            {
+                next_ms = qMax(next_ms + frame_ms, pts_ms + frame_ms * 0.5);
+                scaler = sws_getCachedContext(scaler, decoded->width, decoded->height, AVPixelFormat(decoded->format),
+                                              bgr.cols, bgr.rows, AV_PIX_FMT_BGR24, SWS_BILINEAR,
+                                              nullptr, nullptr, nullptr);
+                uint8_t *dst[1] = {bgr.data};
+                int dst_stride[1] = {int(bgr.step)};
+                if (scaler == nullptr)
+                {
+                    ok = false;
+                }
+                else
+                {
+                    sws_scale(scaler, decoded->data, decoded->linesize, 0, decoded->height, dst, dst_stride);
+                    ok = writer.write(bgr, pts_ms);
+                }
+            }
+            av_frame_unref(decoded);
+
+            if (since_check.elapsed() >= 1000)
+            {
+                aborted = !waitForIdleCpu();
+                since_check.restart();
+            }
+        }
+        writer.release();
+    }
+
+    sws_freeContext(scaler);
+    av_packet_free(&packet);
+    av_frame_free(&decoded);
+    avcodec_free_context(&codec);
+    avformat_close_input(&format);
+
+    const qint64 before = QFileInfo(path).size();
+    const qint64 after = QFileInfo(temp_path).size();
+    if (!ok || aborted || after <= 0)
+    {
+        QFile::remove(temp_path);
+        if (!aborted)
+            qWarning() << "No se pudo archivar" << name;
+        return false;
+    }
+    // La recodificación tiene que durar lo mismo que la original (hasta un par
+    // de frames de diferencia) antes de reemplazarla
+    const qint64 source_ms = durationMs(path);
+    const qint64 archived_ms = durationMs(temp_path);
+    const qint64 tolerance_ms = qint64(2 * frame_ms) + 100;
+    if (source_ms < 0 || archived_ms < 0 || qAbs(source_ms - archived_ms) > tolerance_ms)
+    {
+        QFile::remove(temp_path);
+        qWarning() << "Archivar" << name << ": la duración no coincide" << source_ms << "ms contra"
+                   << archived_ms << "ms, se deja la original";
+        return false;
+    }
+    if (after >= before)
+    {
+        QFile::remove(temp_path);
+        not_worth_it.insert(name);
+        qDebug() << "Archivar" << name << "no reduce el tamaño, se deja como está";
+        return false;
+    }
+
+    // rename() reemplaza de forma atómica: nunca falta el archivo en el catálogo.
+    // Antes el contenido nuevo tiene que estar en disco, y después la carpeta,
+    // para que un corte de luz no deje un archivo truncado en lugar del original.
+    if (!syncPath(temp_path))
+    {
+        QFile::remove(temp_path);
+        qWarning() << "No se pudo sincronizar" << temp_path;
+        return false;
+    }
+    if (::rename(QFile::encodeName(temp_path).constData(), QFile::encodeName(path).constData()) != 0)
+    {
+        QFile::remove(temp_path);
+        qWarning() << "No se pudo reemplazar" << path;
+        return false;
+    }
+    syncPath(QFileInfo(path).absolutePath());
+    KeyframeIndex index;
+    index.loadOrBuild(name); // el mp4 nuevo es más reciente que el .kfi: se regenera
+
+    Metrics::add("archivo.grabaciones", 1);
+    Metrics::add("archivo.bytes_liberados", double(before - after));
+    qDebug().noquote() << QString("Archivado %1: %2 MB -> %3 MB en %4 s")
+                          .arg(name).arg(before / 1e6, 0, 'f', 1).arg(after / 1e6, 0, 'f', 1)
+                          .arg(timer.elapsed() / 1000);
+    return true;
+}
+
+bool ArchiveTranscoder::waitForIdleCpu()
+{
+    QMutexLocker locker(&lock);
+    bool paused = false;
+    while (!stopping)
+    {
+        locker.unlock();
+        const bool busy = othersCpuPercent() > settings.cpu_max || camerasUnderPressure();
+        locker.relock();
+        if (!busy)
+            break;
+        if (!paused)
+        {
+            paused = true;
+            Metrics::set("archivo.pausado", 1);
+        }
+        wake.wait(&lock, 2000);
+    }
+    if (paused)
+        Metrics::set("archivo.pausado", 0);
+    return !stopping;
+}
+
+// CPU usada por todo el sistema menos este hilo desde la muestra anterior
+double ArchiveTranscoder::othersCpuPercent()
+{
+#ifdef Q_OS_LINUX
+    FILE *stat = fopen("/proc/stat", "r");
+    if (stat == nullptr)
+    {
+        return 0;
+    }
+    unsigned long long user = 0, nice = 0, system = 0, idle = 0, iowait = 0, irq = 0, softirq = 0, steal = 0;
+    const int fields = fscanf(stat, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+                              &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal);
+    fclose(stat);
+    if (fields < 4)
+    {
+        return 0;
+    }
+    const uint64_t total = user + nice + system + idle + iowait + irq + softirq + steal;
+    const uint64_t busy = total - idle - iowait;
+
+    struct timespec own;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &own);
+    const int64_t own_ns = int64_t(own.tv_sec) * 1000000000 + own.tv_nsec;
+
+    double percent = 0;
+    if (last_total != 0 && total > last_total)
+    {
+        const double own_ticks = double(own_ns - last_own_ns) * sysconf(_SC_CLK_TCK) / 1e9;
+        percent = qMax(0.0, (double(busy - last_busy) - own_ticks) * 100.0 / double(total - last_total));
+    }
+    last_total = total;
+    last_busy = busy;
+    last_own_ns = own_ns;
+    return percent;
+#else
+    return 0;
+#endif
+}
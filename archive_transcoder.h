@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+
+// Pasa las grabaciones viejas a un nivel "archivo" más liviano para que
+// entren más días en el mismo disco.
+//
+// Cada archivo_revision_min minutos busca los mp4 con más de archivo_dias
+// días que todavía no tengan el metadato nivel=archivo y los recodifica
+// (archivo_ancho, archivo_fps, archivo_crf, archivo_preset) conservando los
+// tiempos de cada frame, así que .evt, .trk y miniaturas siguen valiendo. El
+// resultado se escribe con nombre temporal y reemplaza al original con un
+// rename(): quien tenga el archivo abierto sigue leyendo el viejo.
+//
+// Corre en un hilo con prioridad idle (CPU y disco) y se detiene mientras el
+// resto del sistema use más de archivo_cpu_max % de CPU o alguna cámara de
+// este proceso esté descartando trabajo (ver LoadShedder).
+class ArchiveTranscoder : public QThread
+{
+public:
+    explicit ArchiveTranscoder(QObject *parent = nullptr);
+    ~ArchiveTranscoder();
+
+    // archivo_dias > 0 en config.cfg
+    static bool enabledInConfig();
+
+    // Una pasada completa en el hilo actual (modo "qtvcr archivar")
+    static int runCli();
+
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    struct Settings
+    {
+        int days;
+        int width;
+        double fps;       // 0 = igual que el original
+        int crf;
+        QString preset;
+        int cpu_max;      // % de CPU del resto del sistema
+        int interval_min;
+    };
+
+    static Settings readSettings();
+    static void lowerPriority();
+
+    // Devuelve la cantidad de grabaciones recodificadas
+    int scan();
+    bool transcode(const QString &name);
+    // Bloquea mientras la CPU esté ocupada. false si hay que terminar.
+    bool waitForIdleCpu();
+    double othersCpuPercent();
+
+    Settings settings;
+
+    // Muestras de /proc/stat y del tiempo de CPU de este hilo
+    uint64_t last_total;
+    uint64_t last_busy;
+    int64_t last_own_ns;
+
+    QMutex lock;
+    QWaitCondition wake;
+    bool stopping;
+};
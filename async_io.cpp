@@ -0,0 +1,335 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <QFile>
+#include <QDebug>
+
+#include "utilities.h"
+#include "metrics.h"
+#include "thread_placement.h"
+#include "async_io.h"
+
+namespace {
+bool writeAll(int fd, qint64 offset, const char *data, qint64 size)
+{
+    while (size > 0)
+    {
+        const ssize_t n = ::pwrite(fd, data, size_t(size), off_t(offset));
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += n;
+        offset += n;
+        size -= n;
+    }
+    return true;
+}
+
+void report(const QString &path, const char *operation)
+{
+    qWarning() << "E/S:" << operation << path << ":" << strerror(errno);
+    Metrics::add("io.errores", 1);
+}
+}
+
+AsyncIO *AsyncIO::instance()
+{
+    static AsyncIO *service = nullptr;
+    static QMutex create_lock;
+    QMutexLocker locker(&create_lock);
+    if (service == nullptr)
+    {
+        service = new AsyncIO();
+    }
+    return service;
+}
+
+AsyncIO::AsyncIO() :
+    memory("io.cola", MemoryBudget::ESSENTIAL), pending(0), pending_bytes(0)
+{
+    pool.setMaxThreadCount(qMax(1, Utilities::getParamInt("io_hilos", 2)));
+    max_pending_bytes = qint64(qMax(1, Utilities::getParamInt("io_cola_max_mb", 64))) * 1024 * 1024;
+}
+
+void AsyncIO::write(const QString &path, qint64 offset, const QByteArray &data, Callback done)
+{
+    enqueue(path, Op{Op::WRITE, offset, data, QString(), nullptr, done});
+}
+
+void AsyncIO::replace(const QString &path, const QByteArray &data, Callback done)
+{
+    enqueue(path, Op{Op::REPLACE, 0, data, QString(), nullptr, done});
+}
+
+void AsyncIO::truncate(const QString &path, qint64 size, Callback done)
+{
+    enqueue(path, Op{Op::TRUNCATE, size, QByteArray(), QString(), nullptr, done});
+}
+
+void AsyncIO::sync(const QString &path, Callback done)
+{
+    enqueue(path, Op{Op::SYNC, 0, QByteArray(), QString(), nullptr, done});
+}
+
+void AsyncIO::rename(const QString &from, const QString &to, Callback done)
+{
+    // El destino queda bloqueado hasta que el rename se ejecute
+    std::shared_ptr<bool> released = std::make_shared<bool>(false);
+    enqueue(to, Op{Op::WAIT, 0, QByteArray(), QString(), released, Callback()});
+    enqueue(from, Op{Op::RENAME, 0, QByteArray(), to, released, done});
+}
+
+void AsyncIO::remove(const QString &path, Callback done)
+{
+    enqueue(path, Op{Op::REMOVE, 0, QByteArray(), QString(), nullptr, done});
+}
+
+void AsyncIO::close(const QString &path, Callback done)
+{
+    enqueue(path, Op{Op::CLOSE, 0, QByteArray(), QString(), nullptr, done});
+}
+
+void AsyncIO::waitFor(const QStringList &paths)
+{
+    QMutexLocker locker(&lock);
+    while (true)
+    {
+        bool busy = false;
+        foreach (const QString &path, paths)
+        {
+            auto it = files.find(path);
+            if (it != files.end() && (it->second.scheduled || !it->second.ops.empty()))
+                busy = true;
+        }
+        if (!busy)
+            return;
+        idle.wait(&lock);
+    }
+}
+
+void AsyncIO::waitForIdle()
+{
+    QMutexLocker locker(&lock);
+    while (pending > 0)
+    {
+        idle.wait(&lock);
+    }
+}
+
+void AsyncIO::enqueue(const QString &path, Op op)
+{
+    // Lo encolado es memoria que no se puede perder: si el presupuesto está lleno se espera
+    if (!op.data.isEmpty())
+        memory.reserve(op.data.size());
+    QMutexLocker locker(&lock);
+    while (pending_bytes > max_pending_bytes)
+    {
+        space.wait(&lock);
+    }
+    pending_bytes += op.data.size();
+    FileState &state = files[path];
+    state.ops.push_back(std::move(op));
+    pending++;
+    schedule(path, state);
+}
+
+// Con lock tomado
+void AsyncIO::schedule(const QString &path, FileState &state)
+{
+    if (state.scheduled || state.ops.empty())
+    {
+        return;
+    }
+    state.scheduled = true;
+    pool.start([this, path]() { drain(path); });
+}
+
+// Ejecuta todo lo encolado para el archivo. Solo una tarea por archivo a la vez
+// (scheduled), así que el descriptor no necesita más protección.
+void AsyncIO::drain(const QString &path)
+{
+    ThreadPlacement::applyOnce(ThreadPlacement::IO);
+    QMutexLocker locker(&lock);
+    FileState &state = files[path];
+    while (true)
+    {
+        std::vector<Op> batch;
+        while (!state.ops.empty())
+        {
+            Op &front = state.ops.front();
+            if (front.type == Op::WAIT && !*front.released)
+                break;
+            batch.push_back(std::move(front));
+            state.ops.pop_front();
+        }
+        if (batch.empty())
+        {
+            state.scheduled = false;
+            if (state.ops.empty() && state.fd < 0)
+                files.erase(path);
+            idle.wakeAll();
+            return;
+        }
+
+        int fd = state.fd;
+        locker.unlock();
+        execute(path, fd, batch);
+        locker.relock();
+        state.fd = fd;
+        pending -= int(batch.size());
+        qint64 batch_bytes = 0;
+        for (size_t i = 0; i < batch.size(); i++)
+            batch_bytes += batch[i].data.size();
+        pending_bytes -= batch_bytes;
+        memory.release(batch_bytes);
+        space.wakeAll();
+        idle.wakeAll();
+        Metrics::set("io.pendientes", pending);
+    }
+}
+
+void AsyncIO::execute(const QString &path, int &fd, std::vector<Op> &batch)
+{
+    const QByteArray file = QFile::encodeName(path);
+    std::vector<Callback> synced;
+    bool sync_pending = false;
+
+    auto openForWrite = [&](int flags) {
+        if (fd < 0)
+            fd = ::open(file.constData(), O_WRONLY | O_CLOEXEC | flags, 0644);
+        return fd >= 0;
+    };
+    auto closeFile = [&]() {
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+    };
+    // Un solo fdatasync para todos los sync acumulados
+    auto flushSync = [&]() {
+        if (!sync_pending)
+            return;
+        const bool ok = fd < 0 || ::fdatasync(fd) == 0;
+        if (!ok)
+            report(path, "fdatasync");
+        for (size_t k = 0; k < synced.size(); k++)
+        {
+            if (synced[k])
+                synced[k](ok);
+        }
+        synced.clear();
+        sync_pending = false;
+    };
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        Op &op = batch[i];
+        bool ok = true;
+        switch (op.type)
+        {
+        case Op::WAIT:
+            break;
+
+        case Op::REPLACE:
+            flushSync();
+            closeFile();
+            ok = openForWrite(O_CREAT | O_TRUNC) && writeAll(fd, 0, op.data.constData(), op.data.size());
+            if (!ok)
+                report(path, "replace");
+            Metrics::add("io.bytes", op.data.size());
+            break;
+
+        case Op::WRITE:
+        {
+            if (!openForWrite(O_CREAT))
+            {
+                report(path, "open");
+                ok = false;
+                break;
+            }
+            const qint64 offset = op.offset >= 0 ? op.offset : qint64(::lseek(fd, 0, SEEK_END));
+            // Escrituras contiguas seguidas: un solo pwrite. Una escritura "al
+            // final" solo se une a una tanda que también empezó al final (si la
+            // tanda escribe en el medio del archivo, el final está en otro lado)
+            const bool appending = op.offset < 0;
+            qint64 end = offset + op.data.size();
+            size_t last = i;
+            while (last + 1 < batch.size() && batch[last + 1].type == Op::WRITE &&
+                   (batch[last + 1].offset < 0 ? appending : batch[last + 1].offset == end))
+            {
+                last++;
+                end += batch[last].data.size();
+            }
+            if (last == i)
+            {
+                ok = writeAll(fd, offset, op.data.constData(), op.data.size());
+            }
+            else
+            {
+                QByteArray joined;
+                joined.reserve(int(end - offset));
+                for (size_t k = i; k <= last; k++)
+                    joined.append(batch[k].data);
+                ok = writeAll(fd, offset, joined.constData(), joined.size());
+            }
+            if (!ok)
+                report(path, "write");
+            Metrics::add("io.bytes", double(end - offset));
+            for (size_t k = i; k < last; k++)
+            {
+                if (batch[k].done)
+                    batch[k].done(ok);
+            }
+            i = last;
+            break;
+        }
+
+        case Op::TRUNCATE:
+            ok = openForWrite(O_CREAT) && ::ftruncate(fd, off_t(op.offset)) == 0;
+            if (!ok)
+                report(path, "truncate");
+            break;
+
+        case Op::SYNC:
+            if (fd < 0)
+                fd = ::open(file.constData(), O_WRONLY | O_CLOEXEC);
+            sync_pending = true;
+            synced.push_back(op.done);
+            continue; // el callback va con el fdatasync
+
+        case Op::RENAME:
+        {
+            flushSync();
+            closeFile();
+            ok = ::rename(file.constData(), QFile::encodeName(op.target).constData()) == 0;
+            if (!ok)
+                report(path, "rename");
+            QMutexLocker locker(&lock);
+            *op.released = true;
+            auto it = files.find(op.target);
+            if (it != files.end())
+                schedule(op.target, it->second);
+            break;
+        }
+
+        case Op::REMOVE:
+            flushSync();
+            closeFile();
+            ok = ::unlink(file.constData()) == 0 || errno == ENOENT;
+            if (!ok)
+                report(path, "unlink");
+            break;
+
+        case Op::CLOSE:
+            flushSync();
+            closeFile();
+            break;
+        }
+        if (batch[i].done)
+            batch[i].done(ok);
+    }
+    flushSync();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadPool>
+#include "memory_budget.h"
+
+// Escrituras a disco fuera de los hilos de captura y detección.
+//
+// Cualquier hilo encola operaciones (write, replace, truncate, sync, rename,
+// remove, close) sobre un archivo y sigue; un pool chico (io_hilos) las
+// ejecuta. Las operaciones de un mismo archivo se ejecutan en el orden en que
+// se pidieron y nunca en paralelo; archivos distintos avanzan en paralelo.
+// Lo pedido después de un rename sobre el destino espera a que el rename
+// termine.
+//
+// Mientras un archivo tiene trabajo encolado se agrupa: las escrituras
+// contiguas van en un solo pwrite y varios sync seguidos en un solo
+// fdatasync.
+//
+// El callback (opcional) se llama desde el hilo de E/S con el resultado.
+// Si el disco no da abasto y lo encolado pasa de io_cola_max_mb, quien
+// encola espera: es preferible a crecer sin límite. Lo mismo si se llena el
+// presupuesto de memoria global (io.cola, ver memory_budget.h).
+class AsyncIO
+{
+public:
+    typedef std::function<void(bool ok)> Callback;
+
+    static AsyncIO *instance();
+
+    // Escribe en offset (-1 = al final). Crea el archivo si no existe.
+    void write(const QString &path, qint64 offset, const QByteArray &data, Callback done = Callback());
+    // Trunca (o crea) el archivo y escribe data
+    void replace(const QString &path, const QByteArray &data, Callback done = Callback());
+    void truncate(const QString &path, qint64 size, Callback done = Callback());
+    void sync(const QString &path, Callback done = Callback());
+    void rename(const QString &from, const QString &to, Callback done = Callback());
+    void remove(const QString &path, Callback done = Callback());
+    // Cierra el descriptor; las siguientes operaciones lo vuelven a abrir
+    void close(const QString &path, Callback done = Callback());
+
+    // Bloquea hasta que no quede nada encolado para esos archivos
+    void waitFor(const QStringList &paths);
+    // Bloquea hasta que no quede nada encolado (al salir, benchmarks)
+    void waitForIdle();
+
+private:
+    AsyncIO();
+
+    struct Op
+    {
+        enum Type { WRITE, REPLACE, TRUNCATE, SYNC, RENAME, REMOVE, CLOSE, WAIT };
+        Type type;
+        qint64 offset;
+        QByteArray data;
+        QString target;                  // RENAME: destino
+        std::shared_ptr<bool> released;  // WAIT: lo libera el rename
+        Callback done;
+    };
+    struct FileState
+    {
+        int fd = -1;
+        bool scheduled = false;
+        std::deque<Op> ops;
+    };
+
+    void enqueue(const QString &path, Op op);
+    void schedule(const QString &path, FileState &state);
+    void drain(const QString &path);
+    void execute(const QString &path, int &fd, std::vector<Op> &batch);
+
+    QThreadPool pool;
+    MemoryBudget::Account memory; // lo encolado, en el presupuesto de memoria
+    QMutex lock;
+    QWaitCondition idle;
+    QWaitCondition space;
+    std::map<QString, FileState> files;
+    int pending;
+    qint64 pending_bytes;
+    qint64 max_pending_bytes;
+};
@@ -0,0 +1,528 @@
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <QtConcurrent>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QDateTime>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "benchmarks.h"
+#include "frame_kernels.h"
+#include "utilities.h"
+#include "detection_service.h"
+#include "detection_index.h"
+#include "async_io.h"
+#include "storage_file.h"
+#include "mjpeg_decoder.h"
+
+int Benchmarks::run(const QString &name)
+{
+    if (name == "convert")
+    {
+        return frameConversion();
+    }
+    if (name == "batch")
+    {
+        return detectionBatching();
+    }
+    if (name == "indice")
+    {
+        return detectionIndex();
+    }
+    if (name == "almacenamiento")
+    {
+        return storage();
+    }
+    if (name == "mjpeg")
+    {
+        return mjpegDecoding();
+    }
+    qWarning() << "Benchmark desconocido:" << name << "- disponibles: convert, batch, indice, almacenamiento, mjpeg";
+    return 1;
+}
+
+/*
+ * Compara lo que costaba con OpenCV obtener las mismas salidas contra
+ * FrameConverter. La vista previa a tamaño completo se pasaba a RGB en cada
+ * frame (BGR2RGB) y la reducida se saca directo del BGR; el gris y sus
+ * reducciones solo cuando el caso los pide.
+ */
+int Benchmarks::frameConversion()
+{
+    const int iterations = 200;
+    cv::Mat frame(1080, 1920, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+
+    struct Case
+    {
+        const char *name;
+        int preview, detection, motion;
+    };
+    const Case cases[] = {
+        {"preview 1/1 + deteccion 1/1", 1, 1, 0},
+        {"preview 1/2 + deteccion 1/2 + movimiento 1/8", 2, 2, 8},
+        {"solo movimiento 1/8", 1, 0, 8},
+    };
+
+    for (const Case &c : cases)
+    {
+        cv::Mat rgb, gray, preview, detection, motion;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < iterations; i++)
+        {
+            if (c.preview == 1)
+                cv::cvtColor(frame, rgb, cv::COLOR_BGR2RGB);
+            else
+                cv::resize(frame, preview, cv::Size(frame.cols / c.preview, frame.rows / c.preview), 0, 0, cv::INTER_AREA);
+            if (c.detection > 0 || c.motion > 0)
+                cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+            if (c.detection > 1)
+                cv::resize(gray, detection, cv::Size(frame.cols / c.detection, frame.rows / c.detection), 0, 0, cv::INTER_AREA);
+            if (c.motion > 0)
+                cv::resize(gray, motion, cv::Size(frame.cols / c.motion, frame.rows / c.motion), 0, 0, cv::INTER_AREA);
+        }
+        double opencv_ms = timer.nsecsElapsed() / 1e6 / iterations;
+
+        FrameConverter converter;
+        converter.configure(c.preview, c.detection, c.motion);
+        timer.restart();
+        for (int i = 0; i < iterations; i++)
+        {
+            converter.process(frame);
+        }
+        double fused_ms = timer.nsecsElapsed() / 1e6 / iterations;
+
+        qDebug().noquote() << QString("%1: OpenCV %2 ms/frame, una pasada %3 ms/frame (x%4)")
+                              .arg(c.name)
+                              .arg(opencv_ms, 0, 'f', 3)
+                              .arg(fused_ms, 0, 'f', 3)
+                              .arg(opencv_ms / fused_ms, 0, 'f', 2);
+    }
+    return 0;
+}
+
+/*
+ * Varias "cámaras" (hilos) piden detección sobre un frame cada una, como hace
+ * CaptureThread. Se compara un detector por cámara llamado en cada frame
+ * contra DetectionService, que junta los pedidos y los corre en lote.
+ * Usa el detector configurado para la cámara actual (HOG si no hay ninguno).
+ */
+int Benchmarks::detectionBatching()
+{
+    const int frames_per_camera = 50;
+    QString camera_key = Utilities::getParam("current");
+    if (camera_key.isEmpty())
+    {
+        camera_key = "cam1";
+    }
+
+    DetectionService *service = DetectionService::instance();
+    const bool gray = service->acquire(camera_key)->inputFormat() == Detector::GRAY;
+    cv::Mat frame = gray ? cv::Mat(360, 640, CV_8UC1) : cv::Mat(720, 1280, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+
+    const int camera_counts[] = {1, 4, 8, 16};
+    for (int cameras : camera_counts)
+    {
+        QThreadPool threads;
+        threads.setMaxThreadCount(cameras);
+
+        // Un detector por cámara, una llamada por frame
+        std::vector<Detector *> own(cameras);
+        for (int c = 0; c < cameras; c++)
+        {
+            own[c] = Detector::create(camera_key);
+        }
+        QElapsedTimer timer;
+        timer.start();
+        for (int c = 0; c < cameras; c++)
+        {
+            Detector *detector = own[c];
+            QtConcurrent::run(&threads, [detector, frame, frames_per_camera]() {
+                std::vector<cv::Mat> images(1, frame);
+                std::vector<std::vector<Detection>> results;
+                for (int i = 0; i < frames_per_camera; i++)
+                    detector->detect(images, results);
+            });
+        }
+        threads.waitForDone();
+        double direct_fps = cameras * frames_per_camera * 1000.0 / qMax<qint64>(1, timer.elapsed());
+        for (int c = 0; c < cameras; c++)
+        {
+            delete own[c];
+        }
+
+        // Todas las cámaras contra el servicio central
+        service->configure(Utilities::getParamInt("deteccion_latencia_max_ms", 10), cameras,
+                           Utilities::getParamInt("deteccion_hilos", qMax(1, QThread::idealThreadCount() / 2)));
+        timer.restart();
+        for (int c = 0; c < cameras; c++)
+        {
+            QtConcurrent::run(&threads, [service, camera_key, frame, frames_per_camera]() {
+                std::vector<cv::Mat> images(1, frame);
+                std::vector<std::vector<Detection>> results;
+                for (int i = 0; i < frames_per_camera; i++)
+                    service->detect(camera_key, images, results);
+            });
+        }
+        threads.waitForDone();
+        double batched_fps = cameras * frames_per_camera * 1000.0 / qMax<qint64>(1, timer.elapsed());
+
+        qDebug().noquote() << QString("%1 camaras: por frame %2 frames/s, en lote %3 frames/s (x%4)")
+                              .arg(cameras)
+                              .arg(direct_fps, 0, 'f', 1)
+                              .arg(batched_fps, 0, 'f', 1)
+                              .arg(batched_fps / direct_fps, 0, 'f', 2);
+    }
+    service->stop();
+    service->wait();
+    return 0;
+}
+
+/*
+ * Archivo sintético de detecciones (2 cámaras x 30 días, ~3.5 millones de
+ * registros) y consultas típicas: cuánto se tarda en escribirlo y cuánto
+ * del índice recorre cada búsqueda.
+ */
+int Benchmarks::detectionIndex()
+{
+    const int cameras = 2;
+    const int days = 30;
+    const int tracks_per_day = 200;
+    const int detection_interval_ms = 200;
+
+    QTemporaryDir root;
+    if (!root.isValid())
+    {
+        qWarning() << "No se pudo crear la carpeta temporal";
+        return 1;
+    }
+
+    const qint64 first_day = QDateTime(QDate::currentDate().addDays(-days), QTime(0, 0)).toMSecsSinceEpoch();
+    const cv::Size frame_size(1920, 1080);
+    cv::RNG rng(1234);
+    qint64 total = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int c = 0; c < cameras; c++)
+    {
+        DetectionIndexWriter writer;
+        writer.open(root.path(), QString("cam%1").arg(c + 1));
+        writer.setSession(1);
+        int track_id = 1;
+        for (int d = 0; d < days; d++)
+        {
+            const qint64 day_start = QDateTime::fromMSecsSinceEpoch(first_day).addDays(d).toMSecsSinceEpoch();
+            std::vector<qint64> starts(tracks_per_day);
+            for (int i = 0; i < tracks_per_day; i++)
+                starts[i] = day_start + qint64(rng.uniform(0.0, 1.0) * 86000000);
+            std::sort(starts.begin(), starts.end());
+
+            qint64 t = day_start;
+            for (int i = 0; i < tracks_per_day; i++)
+            {
+                // Una persona que camina entre 5 s y 3 min por la imagen
+                t = qMax(t, starts[i]);
+                const qint64 end = t + rng.uniform(5000, 180000);
+                std::vector<Detection> detection(1);
+                detection[0].track_id = track_id++;
+                detection[0].score = 0.8f;
+                cv::Point2f position(rng.uniform(0.f, 1700.f), rng.uniform(0.f, 700.f));
+                for (; t < end; t += detection_interval_ms)
+                {
+                    position.x = qBound(0.f, position.x + rng.uniform(-8.f, 8.f), 1700.f);
+                    position.y = qBound(0.f, position.y + rng.uniform(-8.f, 8.f), 700.f);
+                    detection[0].box = cv::Rect(int(position.x), int(position.y), 150, 350);
+                    writer.add(detection, frame_size, t);
+                    total++;
+                }
+            }
+        }
+        writer.close();
+    }
+    AsyncIO::instance()->waitForIdle();
+    qDebug().noquote() << QString("Escritura: %1 detecciones en %2 ms (%3 por segundo)")
+                          .arg(total).arg(timer.elapsed())
+                          .arg(qint64(total * 1000.0 / qMax<qint64>(1, timer.elapsed())));
+
+    DetectionIndex index(root.path());
+    const qint64 last_ms = first_day + qint64(days) * 24 * 3600 * 1000;
+    struct Case
+    {
+        const char *name;
+        const char *camera;
+        qint64 from_ms;
+        QRectF region;
+        qint64 dwell_ms;
+    };
+    const Case cases[] = {
+        {"todas, 30 dias, todo el cuadro, 60 s", "", first_day, QRectF(), 60000},
+        {"cam1, ultima semana, zona chica, 5 s", "cam1", last_ms - qint64(7) * 24 * 3600 * 1000, QRectF(0.1, 0.6, 0.1, 0.1), 5000},
+        {"cam2, ultimo dia, zona media, 0 s", "cam2", last_ms - qint64(24) * 3600 * 1000, QRectF(0.4, 0.4, 0.3, 0.3), 0},
+    };
+    for (const Case &c : cases)
+    {
+        DetectionIndex::Query q;
+        q.camera_key = c.camera;
+        q.from_ms = c.from_ms;
+        q.to_ms = last_ms;
+        q.region = c.region;
+        q.min_dwell_ms = c.dwell_ms;
+        DetectionIndex::Stats stats;
+        timer.restart();
+        std::vector<DetectionIndex::Hit> hits = index.query(q, &stats);
+        qDebug().noquote() << QString("%1: %2 resultados en %3 ms, %4 de %5 registros leidos")
+                              .arg(c.name).arg(hits.size()).arg(timer.nsecsElapsed() / 1e6, 0, 'f', 2)
+                              .arg(stats.records_scanned).arg(total);
+    }
+    return 0;
+}
+
+namespace {
+// Un campo de /proc/meminfo en MB
+double meminfoMB(const char *field)
+{
+    QFile file("/proc/meminfo");
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return 0;
+    }
+    foreach (const QByteArray &line, file.readAll().split('\n'))
+    {
+        if (line.startsWith(field))
+            return line.mid(int(strlen(field))).trimmed().split(' ').value(0).toDouble() / 1024;
+    }
+    return 0;
+}
+}
+
+/*
+ * Varias cámaras (hilos) escriben a la vez como lo hace LibavWriter (bloques
+ * de 256 KB secuenciales) en la carpeta de datos, que es el disco real de las
+ * grabaciones. Primero sin ajustes y después con los de StorageFile según
+ * config.cfg: MB/s, latencia de cada escritura y cache sucio al terminar.
+ */
+int Benchmarks::storage()
+{
+    const int cameras = 8;
+    const int64_t bytes_per_camera = int64_t(128) << 20;
+    const int block = 256 * 1024;
+
+    QTemporaryDir root(Utilities::getDataPath() + "/.bench-XXXXXX");
+    if (!root.isValid())
+    {
+        qWarning() << "No se pudo crear la carpeta temporal";
+        return 1;
+    }
+
+    struct Mode
+    {
+        const char *name;
+        StorageFile::Options options;
+    };
+    const Mode modes[] = {
+        {"sin ajustes", StorageFile::Options()},
+        {"StorageFile", StorageFile::optionsFromConfig()},
+    };
+    for (const Mode &mode : modes)
+    {
+        ::sync(); // cada modo arranca sin cache sucio del anterior
+        const double cached_before = meminfoMB("Cached:");
+
+        std::vector<std::vector<double>> latencies(cameras);
+        QThreadPool threads;
+        threads.setMaxThreadCount(cameras);
+        QElapsedTimer timer;
+        timer.start();
+        for (int c = 0; c < cameras; c++)
+        {
+            const QString path = root.filePath(QString("cam%1.mp4").arg(c + 1));
+            std::vector<double> *times = &latencies[c];
+            const StorageFile::Options options = mode.options;
+            QtConcurrent::run(&threads, [path, times, options, bytes_per_camera, block]() {
+                std::vector<uint8_t> data(size_t(block), 0x5a);
+                StorageFile file;
+                if (!file.open(path, options))
+                    return;
+                QElapsedTimer write_timer;
+                for (int64_t written = 0; written < bytes_per_camera; written += block)
+                {
+                    write_timer.start();
+                    file.write(data.data(), block);
+                    times->push_back(write_timer.nsecsElapsed() / 1e6);
+                }
+                file.close();
+            });
+        }
+        threads.waitForDone();
+        const double seconds = timer.nsecsElapsed() / 1e9;
+        const double dirty = meminfoMB("Dirty:");
+        const double cached = meminfoMB("Cached:") - cached_before;
+
+        std::vector<double> all;
+        for (const std::vector<double> &times : latencies)
+            all.insert(all.end(), times.begin(), times.end());
+        std::sort(all.begin(), all.end());
+        if (all.empty())
+        {
+            qWarning() << "No se pudo escribir en" << root.path();
+            return 1;
+        }
+        qDebug().noquote() << QString("%1: %2 MB/s, escritura p50 %3 ms p99 %4 ms max %5 ms, "
+                                      "cache sucio %6 MB, cache nuevo %7 MB")
+                              .arg(mode.name)
+                              .arg(cameras * double(bytes_per_camera) / (1 << 20) / seconds, 0, 'f', 1)
+                              .arg(all[all.size() / 2], 0, 'f', 2)
+                              .arg(all[all.size() * 99 / 100], 0, 'f', 2)
+                              .arg(all.back(), 0, 'f', 2)
+                              .arg(dirty, 0, 'f', 0)
+                              .arg(cached, 0, 'f', 0);
+        for (int c = 0; c < cameras; c++)
+            QFile::remove(root.filePath(QString("cam%1.mp4").arg(c + 1)));
+    }
+    return 0;
+}
+
+/*
+ * Decodificación de MJPEG de webcam: OpenCV (lo que hace V4L2 con CONVERT_RGB)
+ * y libjpeg-turbo entero, ambos seguidos de FrameConverter, contra
+ * libjpeg-turbo reducido en la IDCT + processScaled. Usa los JPEG volcados
+ * por la cámara actual (<cam>.mjpeg_volcado); si no hay, genera unos de prueba.
+ * También informa la diferencia media del gris de detección entre los caminos.
+ */
+int Benchmarks::mjpegDecoding()
+{
+    QString camera_key = Utilities::getParam("current");
+    if (camera_key.isEmpty())
+    {
+        camera_key = "cam1";
+    }
+
+    std::vector<cv::Mat> frames;
+    const QString dump = Utilities::getParam(camera_key + ".mjpeg_volcado");
+    if (!dump.isEmpty())
+    {
+        QDir dir(dump);
+        foreach (const QString &name, dir.entryList(QStringList() << "*.jpg", QDir::Files, QDir::Name))
+        {
+            QFile file(dir.filePath(name));
+            if (!file.open(QIODevice::ReadOnly))
+                continue;
+            const QByteArray data = file.readAll();
+            frames.push_back(cv::Mat(1, data.size(), CV_8UC1, (void *)data.constData()).clone());
+        }
+        qDebug().noquote() << QString("%1 frames de %2").arg(frames.size()).arg(dump);
+    }
+    if (frames.empty())
+    {
+        cv::Mat image(720, 1280, CV_8UC3);
+        cv::RNG rng(1234);
+        for (int i = 0; i < 30; i++)
+        {
+            cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+            cv::GaussianBlur(image, image, cv::Size(0, 0), 3);
+            cv::rectangle(image, cv::Rect(rng.uniform(0, 1100), rng.uniform(0, 400), 150, 300), cv::Scalar(40, 80, 200), -1);
+            std::vector<uchar> jpeg;
+            cv::imencode(".jpg", image, jpeg, std::vector<int>{cv::IMWRITE_JPEG_QUALITY, 85});
+            frames.push_back(cv::Mat(jpeg, true).reshape(1, 1));
+        }
+        qDebug().noquote() << "Sin volcado: 30 frames sinteticos de 1280x720";
+    }
+
+    MjpegDecoder decoder;
+    cv::Size full;
+    if (!decoder.size(frames[0], full))
+    {
+        qWarning() << "El primer frame no es un JPEG valido";
+        return 1;
+    }
+
+    struct Case
+    {
+        const char *name;
+        int preview, detection, motion;
+    };
+    const Case cases[] = {
+        {"preview 1/2 + deteccion 1/2 + movimiento 1/8", 2, 2, 8},
+        {"preview 1/4 + deteccion 1/4 + movimiento 1/8", 4, 4, 8},
+        {"deteccion 1/8 + movimiento 1/8", 0, 8, 8},
+    };
+    const int rounds = qMax(1, 300 / int(frames.size()));
+    for (const Case &c : cases)
+    {
+        FrameConverter converter;
+        converter.configure(c.preview, c.detection, c.motion);
+        int scale = 8;
+        const int factors[] = {converter.previewFactor(), converter.detectionFactor(), converter.motionFactor()};
+        for (int factor : factors)
+        {
+            if (factor > 0)
+                scale = qMin(scale, factor);
+        }
+
+        double ms[3] = {0, 0, 0};
+        double diff = 0;
+        bool same_size = true;
+        int count = 0;
+        QElapsedTimer timer;
+        for (int r = 0; r < rounds; r++)
+        {
+            for (const cv::Mat &jpeg : frames)
+            {
+                // Los tiempos se suman solo si los tres caminos decodificaron el
+                // frame: los promedios y la mejora son sobre los mismos frames
+                cv::Mat bgr, reference;
+                double frame_ms[3];
+                timer.start();
+                bgr = cv::imdecode(jpeg, cv::IMREAD_COLOR);
+                if (bgr.empty())
+                    continue;
+                converter.process(bgr);
+                frame_ms[0] = timer.nsecsElapsed() / 1e6;
+
+                timer.restart();
+                if (!decoder.decode(jpeg, 1, bgr))
+                    continue;
+                converter.process(bgr);
+                frame_ms[1] = timer.nsecsElapsed() / 1e6;
+                reference = converter.detection.clone();
+
+                timer.restart();
+                if (!decoder.decode(jpeg, scale, bgr))
+                    continue;
+                converter.processScaled(bgr, scale);
+                frame_ms[2] = timer.nsecsElapsed() / 1e6;
+
+                for (int k = 0; k < 3; k++)
+                    ms[k] += frame_ms[k];
+
+                if (converter.detection.size() == reference.size())
+                    diff += cv::norm(converter.detection, reference, cv::NORM_L1) / double(reference.total());
+                else
+                    same_size = false; // CaptureThread no usaría la IDCT reducida con este tamaño
+                count++;
+            }
+        }
+        if (count == 0)
+        {
+            qWarning() << "No se pudo decodificar ningun frame";
+            return 1;
+        }
+        qDebug().noquote() << QString("%1 (%2x%3, IDCT 1/%4): OpenCV %5 ms/frame, turbo entero %6 ms/frame, "
+                                      "turbo reducido %7 ms/frame (x%8), diferencia media del gris %9")
+                              .arg(c.name).arg(full.width).arg(full.height).arg(scale)
+                              .arg(ms[0] / count, 0, 'f', 3)
+                              .arg(ms[1] / count, 0, 'f', 3)
+                              .arg(ms[2] / count, 0, 'f', 3)
+                              .arg(ms[0] / qMax(1e-9, ms[2]), 0, 'f', 2)
+                              .arg(!same_size ? QString("(tamaño distinto)") : QString::number(diff / count, 'f', 2));
+    }
+    return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <QString>
+
+// Microbenchmarks que se ejecutan con "qtvcr bench=<nombre>" (sin abrir la ventana).
+class Benchmarks
+{
+ public:
+    static int run(const QString &name);
+
+ private:
+    static int frameConversion();
+    static int detectionBatching();
+    static int detectionIndex();
+    static int storage();
+    static int mjpegDecoding();
+};
@@ -0,0 +1,121 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <sys/prctl.h>
+#include <signal.h>
+#include <QCoreApplication>
+#include <QDebug>
+
+#include "utilities.h"
+#include "mjpeg_server.h"
+#include "event_stream.h"
+#include "camera_worker.h"
+
+CameraWorker::CameraWorker(const QString &ring_name, QObject *parent) :
+    QObject(parent), ring_name(ring_name), capturer(nullptr), quitting(false)
+{
+    // Si la GUI muere sin cerrar stdin, el trabajador no queda huérfano
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+    stdin_notifier = new QSocketNotifier(STDIN_FILENO, QSocketNotifier::Read, this);
+    connect(stdin_notifier, &QSocketNotifier::activated, this, &CameraWorker::readCommands);
+
+    // En modo trabajadores la vista HTTP la sirve el proceso que tiene los frames
+    MjpegServer::startFromConfig(Utilities::currentCameraKey());
+    EventStream::startFromConfig(Utilities::currentCameraKey());
+
+    capturer = new CaptureThread(0, &data_lock);
+    // La publicación en el anillo corre en el hilo de captura, sin pasar por el bucle de eventos
+    connect(capturer, &CaptureThread::frameCaptured, this, &CameraWorker::publishFrame, Qt::DirectConnection);
+    connect(capturer, &CaptureThread::fpsChanged, this, &CameraWorker::sendFps);
+    connect(capturer, &CaptureThread::videoSaved, this, &CameraWorker::sendVideoSaved);
+    connect(capturer, &CaptureThread::finished, this, &CameraWorker::captureFinished);
+    capturer->start();
+}
+
+CameraWorker::~CameraWorker()
+{
+    if (capturer != nullptr)
+    {
+        capturer->setRunning(false);
+        capturer->wait();
+        delete capturer;
+    }
+}
+
+void CameraWorker::publishFrame(cv::Mat *frame)
+{
+    // El anillo se crea con el primer frame (o de nuevo si cambia el tamaño)
+    const size_t bytes = frame->cols * frame->elemSize() * frame->rows;
+    if (!ring.isOpen() || bytes > ring.slotBytes())
+    {
+        if (!ring.create(ring_name, Utilities::getParamInt("anillo_slots", 4), bytes))
+        {
+            return;
+        }
+        send("anillo " + ring_name);
+    }
+    ring.publish(*frame, FrameRing::monotonicMs());
+}
+
+void CameraWorker::readCommands()
+{
+    char buf[256];
+    ssize_t n = ::read(STDIN_FILENO, buf, sizeof(buf));
+    if (n <= 0)
+    {
+        // La GUI cerró el canal: terminar ordenadamente (cierra la grabación en curso)
+        stdin_notifier->setEnabled(false);
+        quitting = true;
+        capturer->setRunning(false);
+        return;
+    }
+    stdin_buffer.append(buf, int(n));
+
+    int end;
+    while ((end = stdin_buffer.indexOf('\n')) >= 0)
+    {
+        QStringList cmd = QString::fromUtf8(stdin_buffer.left(end)).trimmed().split(' ');
+        stdin_buffer.remove(0, end + 1);
+
+        if (cmd[0] == "monitor" && cmd.size() > 1)
+        {
+            capturer->setMotionDetectingStatus(cmd[1] == "1");
+        }
+        else if (cmd[0] == "grabar" && cmd.size() > 1)
+        {
+            capturer->setVideoSavingStatus(cmd[1] == "1" ? CaptureThread::STARTING : CaptureThread::STOPPING);
+        }
+        else if (cmd[0] == "fps")
+        {
+            capturer->startCalcFPS();
+        }
+        else
+        {
+            qWarning() << "Comando desconocido:" << cmd.join(' ');
+        }
+    }
+}
+
+void CameraWorker::sendFps(float fps)
+{
+    send(QString("fps %1").arg(fps));
+}
+
+void CameraWorker::sendVideoSaved(QString name)
+{
+    send("video " + name);
+}
+
+void CameraWorker::captureFinished()
+{
+    // Sin cámara (no abrió o se cortó) se sale con error para que el supervisor reinicie
+    QCoreApplication::exit(quitting ? 0 : 2);
+}
+
+void CameraWorker::send(const QString &line)
+{
+    // stdout es solo para el protocolo; los mensajes de depuración van por stderr
+    QByteArray data = (line + "\n").toUtf8();
+    fwrite(data.constData(), 1, size_t(data.size()), stdout);
+    fflush(stdout);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QObject>
+#include <QMutex>
+#include <QSocketNotifier>
+#include "opencv2/opencv.hpp"
+
+#include "capture_thread.h"
+#include "frame_ring.h"
+
+// Proceso trabajador de una cámara ("qtvcr source=cam1 worker ring=/nombre").
+//
+// Corre el CaptureThread sin ventana, publica la vista previa en un FrameRing
+// y se comunica con la GUI (WorkerSupervisor) por líneas de texto:
+//   stdin:  "monitor 0|1", "grabar 0|1", "fps"
+//   stdout: "anillo <nombre>", "fps <valor>", "video <nombre>"
+// Si se cierra stdin (la GUI terminó) el trabajador se detiene.
+class CameraWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CameraWorker(const QString &ring_name, QObject *parent = nullptr);
+    ~CameraWorker();
+
+    // true si el argumento indica modo trabajador
+    static bool isWorkerArgument(const QString &arg) { return arg == "worker"; }
+
+private slots:
+    void readCommands();
+    void sendFps(float fps);
+    void sendVideoSaved(QString name);
+    void captureFinished();
+
+private:
+    void publishFrame(cv::Mat *frame);
+    void send(const QString &line);
+
+    QString ring_name;
+    FrameRing ring;
+    QMutex data_lock;
+    CaptureThread *capturer;
+    QSocketNotifier *stdin_notifier;
+    QByteArray stdin_buffer;
+    bool quitting;
+};
@@ -1,59 +1,81 @@
 #include <QTime>
+#include <QDir>
+#include <QDateTime>
+#include <QJsonObject>
 #include <QtConcurrent>
+#include <QMutexLocker>
 #include <QDebug>
 
-// IMPORTANTE: Necesario para cv::HOGDescriptor y cv::detectMultiScale
-#include <opencv2/objdetect.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 
 #include "utilities.h"
+#include "metrics.h"
+#include "mjpeg_server.h"
+#include "event_stream.h"
+#include "async_io.h"
+#include "thread_placement.h"
 #include "capture_thread.h" // Asumo que este archivo define la clase CaptureThread
 
 // Asumo:
-// - cv::HOGDescriptor hog;
 // - bool motion_detected = false;
 // - QTime last_human_detection_time;
 // - const int GRABACION_COOLDOWN_MS = 5000; // 5 segundos
 
 CaptureThread::CaptureThread(int camera, QMutex *lock) :
-    running(false), cameraID(camera), videoPath(""), data_lock(lock), motion_detected(false)
+    running(false), cameraID(camera), videoPath(""), data_lock(lock), motion_detected(false),
+    last_detections_epoch_ms(0)
 {
     fps_calculating = false;
     fps = 0.0;
 
     frame_width = frame_height = 0;
     video_saving_status = STOPPED;
-    saved_video_name = "";
-    video_writer = nullptr;
+    recorder = nullptr;
+    grabber = nullptr;
+    merge_gap_ms = 0;
 
     motion_detecting_status = false;
+    motion_gate_enabled = false;
+    roi_enabled = false;
+    mjpeg_direct = false;
+    mjpeg_scale = frame_scale = 1;
+    mjpeg_dump_left = 0;
 
     // Inicialización del Cooldown (Para evitar falsos inicios al arrancar)
     last_human_detection_time.start();
 
-    // 1. Inicialización del Detector HOG/SVM para personas
-    hog.setSVMDetector(cv::HOGDescriptor::getDefaultPeopleDetector());
+    // El detector se crea en run() según la configuración de la cámara
+    detector = nullptr;
+    detection_service = nullptr;
 }
 
 CaptureThread::CaptureThread(QString videoPath, QMutex *lock) :
-    running(false), cameraID(-1), videoPath(videoPath), data_lock(lock), motion_detected(false)
+    running(false), cameraID(-1), videoPath(videoPath), data_lock(lock), motion_detected(false),
+    last_detections_epoch_ms(0)
 {
     fps_calculating = false;
     fps = 0.0;
 
     frame_width = frame_height = 0;
     video_saving_status = STOPPED;
-    saved_video_name = "";
-    video_writer = nullptr;
+    recorder = nullptr;
+    grabber = nullptr;
+    merge_gap_ms = 0;
 
     motion_detecting_status = false;
+    motion_gate_enabled = false;
+    roi_enabled = false;
+    mjpeg_direct = false;
+    mjpeg_scale = frame_scale = 1;
+    mjpeg_dump_left = 0;
 
     // Inicialización del Cooldown (Para evitar falsos inicios al arrancar)
     last_human_detection_time.start();
 
-    // 1. Inicialización del Detector HOG/SVM para personas
-    hog.setSVMDetector(cv::HOGDescriptor::getDefaultPeopleDetector());
+    // El detector se crea en run() según la configuración de la cámara
+    detector = nullptr;
+    detection_service = nullptr;
 }
 
 // Main loop for capturing and processing video frames
@@ -69,14 +91,21 @@ void CaptureThread::run()
         qDebug()<<"current from arg:::"<<qApp->arguments()[1];
         current=qApp->arguments()[1].replace("source=", "");
     }
+    camera_key = current;
+    ThreadPlacement::apply(ThreadPlacement::ANALYSIS, camera_key);
 
     QByteArray source="";
+    mjpeg_direct = false;
     if(Utilities::getParam(current+".tipo")==QString("webcam")){
         source.append("/dev/video");
         source.append(Utilities::getParam(current+".num"));
         cv::VideoCapture cap0(source.constData(), cv::CAP_V4L2);
         cap=cap0;
         qDebug()<<"Capturando desde WebCam: "<<source;
+        // MJPEG sin decodificar: lo decodifica el bucle, reducido cuando alcanza (ver mjpeg_decoder.h)
+        mjpeg_direct = Utilities::getParam(current+".mjpeg_directo")==QString("true") &&
+                       cap.set(cv::CAP_PROP_FOURCC, cv::VideoWriter::fourcc('M', 'J', 'P', 'G')) &&
+                       cap.set(cv::CAP_PROP_CONVERT_RGB, 0);
     }else{
         QByteArray source="";
         source.append(Utilities::getParam(current+".urlmin"));
@@ -87,6 +116,7 @@ void CaptureThread::run()
     }
 
     cv::Mat tmp_frame;
+    cv::Mat jpeg; // frame tal como lo entregó la cámara (mjpeg_directo)
 
     // Update video frame dimensions
     frame_width = cap.get(cv::CAP_PROP_FRAME_WIDTH);
@@ -95,23 +125,227 @@ void CaptureThread::run()
     // Verificar si la cámara se abrió correctamente
     if (!cap.isOpened()) {
         qDebug() << "ERROR: No se pudo abrir la fuente de video.";
+        QJsonObject error;
+        error.insert("mensaje", QString("No se pudo abrir la fuente de video"));
+        EventStream::publish(camera_key, "error", error);
         running = false;
         return;
     }
 
+    // Grabador con unión de eventos y encoder en caliente
+    merge_gap_ms = Utilities::getParamInt(camera_key + ".union_eventos_ms", 15000);
+    recorder = new VideoRecorder();
+    connect(recorder, &VideoRecorder::videoSaved, this, &CaptureThread::videoSaved, Qt::DirectConnection);
+    connect(recorder, &VideoRecorder::videoSaved, this, [this](QString name) {
+        QJsonObject fields;
+        fields.insert("nombre", name);
+        EventStream::publish(camera_key, "video", fields);
+    }, Qt::DirectConnection);
+    recorder->configure(fps, cv::Size(frame_width, frame_height), merge_gap_ms);
+
+    // Compuerta de movimiento opcional (diferencia por bloques sobre un gris reducido)
+    motion_gate_enabled = Utilities::getParam(camera_key + ".compuerta_movimiento") == QString("true");
+    motion_gate.configure(Utilities::getParamInt(camera_key + ".movimiento_umbral", 12),
+                          Utilities::getParamDouble(camera_key + ".movimiento_minimo", 0.002));
+
+    // Intervalos de detección (ms) por estado de la escena y presupuesto global de CPU
+    scheduler.configure(camera_key,
+                        Utilities::getParamInt(camera_key + ".deteccion_activo_ms", 0),
+                        Utilities::getParamInt(camera_key + ".deteccion_movimiento_ms", 100),
+                        Utilities::getParamInt(camera_key + ".deteccion_reposo_ms", 1000));
+    DetectionScheduler::setCpuBudget(Utilities::getParamDouble("cpu_presupuesto", 0));
+
+    // Detector de personas (HOG por defecto, DNN si está configurado). Con
+    // deteccion_central se comparte con las demás cámaras y se procesa en lote.
+    if (DetectionService::enabledInConfig())
+    {
+        detection_service = DetectionService::instance();
+        detector = detection_service->acquire(camera_key);
+    }
+    else
+    {
+        detector = Detector::create(camera_key);
+    }
+
+    // Seguimiento entre detecciones: solapamiento mínimo y cuánto se espera a una persona que no se ve
+    tracker.configure(Utilities::getParamDouble(camera_key + ".seguimiento_iou", 0.3),
+                      Utilities::getParamInt(camera_key + ".seguimiento_max_ms", 2000));
+    tracker.reset();
+
+    // Índice de detecciones de todas las grabaciones y horas (ver detection_index.h)
+    if (Utilities::getParam("indice_detecciones") == QString("true"))
+    {
+        index.open(DetectionIndex::defaultRoot(), camera_key);
+    }
+
+    // Zonas de interés: se rasterizan con el primer frame
+    roi_enabled = roi.load(camera_key);
+    roi_detection_mask.release();
+
+    // Escalas (1, 2, 4 u 8) de la vista previa y de las imágenes que reciben los detectores
+    converter.configure(Utilities::getParamInt(camera_key + ".preview_escala", 1),
+                        qMax(1, Utilities::getParamInt(camera_key + ".deteccion_escala", 1)),
+                        motion_gate_enabled ? qMax(1, Utilities::getParamInt(camera_key + ".movimiento_escala", 4)) : 0);
+
+    // Publicación opcional de frames y detecciones para otros procesos (ver frame_tap_format.h)
+    tap_name = Utilities::getParam(camera_key + ".tap_nombre");
+    tap_gray = Utilities::getParam(camera_key + ".tap_formato") == QString("gris");
+    int tap_factor = qMax(1, Utilities::getParamInt(camera_key + ".tap_escala", 1));
+    tap_converter.configure(tap_gray ? 0 : tap_factor, tap_gray ? tap_factor : 0, 0);
+    tap.close();
+
+    // Con mjpeg_directo se decodifica a la menor de las escalas activas. La
+    // reducción de la IDCT redondea hacia arriba: se usa solo si el tamaño es
+    // múltiplo de 8 y coincide con el de FrameConverter.
+    mjpeg_scale = 1;
+    if (mjpeg_direct && frame_width % 8 == 0 && frame_height % 8 == 0)
+    {
+        mjpeg_scale = 8;
+        const int factors[] = {converter.previewFactor(), converter.detectionFactor(), converter.motionFactor()};
+        for (int factor : factors)
+        {
+            if (factor > 0)
+                mjpeg_scale = qMin(mjpeg_scale, factor);
+        }
+    }
+    frame_scale = 1;
+
+    // Volcado de los JPEG crudos para pruebas sin cámara (bench=mjpeg)
+    mjpeg_dump_dir = mjpeg_direct ? Utilities::getParam(camera_key + ".mjpeg_volcado") : QString();
+    mjpeg_dump_left = Utilities::getParamInt(camera_key + ".mjpeg_volcado_max", 300);
+    if (!mjpeg_dump_dir.isEmpty())
+    {
+        QDir().mkpath(mjpeg_dump_dir);
+    }
+
+    // La lectura de la cámara va en su propio hilo con una cola acotada
+    int max_queue = Utilities::getParamInt(camera_key + ".cola_max_frames", 8);
+    load_shedder.configure(camera_key, Utilities::getParamInt(camera_key + ".antiguedad_max_ms", 500), max_queue);
+    FrameGrabber grabber(&cap, max_queue, camera_key);
+    grabber.start();
+    {
+        QMutexLocker locker(&grabber_lock);
+        this->grabber = &grabber;
+    }
+
+    GrabbedFrame grabbed;
     while (running)
     {
-        cap >> tmp_frame;
-        if (tmp_frame.empty())
+        grabber.setRecording(video_saving_status != STOPPED);
+        if (!grabber.take(grabbed, 1000))
         {
-            break;
+            if (grabber.endOfStream())
+            {
+                break;
+            }
+            continue;
+        }
+        tmp_frame = grabbed.image;
+        grabbed.image.release();
+        jpeg.release();
+        if (MjpegDecoder::isRaw(tmp_frame))
+        {
+            jpeg = tmp_frame;
+            frame_size = cv::Size(frame_width, frame_height);
+            if (!mjpeg_dump_dir.isEmpty() && mjpeg_dump_left > 0)
+            {
+                mjpeg_dump_left--;
+                const QString path = QString("%1/%2.jpg").arg(mjpeg_dump_dir).arg(grabbed.seq, 6, 10, QChar('0'));
+                AsyncIO::instance()->replace(path, QByteArray((const char *)jpeg.data, int(jpeg.total())));
+                AsyncIO::instance()->close(path);
+            }
+        }
+        else
+        {
+            frame_size = tmp_frame.size();
+        }
+
+        // Control de sobrecarga: según cola y antigüedad se reduce preview, detección o análisis
+        load_shedder.update(grabber.depth(), FrameGrabber::nowMs() - grabbed.captured_ms);
+        bool recording = video_saving_status != STOPPED;
+        bool analyze = motion_detecting_status && !load_shedder.suspendAnalysis(recording);
+        bool show_preview = !load_shedder.skipPreview(grabbed.seq);
+
+        detection_size = cv::Size(frame_size.width / converter.detectionFactor(),
+                                  frame_size.height / converter.detectionFactor());
+        if (roi_enabled && roi_detection_mask.empty())
+        {
+            setupRoiMasks(frame_size);
+        }
+        const bool needs_gray = detector->inputFormat() == Detector::GRAY;
+
+        // ¿Toca detectar en este frame? (usa el estado de movimiento del frame anterior)
+        bool detect_now = false;
+        if (analyze)
+        {
+            bool motion_present = motion_gate_enabled ? motion_gate.hasMotion() : motion_detected;
+            detect_now = scheduler.shouldDetect(recording, motion_present, load_shedder.detectionFactor());
+        }
+
+        // Una sola pasada: vista previa BGR, gris para el detector y gris chico para movimiento.
+        // Sin grabación activa y con la compuerta encendida, el gris del detector
+        // se calcula solo si hubo movimiento.
+        bool gated = detect_now && motion_gate_enabled && video_saving_status == STOPPED;
+        int outputs = show_preview ? FrameConverter::PREVIEW : 0;
+        if (analyze)
+        {
+            outputs |= FrameConverter::MOTION;
+            if (detect_now && !gated && needs_gray)
+                outputs |= FrameConverter::DETECTION;
         }
 
+        // JPEG crudo: resolución completa solo si alguien usa el frame entero
+        // (grabación, tap, servidor HTTP o un detector que recibe recortes a color)
+        frame_scale = 1;
+        if (!jpeg.empty())
+        {
+            const bool full = video_saving_status != STOPPED || !tap_name.isEmpty() ||
+                              MjpegServer::watched(camera_key) || (detect_now && !needs_gray);
+            frame_scale = full ? 1 : mjpeg_scale;
+            if (!mjpeg.decode(jpeg, frame_scale, tmp_frame))
+            {
+                Metrics::add(camera_key + ".mjpeg_errores", 1);
+                continue;
+            }
+        }
+        converter.processScaled(tmp_frame, frame_scale, outputs);
+
         // Llama a la función de detección de humanos
-        if (motion_detecting_status)
+        if (analyze)
+        {
+            if (motion_gate_enabled)
+            {
+                motion_gate.update(converter.motion);
+                if (gated && motion_gate.hasMotion() && needs_gray)
+                    converter.processScaled(tmp_frame, frame_scale, FrameConverter::DETECTION);
+            }
+            if (detect_now)
+                humanDetect(tmp_frame);
+        }
+
+        // La grabación empezó con este frame: se graba a resolución completa
+        if (frame_scale > 1 && video_saving_status != STOPPED)
+        {
+            frame_scale = 1;
+            if (!mjpeg.decode(jpeg, 1, tmp_frame))
+            {
+                Metrics::add(camera_key + ".mjpeg_errores", 1);
+                continue;
+            }
+        }
+
+        // El tap recibe el frame limpio; los recuadros se dibujan después
+        if (!tap_name.isEmpty())
         {
-            humanDetect(tmp_frame);
+            publishTap(tmp_frame, grabbed);
         }
+        if (analyze && detect_now)
+        {
+            drawDetections(tmp_frame);
+        }
+        // Si alguien empezó a mirar con el frame reducido, recibe el siguiente
+        if (frame_scale == 1)
+            MjpegServer::publish(camera_key, tmp_frame);
 
         // El bucle principal maneja la transición de estados de grabación
         if (video_saving_status == STARTING)
@@ -120,54 +354,106 @@ void CaptureThread::run()
         }
         if (video_saving_status == STARTED)
         {
-            video_writer->write(tmp_frame);
+            // Las cajas quedan también como datos en el .trk de la grabación
+            if (analyze && detect_now)
+                recorder->addDetections(last_detections);
+            if (!recorder->write(tmp_frame))
+                recordingFailed();
         }
         if (video_saving_status == STOPPING)
         {
             stopSavingVideo();
         }
+        recorder->poll();
 
-        // Convert frame color from BGR to RGB
-        cvtColor(tmp_frame, tmp_frame, cv::COLOR_BGR2RGB);
+        Metrics::set(camera_key + ".frames_descartados", double(grabber.droppedCount()));
+        Metrics::writeIfDue();
+        if (fps_calculating)
+        {
+            calculateFPS(grabber);
+        }
 
+        if (!show_preview)
+        {
+            continue;
+        }
+
+        // La vista previa queda en BGR: MainWindow usa QImage::Format_BGR888
         // Thead-safe update
         data_lock->lock();
-        frame = tmp_frame;
+        frame = converter.preview;
         data_lock->unlock();
 
         // Emit a signal indicating a new frame has been captured
         emit frameCaptured(&frame);
-        if (fps_calculating)
-        {
-            calculateFPS(cap);
-        }
     }
 
     // Cleanup
+    {
+        QMutexLocker locker(&grabber_lock);
+        this->grabber = nullptr;
+    }
+    grabber.stop();
+    grabber.wait();
+    tap.close();
+    index.close();
+    if (detection_service == nullptr)
+    {
+        delete detector;
+    }
+    detector = nullptr;
+    detection_service = nullptr;
+    recorder->shutdown();
+    delete recorder;
+    recorder = nullptr;
     cap.release();
     running = false;
 }
 
 /*
- * Calculate the FPS by reading 100 frames from the video capture device, then
- * divide the number of frames by the elapsed time in seconds.
+ * Calculate the FPS by reading up to 100 frames from the grab queue, then
+ * divide the intervals actually read by the time between their captures.
  */
-void CaptureThread::calculateFPS(cv::VideoCapture &cap)
+void CaptureThread::calculateFPS(FrameGrabber &grabber)
 {
     const int count_to_read = 100;
-    cv::Mat tmp_frame;
-    QTime timer;
-    timer.start();
+    GrabbedFrame tmp_frame;
+    int read = 0;
+    qint64 first_ms = 0, last_ms = 0;
     for (int i = 0; i < count_to_read; i++)
     {
-        cap >> tmp_frame;
+        if (!grabber.take(tmp_frame, 1000))
+        {
+            break;
+        }
+        // Se mide con la hora de captura: lo que ya estaba en la cola no cuenta como tiempo
+        if (read == 0)
+            first_ms = tmp_frame.captured_ms;
+        last_ms = tmp_frame.captured_ms;
+        read++;
+        // Los frames de una grabación en curso no se pierden durante la medición
+        if (video_saving_status == STARTED)
+        {
+            if (MjpegDecoder::isRaw(tmp_frame.image) && !mjpeg.decode(tmp_frame.image, 1, tmp_frame.image))
+                continue;
+            if (!recorder->write(tmp_frame.image))
+                recordingFailed();
+        }
     }
-    int elapsed_ms = timer.elapsed();
-    fps = count_to_read / (elapsed_ms / 1000.0);
     fps_calculating = false;
+    if (read < 2 || last_ms <= first_ms)
+    {
+        qWarning() << "No se pudo medir los FPS de" << camera_key << "(" << read << "frames)";
+        return;
+    }
+    fps = (read - 1) / ((last_ms - first_ms) / 1000.0);
+    recorder->configure(fps, cv::Size(frame_width, frame_height), merge_gap_ms);
 
     // Emit a signal to inform about the updated FPS
     emit fpsChanged(fps);
+    QJsonObject fields;
+    fields.insert("valor", fps);
+    EventStream::publish(camera_key, "fps", fields);
 }
 
 //void CaptureThread::startSavingVideo(cv::Mat &firstFrame)
@@ -189,70 +475,90 @@ void CaptureThread::calculateFPS(cv::VideoCapture &cap)
 //}
 void CaptureThread::startSavingVideo(cv::Mat &firstFrame)
 {
-    saved_video_name = Utilities::newSavedVideoName();
-
-    // Generar la imagen de cover
-    QString cover = Utilities::getSavedVideoPath(saved_video_name, "jpg");
-    cv::imwrite(cover.toStdString(), firstFrame);
-
-    // -----------------------------------------------------------
-    // ✨ CAMBIO A MP4:
-    // 1. Cambiar la extensión del archivo a "mp4".
-    // 2. Usar un códec compatible con MP4: 'MP4V' (MPEG-4) o 'X264' (H.264).
-    // NOTA: Para 'X264', podrías necesitar librerías FFmpeg configuradas en OpenCV.
-    // 'MP4V' suele funcionar con una configuración base de OpenCV.
-
-    // Opción recomendada si tienes FFmpeg configurado:
-    // int fourcc = cv::VideoWriter::fourcc('X', '2', '6', '4');
-    // Opción alternativa (MPEG-4):
-    //int fourcc = cv::VideoWriter::fourcc('M', 'P', '4', 'V');
-    int fourcc = cv::VideoWriter::fourcc('X', '2', '6', '4');
-
-    QString video_path_mp4 = Utilities::getSavedVideoPath(saved_video_name, "mp4");
-
-    video_writer = new cv::VideoWriter(
-        video_path_mp4.toStdString(), // Usar la extensión "mp4"
-        fourcc,                       // Usar códec MP4V (o X264)
-        fps ? fps : 30,
-        cv::Size(frame_width, frame_height));
-    // -----------------------------------------------------------
+    // El grabador decide si abre un archivo nuevo (con el encoder de repuesto
+    // ya inicializado) o si continúa el anterior dentro del intervalo de unión.
+    if (!recorder->beginEvent(firstFrame))
+    {
+        recordingFailed();
+        return;
+    }
+    QJsonObject fields;
+    fields.insert("estado", QString("inicio"));
+    EventStream::publish(camera_key, "grabacion", fields);
 
     // Cambiar a STARTED para comenzar a escribir frames en el bucle run()
     video_saving_status = STARTED;
 }
 
+// El grabador no pudo abrir o seguir el archivo: se vuelve a STOPPED para que
+// la próxima detección intente de nuevo
+void CaptureThread::recordingFailed()
+{
+    video_saving_status = STOPPED;
+    qWarning() << "Grabación interrumpida por un error de escritura en" << camera_key;
+    QJsonObject fields;
+    fields.insert("estado", QString("error"));
+    EventStream::publish(camera_key, "grabacion", fields);
+}
+
 void CaptureThread::stopSavingVideo()
 {
     video_saving_status = STOPPED;
-    if (video_writer) {
-        video_writer->release();
-        delete video_writer;
-        video_writer = nullptr;
-        qDebug()<<"saved_video_name: "<<saved_video_name;
-        emit videoSaved(saved_video_name);
-    }
+    // videoSaved se emite cuando el grabador cierra el archivo (ver VideoRecorder::poll)
+    recorder->endEvent();
+    QJsonObject fields;
+    fields.insert("estado", QString("fin"));
+    EventStream::publish(camera_key, "grabacion", fields);
 }
 
 
 // **FUNCIÓN HUMAN DETECT CORREGIDA (Versión Final: Control de Estados Mejorado)**
-// Detecta figuras humanas utilizando HOG + SVM y controla la grabación.
+// Detecta figuras humanas con el detector configurado y controla la grabación.
 void CaptureThread::humanDetect(cv::Mat &frame)
 {
     std::vector<cv::Rect> found;
+    std::vector<float> found_scores;
+
+    // 2. Aplicar el detector solo en las regiones que hace falta mirar. HOG usa el
+    //    gris reducido de FrameConverter; DNN recibe el recorte a color del frame.
+    //    Las cajas quedan en coordenadas de la imagen de detección.
+    const int scale = converter.detectionFactor();
+    const bool gray = detector->inputFormat() == Detector::GRAY;
+    std::vector<cv::Rect> regions = detectionRegions();
+    std::vector<cv::Mat> images;
+    for (size_t k = 0; k < regions.size(); k++)
+    {
+        const cv::Rect &r = regions[k];
+        if (gray)
+            images.push_back(converter.detection(r));
+        else
+            images.push_back(frame(cv::Rect(r.x * scale, r.y * scale, r.width * scale, r.height * scale) &
+                                   cv::Rect(0, 0, frame.cols, frame.rows)));
+    }
 
-    // 2. Aplicar el detector HOG/SVM.
-    hog.detectMultiScale(
-        frame,
-        found,
-        1.0,
-        cv::Size(8, 8),
-        cv::Size(32, 32),
-        1.05,
-        2
-    );
-
-    // 3. Filtrado de rectángulos solapados
-    std::vector<cv::Rect> found_filtered;
+    std::vector<std::vector<Detection>> results;
+    if (detection_service != nullptr)
+        detection_service->detect(camera_key, images, results);
+    else
+        detector->detect(images, results);
+    for (size_t k = 0; k < results.size(); k++)
+    {
+        for (size_t i = 0; i < results[k].size(); i++)
+        {
+            cv::Rect b = results[k][i].box;
+            if (!gray)
+                b = cv::Rect(b.x / scale, b.y / scale, b.width / scale, b.height / scale);
+            found.push_back(b + regions[k].tl());
+            found_scores.push_back(results[k][i].score);
+        }
+    }
+
+    // 3. Filtrado de rectángulos solapados. Lo que queda, en coordenadas del frame,
+    //    se guarda en last_detections.
+    std::vector<Detection> &found_filtered = last_detections;
+    const bool had_detections = !found_filtered.empty();
+    found_filtered.clear();
+    last_detections_epoch_ms = QDateTime::currentMSecsSinceEpoch();
     for (size_t i = 0; i < found.size(); i++) {
         cv::Rect r = found[i];
         size_t j;
@@ -260,13 +566,35 @@ void CaptureThread::humanDetect(cv::Mat &frame)
             if (j != i && (r & found[j]) == r)
                 break;
 
+        // Descartar las personas cuyos pies quedan fuera de las zonas de interés
+        if (j == found.size() && !roi_detection_mask.empty())
+        {
+            cv::Point feet(r.x + r.width / 2, std::min(r.y + r.height, roi_detection_mask.rows) - 1);
+            feet.x = std::max(0, std::min(feet.x, roi_detection_mask.cols - 1));
+            feet.y = std::max(0, feet.y);
+            if (roi_detection_mask.at<uchar>(feet) == 0)
+                continue;
+        }
+
         if (j == found.size())
-            found_filtered.push_back(r);
+        {
+            Detection d;
+            d.box = cv::Rect(r.x * scale, r.y * scale, r.width * scale, r.height * scale);
+            d.score = found_scores[i];
+            found_filtered.push_back(d);
+        }
     }
 
+    tracker.update(found_filtered, FrameRing::monotonicMs());
+    index.add(found_filtered, frame_size, last_detections_epoch_ms);
+
     // Determinar si hay figuras humanas después del filtrado
     bool human_present = !found_filtered.empty();
 
+    // Evento con las cajas (y uno vacío cuando dejan de verse)
+    if (human_present || had_detections)
+        EventStream::publishDetections(camera_key, found_filtered);
+
 
     // 4. Control de la lógica de grabación de video (basada en presencia humana y Cooldown)
     if (human_present)
@@ -302,12 +630,15 @@ void CaptureThread::humanDetect(cv::Mat &frame)
         // Establecer el flag de detección.
         motion_detected = false;
     }
+}
 
-    // 5. Dibujar los rectángulos de detección en el frame
+// 5. Dibujar los rectángulos de la última detección en el frame (y en la vista previa)
+void CaptureThread::drawDetections(cv::Mat &frame)
+{
     cv::Scalar color = cv::Scalar(0, 255, 0); // Rectángulos verdes
-    for (size_t i = 0; i < found_filtered.size(); i++)
+    for (size_t i = 0; i < last_detections.size(); i++)
     {
-        cv::Rect r = found_filtered[i];
+        cv::Rect r = last_detections[i].box;
 
         // Ajuste de los límites del rectángulo
         r.x += cvRound(r.width * 0.1);
@@ -315,9 +646,149 @@ void CaptureThread::humanDetect(cv::Mat &frame)
         r.y += cvRound(r.height * 0.07);
         r.height = cvRound(r.height * 0.8);
 
-        cv::rectangle(frame, r.tl(), r.br(), color, 3);
-        cv::putText(frame, "HUMANO", cv::Point(r.x, r.y - 5), cv::FONT_HERSHEY_SIMPLEX, 0.7, color, 2);
+        // El frame puede venir reducido (mjpeg_directo sin grabación)
+        cv::Rect f(r.x / frame_scale, r.y / frame_scale, r.width / frame_scale, r.height / frame_scale);
+        cv::rectangle(frame, f.tl(), f.br(), color, frame_scale > 1 ? 2 : 3);
+        cv::putText(frame, "HUMANO", cv::Point(f.x, f.y - 5), cv::FONT_HERSHEY_SIMPLEX, frame_scale > 1 ? 0.5 : 0.7, color, 2);
+
+        // Si la vista previa no comparte píxeles con el frame: dibujar también ahí
+        const int preview_scale = converter.previewFactor();
+        if (preview_scale > 0 && converter.preview.data != frame.data)
+        {
+            cv::Rect p(r.x / preview_scale, r.y / preview_scale, r.width / preview_scale, r.height / preview_scale);
+            cv::rectangle(converter.preview, p.tl(), p.br(), color, 2);
+        }
+    }
+}
+
+
+// Publica el frame (a la escala y formato del tap) con las últimas detecciones.
+// El segmento se crea con el primer frame, cuando se conoce el tamaño.
+void CaptureThread::publishTap(const cv::Mat &frame, const GrabbedFrame &grabbed)
+{
+    cv::Mat image;
+    if (!tap_gray && tap_converter.previewFactor() == 1 && frame.type() == CV_8UC3)
+    {
+        image = frame;
+    }
+    else
+    {
+        tap_converter.process(frame);
+        image = tap_gray ? tap_converter.detection : tap_converter.preview;
+    }
+
+    const size_t bytes = image.cols * image.elemSize() * image.rows;
+    if (!tap.isOpen() || bytes > tap.slotBytes())
+    {
+        if (!tap.create(tap_name, Utilities::getParamInt(camera_key + ".tap_slots", 8), bytes))
+        {
+            qWarning() << "No se pudo crear el tap" << tap_name << "- se desactiva.";
+            tap_name.clear();
+            return;
+        }
+        qDebug() << "Tap de frames en" << tap_name << image.cols << "x" << image.rows;
+    }
+
+    const qint64 age_ms = FrameGrabber::nowMs() - grabbed.captured_ms;
+    FrameRing::Metadata meta;
+    meta.epoch_ms = QDateTime::currentMSecsSinceEpoch() - age_ms;
+    meta.detections_epoch_ms = last_detections_epoch_ms;
+    meta.source_size = frame.size();
+    meta.detections = &last_detections;
+    tap.publish(image, FrameRing::monotonicMs() - age_ms, &meta);
+}
+
+// Regiones (en coordenadas de la imagen de detección) donde corre HOG.
+// Sin compuerta de movimiento, o con una grabación en curso, es la imagen completa.
+std::vector<cv::Rect> CaptureThread::detectionRegions()
+{
+    cv::Rect full(0, 0, detection_size.width, detection_size.height);
+    std::vector<cv::Rect> regions;
+    if (!motion_gate_enabled || video_saving_status != STOPPED)
+    {
+        // Con zonas de interés solo se recorre el rectángulo de cada zona activa
+        if (!roi_detection_mask.empty())
+            return roi_detection_bounds;
+        regions.push_back(full);
+        return regions;
+    }
+    if (!motion_gate.hasMotion())
+    {
+        return regions;
     }
+
+    // Agrandar cada zona con movimiento para que entre la ventana HOG (64x128)
+    const double scale = double(converter.motionFactor()) / converter.detectionFactor();
+    std::vector<cv::Rect> changed = motion_gate.changedRegions(scale);
+    for (size_t i = 0; i < changed.size(); i++)
+    {
+        cv::Rect r = changed[i];
+        r.x -= 32;
+        r.y -= 64;
+        r.width += 64;
+        r.height += 128;
+        if (roi_detection_mask.empty())
+        {
+            regions.push_back(r & full);
+            continue;
+        }
+        for (size_t z = 0; z < roi_detection_bounds.size(); z++)
+        {
+            cv::Rect clipped = r & roi_detection_bounds[z];
+            if (clipped.area() > 0)
+                regions.push_back(clipped);
+        }
+    }
+
+    // Unir las regiones que se solapan para no analizar dos veces los mismos píxeles
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (size_t i = 0; i < regions.size() && !merged; i++)
+        {
+            for (size_t j = i + 1; j < regions.size(); j++)
+            {
+                if ((regions[i] & regions[j]).area() > 0)
+                {
+                    regions[i] |= regions[j];
+                    regions.erase(regions.begin() + j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Descartar las que no alcanzan para una ventana del detector
+    std::vector<cv::Rect> usable;
+    for (size_t i = 0; i < regions.size(); i++)
+    {
+        if (regions[i].width >= 64 && regions[i].height >= 128)
+            usable.push_back(regions[i]);
+    }
+    return usable;
+}
+
+
+// Rasteriza las zonas una sola vez, a la resolución de detección y a la de movimiento.
+void CaptureThread::setupRoiMasks(cv::Size frame_size)
+{
+    const int detection_scale = converter.detectionFactor();
+    roi_detection_mask = roi.rasterize(cv::Size(frame_size.width / detection_scale,
+                                                frame_size.height / detection_scale));
+    roi_detection_bounds = RoiMask::activeBounds(roi_detection_mask);
+
+    const int motion_scale = converter.motionFactor();
+    if (motion_scale > 0)
+    {
+        motion_gate.setMask(roi.rasterize(cv::Size(frame_size.width / motion_scale,
+                                                   frame_size.height / motion_scale)));
+    }
+
+    double active = double(cv::countNonZero(roi_detection_mask)) / roi_detection_mask.total();
+    qDebug() << "Zonas de interés:" << int(roi_detection_bounds.size())
+             << "regiones, área activa" << QString::number(active * 100, 'f', 1) << "%";
 }
 
 
@@ -335,6 +806,11 @@ void CaptureThread::startCalcFPS()
 void CaptureThread::setVideoSavingStatus(VideoSavingStatus status)
 {
     video_saving_status = status;
+    // Sin esperar a la próxima vuelta del bucle: lo que se capture desde ahora
+    // ya va a la grabación y no se puede descartar
+    QMutexLocker locker(&grabber_lock);
+    if (status == STARTING && grabber != nullptr)
+        grabber->setRecording(true);
 }
 
 void CaptureThread::setMotionDetectingStatus(bool status)
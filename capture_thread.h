@@ -6,7 +6,20 @@
 #include <QMutex>
 #include "opencv2/opencv.hpp"
 #include "opencv2/videoio.hpp"
-#include "opencv2/objdetect.hpp" // Se añade para cv::HOGDescriptor
+
+#include "video_recorder.h"
+#include "frame_kernels.h"
+#include "mjpeg_decoder.h"
+#include "motion_gate.h"
+#include "roi_mask.h"
+#include "detection_scheduler.h"
+#include "frame_grabber.h"
+#include "load_shedder.h"
+#include "detector.h"
+#include "detection_service.h"
+#include "detection_tracker.h"
+#include "detection_index.h"
+#include "frame_ring.h"
 
 using namespace std;
 
@@ -56,16 +69,32 @@ private:
         const int GRABACION_COOLDOWN_MS = 5000; // 5 segundos de gracia/cooldown
         // ...
     // Internal helper functions for FPS calculation, video saving, and human detection
-    void calculateFPS(cv::VideoCapture &cap);
+    void calculateFPS(FrameGrabber &grabber);
     void startSavingVideo(cv::Mat &firstFrame);
     void stopSavingVideo();
+    void recordingFailed();
     void humanDetect(cv::Mat &frame); // Reemplaza motionDetect para la detección de humanos
+    void drawDetections(cv::Mat &frame);
+    void publishTap(const cv::Mat &frame, const GrabbedFrame &grabbed);
+    std::vector<cv::Rect> detectionRegions();
+    void setupRoiMasks(cv::Size frame_size);
 
     bool running;
     int cameraID;
     QString videoPath;
+    QString camera_key; // Clave de la cámara en config.cfg (ej. "cam1")
     QMutex *data_lock; // Mutex for thread-safe data access
     cv::Mat frame;
+    FrameConverter converter; // Vista previa BGR y gris para detección en una sola pasada
+
+    // Webcam en MJPEG sin decodificar (<cam>.mjpeg_directo, mjpeg_volcado, mjpeg_volcado_max)
+    bool mjpeg_direct;
+    int mjpeg_scale; // reducción al decodificar cuando no hace falta el frame entero
+    MjpegDecoder mjpeg;
+    QString mjpeg_dump_dir;
+    int mjpeg_dump_left;
+    int frame_scale;     // el frame actual está reducido a 1/frame_scale
+    cv::Size frame_size; // resolución completa del frame actual
 
     // FPS variables
     bool fps_calculating;
@@ -74,12 +103,42 @@ private:
     // Video saving variables
     int frame_width, frame_height;
     VideoSavingStatus video_saving_status;
-    QString saved_video_name;
-    cv::VideoWriter *video_writer;
+    VideoRecorder *recorder;
+    QMutex grabber_lock;
+    FrameGrabber *grabber; // el de run(), para avisarle apenas empieza una grabación
+    int merge_gap_ms; // Eventos separados por menos de esto van al mismo archivo
 
     // Human Detection variables
     bool motion_detecting_status;
     bool motion_detected;
-    cv::HOGDescriptor hog; // Detector HOG para figuras humanas
+    Detector *detector; // Detector de personas (HOG o DNN, ver <cam>.detector)
+    DetectionService *detection_service; // != nullptr con deteccion_central (el detector es compartido)
+    cv::Size detection_size; // Tamaño de la imagen de detección (frame / deteccion_escala)
+    std::vector<Detection> last_detections; // Última detección, en coordenadas del frame
+    qint64 last_detections_epoch_ms;
+    DetectionTracker tracker; // Identificador de persona entre detecciones (track_id)
+    DetectionIndexWriter index; // Índice de búsqueda de detecciones (indice_detecciones)
+
+    // Compuerta de movimiento: sin grabación activa, HOG solo corre donde cambió la imagen
+    bool motion_gate_enabled;
+    MotionGate motion_gate;
+
+    // Frecuencia de detección según estado de la escena y presupuesto de CPU
+    DetectionScheduler scheduler;
+
+    // Degradación ordenada cuando el análisis se atrasa respecto de la lectura
+    LoadShedder load_shedder;
+
+    // Zonas de interés (<cam>.zonas), rasterizadas una vez a la resolución de detección
+    bool roi_enabled;
+    RoiMask roi;
+    cv::Mat roi_detection_mask;
+    std::vector<cv::Rect> roi_detection_bounds;
+
+    // Tap de frames para otros procesos (<cam>.tap_nombre, tap_escala, tap_formato, tap_slots)
+    QString tap_name;
+    bool tap_gray;
+    FrameConverter tap_converter;
+    FrameRing tap;
 };
 
@@ -0,0 +1,199 @@
+#include <string.h>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDebug>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include "utilities.h"
+#include "keyframe_index.h"
+#include "clip_export.h"
+
+namespace {
+const AVRational MILLISECONDS = {1, 1000};
+}
+
+bool ClipExport::run(const std::vector<Segment> &segments, const QString &output, QString *error)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    AVFormatContext *out = nullptr;
+    AVStream *out_stream = nullptr;
+    AVFormatContext *in = nullptr;
+    AVPacket *packet = av_packet_alloc();
+    int64_t next_dts = 0; // donde empieza el próximo segmento, en la base de tiempo de salida
+    int64_t bytes = 0;
+    QString message;
+
+    if (avformat_alloc_output_context2(&out, nullptr, "mp4", output.toUtf8().constData()) < 0)
+    {
+        message = "No se pudo crear " + output;
+    }
+
+    for (size_t i = 0; message.isEmpty() && i < segments.size(); i++)
+    {
+        const Segment &segment = segments[i];
+        QString path = Utilities::getSavedVideoPath(segment.name, "mp4");
+        if (avformat_open_input(&in, path.toUtf8().constData(), nullptr, nullptr) < 0 ||
+            avformat_find_stream_info(in, nullptr) < 0)
+        {
+            message = "No se pudo abrir " + path;
+            break;
+        }
+        int s = av_find_best_stream(in, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+        if (s < 0)
+        {
+            message = "No hay video en " + path;
+            break;
+        }
+        AVStream *in_stream = in->streams[s];
+
+        if (out_stream == nullptr)
+        {
+            out_stream = avformat_new_stream(out, nullptr);
+            avcodec_parameters_copy(out_stream->codecpar, in_stream->codecpar);
+            out_stream->codecpar->codec_tag = 0;
+            out_stream->time_base = in_stream->time_base;
+            AVDictionary *options = nullptr;
+            // El índice al principio: el archivo se puede reproducir mientras se descarga
+            av_dict_set(&options, "movflags", "+faststart", 0);
+            if (avio_open(&out->pb, output.toUtf8().constData(), AVIO_FLAG_WRITE) < 0 ||
+                avformat_write_header(out, &options) < 0)
+            {
+                av_dict_free(&options);
+                message = "No se pudo escribir " + output;
+                break;
+            }
+            av_dict_free(&options);
+        }
+        // Mismo tamaño no alcanza: con otro SPS/PPS (extradata) el stream unido no se decodifica
+        else if (in_stream->codecpar->codec_id != out_stream->codecpar->codec_id ||
+                 in_stream->codecpar->width != out_stream->codecpar->width ||
+                 in_stream->codecpar->height != out_stream->codecpar->height ||
+                 in_stream->codecpar->extradata_size != out_stream->codecpar->extradata_size ||
+                 (in_stream->codecpar->extradata_size > 0 &&
+                  memcmp(in_stream->codecpar->extradata, out_stream->codecpar->extradata,
+                         size_t(in_stream->codecpar->extradata_size)) != 0))
+        {
+            message = segment.name + " tiene otro formato: no se puede unir sin recodificar";
+            break;
+        }
+
+        // Keyframe anterior al inicio: del .kfi, o el que encuentre el demuxer
+        const int64_t start = in_stream->start_time != AV_NOPTS_VALUE ? in_stream->start_time : 0;
+        int64_t seek_ts = start + av_rescale_q(segment.from_ms, MILLISECONDS, in_stream->time_base);
+        KeyframeIndex index;
+        if (index.loadOrBuild(segment.name))
+        {
+            seek_ts = index.keyframeFor(int64_t(segment.from_ms * index.fps() / 1000)).timestamp;
+        }
+        if (segment.from_ms > 0)
+        {
+            av_seek_frame(in, s, seek_ts, AVSEEK_FLAG_BACKWARD);
+        }
+        const int64_t end = segment.to_ms < 0 ? INT64_MAX
+                                              : start + av_rescale_q(segment.to_ms, MILLISECONDS, in_stream->time_base);
+
+        int64_t shift = AV_NOPTS_VALUE;
+        int64_t segment_end = next_dts;
+        while (av_read_frame(in, packet) >= 0)
+        {
+            if (packet->stream_index != s || (shift == AV_NOPTS_VALUE && !(packet->flags & AV_PKT_FLAG_KEY)))
+            {
+                av_packet_unref(packet);
+                continue;
+            }
+            if (packet->dts != AV_NOPTS_VALUE && packet->dts > end)
+            {
+                av_packet_unref(packet);
+                break;
+            }
+
+            av_packet_rescale_ts(packet, in_stream->time_base, out_stream->time_base);
+            if (shift == AV_NOPTS_VALUE)
+            {
+                // El segmento sigue justo donde terminó el anterior
+                shift = next_dts - (packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts);
+            }
+            if (packet->pts != AV_NOPTS_VALUE)
+                packet->pts += shift;
+            if (packet->dts != AV_NOPTS_VALUE)
+                packet->dts += shift;
+            packet->stream_index = out_stream->index;
+            packet->pos = -1;
+            segment_end = qMax(segment_end, (packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts) +
+                                                qMax<int64_t>(1, packet->duration));
+            bytes += packet->size;
+            if (av_interleaved_write_frame(out, packet) < 0)
+            {
+                message = "Error escribiendo " + output;
+                break;
+            }
+        }
+        next_dts = segment_end;
+        avformat_close_input(&in);
+    }
+
+    const bool created = out != nullptr && out->pb != nullptr;
+    if (created)
+    {
+        if (message.isEmpty() && av_write_trailer(out) < 0)
+            message = "Error escribiendo " + output;
+        avio_closep(&out->pb);
+    }
+    avformat_close_input(&in);
+    avformat_free_context(out);
+    av_packet_free(&packet);
+
+    if (!message.isEmpty())
+    {
+        // Sin trailer el mp4 no se puede reproducir: no se deja a medias
+        if (created)
+            QFile::remove(output);
+        qWarning() << message;
+        if (error != nullptr)
+            *error = message;
+        return false;
+    }
+    qDebug().noquote() << QString("Exportado %1 (%2 MB en %3 ms)")
+                          .arg(output).arg(bytes / 1e6, 0, 'f', 1).arg(timer.elapsed());
+    return true;
+}
+
+/*
+ * qtvcr exportar salida=clip.mp4 2026-10-19+10:00:00@30-90 2026-10-19+10:05:00@0-15
+ *
+ * Cada segmento es una grabación con un rango opcional en segundos
+ * ("@30-" hasta el final). Los segmentos se unen en el orden dado.
+ */
+int ClipExport::runCli(const QStringList &args)
+{
+    QString output;
+    std::vector<Segment> segments;
+    foreach (const QString &arg, args)
+    {
+        if (arg.startsWith("salida="))
+        {
+            output = arg.mid(7);
+            continue;
+        }
+        Segment segment(arg.section('@', 0, 0));
+        QString range = arg.section('@', 1);
+        if (!range.isEmpty())
+        {
+            segment.from_ms = qint64(range.section('-', 0, 0).toDouble() * 1000);
+            QString to = range.section('-', 1);
+            segment.to_ms = to.isEmpty() ? -1 : qint64(to.toDouble() * 1000);
+        }
+        segments.push_back(segment);
+    }
+    if (output.isEmpty() || segments.empty())
+    {
+        qWarning() << "Uso: qtvcr exportar salida=clip.mp4 <nombre>[@desde_s-hasta_s] ...";
+        return 1;
+    }
+    return run(segments, output, nullptr) ? 0 : 2;
+}
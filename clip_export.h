@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+#include <QString>
+#include <QStringList>
+
+// Exporta partes de grabaciones guardadas a un mp4 nuevo sin recodificar:
+// se copian los paquetes tal cual, empezando en el keyframe anterior al
+// inicio pedido (del índice .kfi si existe). Varios segmentos seguidos se
+// unen en un solo archivo con tiempos continuos. Todos tienen que venir de
+// grabaciones con el mismo códec y tamaño.
+//
+// La velocidad la pone el disco: no se decodifica ni se codifica nada.
+class ClipExport
+{
+public:
+    struct Segment
+    {
+        QString name;   // grabación (sin extensión)
+        qint64 from_ms; // dentro de la grabación
+        qint64 to_ms;   // -1 = hasta el final
+
+        Segment(const QString &name = QString(), qint64 from_ms = 0, qint64 to_ms = -1) :
+            name(name), from_ms(from_ms), to_ms(to_ms) {}
+    };
+
+    static bool run(const std::vector<Segment> &segments, const QString &output, QString *error);
+
+    // Modo "qtvcr exportar salida=clip.mp4 <nombre>[@desde_s-hasta_s] ..."
+    static int runCli(const QStringList &args);
+};
@@ -0,0 +1,452 @@
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <QDir>
+#include <QDateTime>
+#include <QTextStream>
+#include <QDebug>
+
+#include "utilities.h"
+#include "async_io.h"
+#include "detection_index.h"
+
+using namespace qtvcr;
+
+namespace {
+const qint64 DIRECTORY_BYTES = qint64(DETECTION_INDEX_MINUTES) * sizeof(DetectionIndexMinute);
+const qint64 RECORDS_OFFSET = sizeof(DetectionIndexHeader) + DIRECTORY_BYTES;
+const qint64 ENTRY_WRITE_MS = 5000;
+
+qint64 localMidnight(const QDate &date)
+{
+    return QDateTime(date, QTime(0, 0)).toMSecsSinceEpoch();
+}
+
+uint16_t normalize(int value, int size)
+{
+    return uint16_t(qBound(0, int(qint64(value) * 65535 / qMax(1, size)), 65535));
+}
+
+// Celda de la grilla donde quedan los pies de la caja
+int footCell(double x, double y, double width, double height)
+{
+    const int grid = DETECTION_INDEX_GRID;
+    int cx = qBound(0, int((x + width / 2) * grid), grid - 1);
+    int cy = qBound(0, int((y + height) * grid), grid - 1);
+    return cy * grid + cx;
+}
+
+// Celdas que toca una región normalizada
+void regionCells(const QRectF &region, uint64_t cells[4])
+{
+    const int grid = DETECTION_INDEX_GRID;
+    memset(cells, 0, 4 * sizeof(uint64_t));
+    int x0 = qBound(0, int(region.left() * grid), grid - 1);
+    int x1 = qBound(0, int(region.right() * grid), grid - 1);
+    int y0 = qBound(0, int(region.top() * grid), grid - 1);
+    int y1 = qBound(0, int(region.bottom() * grid), grid - 1);
+    for (int y = y0; y <= y1; y++)
+        for (int x = x0; x <= x1; x++)
+            cells[(y * grid + x) / 64] |= uint64_t(1) << ((y * grid + x) % 64);
+}
+
+bool validHeader(const DetectionIndexHeader *h)
+{
+    return memcmp(h->magic, DETECTION_INDEX_MAGIC, sizeof(h->magic)) == 0 &&
+           h->version == DETECTION_INDEX_VERSION && h->header_size == sizeof(DetectionIndexHeader) &&
+           h->minute_size == sizeof(DetectionIndexMinute) && h->record_size == sizeof(DetectionIndexRecord) &&
+           h->minutes == uint32_t(DETECTION_INDEX_MINUTES) && h->grid == uint32_t(DETECTION_INDEX_GRID);
+}
+}
+
+DetectionIndexWriter::DetectionIndexWriter() :
+    session(0), day_start_ms(0), day_end_ms(0), minute(-1), record_count(0), last_entry_write_ms(0)
+{
+    memset(&entry, 0, sizeof(entry));
+}
+
+DetectionIndexWriter::~DetectionIndexWriter()
+{
+    close();
+}
+
+void DetectionIndexWriter::open(const QString &root, const QString &camera_key)
+{
+    close();
+    dir = root + "/" + camera_key;
+    session = uint32_t(QDateTime::currentSecsSinceEpoch());
+    if (!QDir().mkpath(dir))
+    {
+        qWarning() << "No se pudo crear la carpeta del índice" << dir;
+        dir.clear();
+    }
+}
+
+void DetectionIndexWriter::close()
+{
+    closeDay();
+    dir.clear();
+}
+
+void DetectionIndexWriter::add(const std::vector<Detection> &detections, cv::Size frame_size, qint64 epoch_ms)
+{
+    if (dir.isEmpty() || detections.empty())
+    {
+        return;
+    }
+    if (path.isEmpty() || epoch_ms < day_start_ms || epoch_ms >= day_end_ms)
+    {
+        closeDay();
+        if (!openDay(epoch_ms))
+        {
+            return;
+        }
+    }
+
+    // Los registros van en orden: si el reloj retrocede se quedan en el minuto actual
+    int m = qBound(0, int((epoch_ms - day_start_ms) / 60000), DETECTION_INDEX_MINUTES - 1);
+    if (m > minute)
+    {
+        writeMinute();
+        minute = m;
+        memset(&entry, 0, sizeof(entry));
+        entry.first = record_count;
+    }
+
+    std::vector<DetectionIndexRecord> records(detections.size());
+    for (size_t i = 0; i < detections.size(); i++)
+    {
+        const Detection &d = detections[i];
+        DetectionIndexRecord &r = records[i];
+        memset(&r, 0, sizeof(r));
+        r.t_ms = uint32_t(qMax<qint64>(0, epoch_ms - day_start_ms));
+        r.session = session;
+        r.track_id = d.track_id;
+        r.x = normalize(d.box.x, frame_size.width);
+        r.y = normalize(d.box.y, frame_size.height);
+        r.width = normalize(d.box.width, frame_size.width);
+        r.height = normalize(d.box.height, frame_size.height);
+        r.score = uint8_t(qBound(0, int(d.score * 255), 255));
+
+        int cell = footCell(r.x / 65535.0, r.y / 65535.0, r.width / 65535.0, r.height / 65535.0);
+        entry.cells[cell / 64] |= uint64_t(1) << (cell % 64);
+    }
+    AsyncIO::instance()->write(path, RECORDS_OFFSET + qint64(record_count) * sizeof(DetectionIndexRecord),
+                               QByteArray(reinterpret_cast<const char *>(records.data()),
+                                          int(records.size() * sizeof(DetectionIndexRecord))));
+    record_count += uint32_t(records.size());
+    entry.count += uint32_t(records.size());
+
+    // Las consultas ven el minuto en curso con unos segundos de atraso
+    if (epoch_ms - last_entry_write_ms > ENTRY_WRITE_MS)
+    {
+        writeMinute();
+        last_entry_write_ms = epoch_ms;
+    }
+}
+
+bool DetectionIndexWriter::openDay(qint64 epoch_ms)
+{
+    QDate date = QDateTime::fromMSecsSinceEpoch(epoch_ms).date();
+    day_start_ms = localMidnight(date);
+    day_end_ms = localMidnight(date.addDays(1));
+    path = dir + "/" + DetectionIndex::dayFileName(epoch_ms);
+
+    minute = -1;
+    record_count = 0;
+    memset(&entry, 0, sizeof(entry));
+    last_entry_write_ms = 0;
+
+    // Archivo del mismo día (reinicio del proceso): se sigue agregando al final.
+    // Es la única lectura del escritor y pasa una vez por día; antes se espera
+    // a que termine lo encolado por si el archivo se cerró hace un momento.
+    AsyncIO *io = AsyncIO::instance();
+    io->waitFor(QStringList() << path);
+    QFile file(path);
+    DetectionIndexHeader header;
+    if (file.open(QIODevice::ReadOnly) && file.size() >= RECORDS_OFFSET &&
+        file.read(reinterpret_cast<char *>(&header), sizeof(header)) == sizeof(header) && validHeader(&header))
+    {
+        std::vector<DetectionIndexMinute> minutes(DETECTION_INDEX_MINUTES);
+        file.read(reinterpret_cast<char *>(minutes.data()), DIRECTORY_BYTES);
+        for (int m = DETECTION_INDEX_MINUTES - 1; m >= 0; m--)
+        {
+            if (minutes[m].count > 0)
+            {
+                minute = m;
+                entry = minutes[m];
+                record_count = entry.first + entry.count;
+                break;
+            }
+        }
+        day_start_ms = header.day_start_epoch_ms;
+        // Lo que quedó sin indexar de la ejecución anterior se descarta
+        io->truncate(path, RECORDS_OFFSET + qint64(record_count) * sizeof(DetectionIndexRecord));
+        return true;
+    }
+    file.close();
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DETECTION_INDEX_MAGIC, sizeof(header.magic));
+    header.version = DETECTION_INDEX_VERSION;
+    header.header_size = sizeof(DetectionIndexHeader);
+    header.minute_size = sizeof(DetectionIndexMinute);
+    header.record_size = sizeof(DetectionIndexRecord);
+    header.minutes = DETECTION_INDEX_MINUTES;
+    header.grid = DETECTION_INDEX_GRID;
+    header.day_start_epoch_ms = day_start_ms;
+    QByteArray start(reinterpret_cast<const char *>(&header), sizeof(header));
+    start.append(QByteArray(int(DIRECTORY_BYTES), '\0'));
+    io->replace(path, start, [](bool ok) {
+        if (!ok)
+            qWarning() << "No se pudo crear el índice de detecciones";
+    });
+    return true;
+}
+
+void DetectionIndexWriter::closeDay()
+{
+    if (!path.isEmpty())
+    {
+        writeMinute();
+        AsyncIO::instance()->close(path);
+        path.clear();
+    }
+    minute = -1;
+}
+
+void DetectionIndexWriter::writeMinute()
+{
+    if (minute < 0)
+    {
+        return;
+    }
+    // AsyncIO respeta el orden: los registros llegan al archivo antes que su entrada
+    AsyncIO::instance()->write(path, sizeof(DetectionIndexHeader) + qint64(minute) * sizeof(DetectionIndexMinute),
+                               QByteArray(reinterpret_cast<const char *>(&entry), sizeof(entry)));
+}
+
+DetectionIndex::DetectionIndex(const QString &root) :
+    root(root)
+{
+}
+
+QString DetectionIndex::defaultRoot()
+{
+    return Utilities::getDataPath() + "/indice";
+}
+
+QString DetectionIndex::dayFileName(qint64 epoch_ms)
+{
+    return QDateTime::fromMSecsSinceEpoch(epoch_ms).date().toString("yyyy-MM-dd") + ".idx";
+}
+
+QStringList DetectionIndex::cameras() const
+{
+    return QDir(root).entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+}
+
+std::vector<DetectionIndex::Hit> DetectionIndex::query(const Query &q, Stats *stats) const
+{
+    Stats local = {0, 0, 0};
+    std::vector<Hit> hits;
+    const QRectF region = q.region.isEmpty() ? QRectF(0, 0, 1, 1) : q.region;
+    uint64_t cells[4];
+    regionCells(region, cells);
+
+    QStringList camera_keys = q.camera_key.isEmpty() ? cameras() : QStringList(q.camera_key);
+    foreach (const QString &camera_key, camera_keys)
+    {
+        // Permanencia en curso por persona (sesión, pista)
+        struct Run
+        {
+            qint64 start;
+            qint64 last;
+            QRectF first_box;
+            int detections;
+        };
+        std::map<std::pair<uint32_t, int32_t>, Run> runs;
+        auto finish = [&](const std::pair<uint32_t, int32_t> &key, const Run &run) {
+            if (run.last - run.start < q.min_dwell_ms)
+                return;
+            Hit hit;
+            hit.camera_key = camera_key;
+            hit.session = key.first;
+            hit.track_id = key.second;
+            hit.start_ms = run.start;
+            hit.end_ms = run.last;
+            hit.first_box = run.first_box;
+            hit.detections = run.detections;
+            hits.push_back(hit);
+        };
+
+        QDate last_day = QDateTime::fromMSecsSinceEpoch(q.to_ms).date();
+        for (QDate day = QDateTime::fromMSecsSinceEpoch(q.from_ms).date(); day <= last_day; day = day.addDays(1))
+        {
+            QFile file(root + "/" + camera_key + "/" + day.toString("yyyy-MM-dd") + ".idx");
+            if (!file.open(QIODevice::ReadOnly) || file.size() < RECORDS_OFFSET)
+                continue;
+            const uchar *data = file.map(0, file.size());
+            if (data == nullptr)
+                continue;
+            const DetectionIndexHeader *header = reinterpret_cast<const DetectionIndexHeader *>(data);
+            if (!validHeader(header))
+                continue;
+            local.files++;
+
+            const DetectionIndexMinute *minutes = reinterpret_cast<const DetectionIndexMinute *>(data + header->header_size);
+            const DetectionIndexRecord *records = reinterpret_cast<const DetectionIndexRecord *>(data + RECORDS_OFFSET);
+            const quint64 available = quint64(file.size() - RECORDS_OFFSET) / sizeof(DetectionIndexRecord);
+            const qint64 day_start = header->day_start_epoch_ms;
+            const int m0 = int(qBound<qint64>(0, (q.from_ms - day_start) / 60000, DETECTION_INDEX_MINUTES - 1));
+            const int m1 = int(qBound<qint64>(-1, (q.to_ms - day_start) / 60000, DETECTION_INDEX_MINUTES - 1));
+
+            for (int m = m0; m <= m1; m++)
+            {
+                const DetectionIndexMinute &entry = minutes[m];
+                if (entry.count == 0 || quint64(entry.first) + entry.count > available)
+                    continue;
+
+                // Personas que se fueron hace más del hueco permitido
+                const qint64 minute_start = day_start + qint64(m) * 60000;
+                for (auto it = runs.begin(); it != runs.end();)
+                {
+                    if (minute_start - it->second.last > q.max_gap_ms)
+                    {
+                        finish(it->first, it->second);
+                        it = runs.erase(it);
+                    }
+                    else
+                    {
+                        ++it;
+                    }
+                }
+
+                if (!((entry.cells[0] & cells[0]) | (entry.cells[1] & cells[1]) |
+                      (entry.cells[2] & cells[2]) | (entry.cells[3] & cells[3])))
+                    continue;
+                local.minutes_scanned++;
+                local.records_scanned += entry.count;
+
+                for (uint32_t i = entry.first; i < entry.first + entry.count; i++)
+                {
+                    const DetectionIndexRecord &r = records[i];
+                    const qint64 t = day_start + r.t_ms;
+                    if (t < q.from_ms || t > q.to_ms)
+                        continue;
+                    QRectF box(r.x / 65535.0, r.y / 65535.0, r.width / 65535.0, r.height / 65535.0);
+                    QPointF feet(box.center().x(), box.bottom());
+                    if (!region.contains(feet))
+                        continue;
+
+                    if (r.track_id < 0)
+                    {
+                        // Sin seguimiento no hay permanencia: cuenta como detección suelta
+                        Run run = {t, t, box, 1};
+                        finish(std::make_pair(r.session, r.track_id), run);
+                        continue;
+                    }
+                    std::pair<uint32_t, int32_t> key(r.session, r.track_id);
+                    auto it = runs.find(key);
+                    if (it != runs.end() && t - it->second.last > q.max_gap_ms)
+                    {
+                        finish(it->first, it->second);
+                        runs.erase(it);
+                        it = runs.end();
+                    }
+                    if (it == runs.end())
+                    {
+                        Run run = {t, t, box, 1};
+                        runs[key] = run;
+                    }
+                    else
+                    {
+                        it->second.last = t;
+                        it->second.detections++;
+                    }
+                }
+            }
+        }
+        for (auto it = runs.begin(); it != runs.end(); ++it)
+        {
+            finish(it->first, it->second);
+        }
+    }
+
+    std::sort(hits.begin(), hits.end(), [](const Hit &a, const Hit &b) { return a.start_ms < b.start_ms; });
+    if (stats != nullptr)
+    {
+        *stats = local;
+    }
+    return hits;
+}
+
+/*
+ * qtvcr buscar [cam=cam1] [desde=2026-10-12T08:00] [hasta=2026-10-19T20:00]
+ *              [zona=x0,y0,x1,y1] [permanencia_ms=5000] [hueco_ms=2000]
+ *
+ * La zona va normalizada (0..1) y se compara con los pies de cada persona.
+ * Sin fechas se buscan los últimos 7 días.
+ */
+int DetectionIndex::runCli(const QStringList &args)
+{
+    Query q;
+    q.to_ms = QDateTime::currentMSecsSinceEpoch();
+    q.from_ms = q.to_ms - qint64(7) * 24 * 3600 * 1000;
+    foreach (const QString &arg, args)
+    {
+        QString key = arg.section('=', 0, 0);
+        QString value = arg.section('=', 1);
+        if (key == "cam")
+        {
+            q.camera_key = value;
+        }
+        else if (key == "desde" || key == "hasta")
+        {
+            QDateTime time = QDateTime::fromString(value, Qt::ISODate);
+            if (!time.isValid())
+            {
+                qWarning() << "Fecha inválida:" << value << "(formato 2026-10-12T08:00)";
+                return 1;
+            }
+            (key == "desde" ? q.from_ms : q.to_ms) = time.toMSecsSinceEpoch();
+        }
+        else if (key == "zona")
+        {
+            QStringList v = value.split(',');
+            if (v.size() != 4)
+            {
+                qWarning() << "Zona inválida:" << value << "(x0,y0,x1,y1 entre 0 y 1)";
+                return 1;
+            }
+            q.region = QRectF(QPointF(v[0].toDouble(), v[1].toDouble()), QPointF(v[2].toDouble(), v[3].toDouble()));
+        }
+        else if (key == "permanencia_ms")
+        {
+            q.min_dwell_ms = value.toLongLong();
+        }
+        else if (key == "hueco_ms")
+        {
+            q.max_gap_ms = value.toLongLong();
+        }
+    }
+
+    Stats stats;
+    std::vector<Hit> hits = query(q, &stats);
+    QTextStream out(stdout);
+    for (size_t i = 0; i < hits.size(); i++)
+    {
+        const Hit &h = hits[i];
+        out << h.camera_key << " "
+            << QDateTime::fromMSecsSinceEpoch(h.start_ms).toString("yyyy-MM-dd HH:mm:ss") << " "
+            << QString::number((h.end_ms - h.start_ms) / 1000.0, 'f', 1) << "s"
+            << " pista " << h.session << ":" << h.track_id
+            << " caja " << QString("%1,%2,%3,%4").arg(h.first_box.x(), 0, 'f', 3).arg(h.first_box.y(), 0, 'f', 3)
+                                                 .arg(h.first_box.width(), 0, 'f', 3).arg(h.first_box.height(), 0, 'f', 3)
+            << "\n";
+    }
+    out.flush();
+    qDebug().noquote() << QString("%1 resultados (%2 archivos, %3 minutos, %4 registros leídos)")
+                          .arg(hits.size()).arg(stats.files).arg(stats.minutes_scanned).arg(stats.records_scanned);
+    return 0;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <QString>
+#include <QStringList>
+#include <QFile>
+#include <QRectF>
+#include "opencv2/opencv.hpp"
+
+#include "detector.h"
+
+// Índice de detecciones de todas las cámaras para buscar sin mirar video:
+// "alguien estuvo más de 5 s en la zona del portón entre el lunes y el jueves".
+//
+// Un archivo por cámara y por día: <datos>/indice/<cam>/<yyyy-MM-dd>.idx
+//
+//   [DetectionIndexHeader 64 B][DetectionIndexMinute 40 B] x 1500 [DetectionIndexRecord 24 B] x N
+//
+// Los registros se agregan en orden de tiempo mientras la cámara detecta. Cada
+// minuto del día tiene una entrada con su rango de registros y una grilla de
+// 16x16 celdas marcando dónde estuvieron los pies de las personas (como en las
+// zonas de interés). Una consulta solo recorre los minutos del rango pedido
+// cuya grilla toca la región; el resto del archivo ni se lee. Las cajas se
+// guardan normalizadas (0..65535) para no depender de la resolución.
+//
+// El escritor actualiza la entrada del minuto en curso cada pocos segundos;
+// lo que se escribió después de la última actualización (si el proceso muere)
+// se descarta al reabrir.
+
+namespace qtvcr {
+
+const char DETECTION_INDEX_MAGIC[8] = {'Q', 'V', 'C', 'R', 'I', 'D', 'X', '\0'};
+const uint32_t DETECTION_INDEX_VERSION = 1;
+const int DETECTION_INDEX_MINUTES = 1500; // alcanza para días de 25 h (cambio de horario)
+const int DETECTION_INDEX_GRID = 16;
+
+struct DetectionIndexHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t minute_size;
+    uint32_t record_size;
+    uint32_t minutes;
+    uint32_t grid;
+    int64_t day_start_epoch_ms; // medianoche local del día del archivo
+    uint8_t reserved[24];
+};
+
+struct DetectionIndexMinute
+{
+    uint32_t first;    // primer registro del minuto
+    uint32_t count;
+    uint64_t cells[4]; // bit (y * 16 + x): hubo pies en esa celda
+};
+
+struct DetectionIndexRecord
+{
+    uint32_t t_ms;    // desde day_start_epoch_ms
+    uint32_t session; // arranque del proceso (segundos epoch): junto con track_id identifica a la persona
+    int32_t track_id;
+    uint16_t x, y, width, height; // normalizados a 0..65535
+    uint8_t score;    // 0..255
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(DetectionIndexHeader) == 64, "DetectionIndexHeader cambió de tamaño");
+static_assert(sizeof(DetectionIndexMinute) == 40, "DetectionIndexMinute cambió de tamaño");
+static_assert(sizeof(DetectionIndexRecord) == 24, "DetectionIndexRecord cambió de tamaño");
+
+} // namespace qtvcr
+
+// Agrega las detecciones de una cámara al índice (desde el hilo de captura)
+class DetectionIndexWriter
+{
+public:
+    DetectionIndexWriter();
+    ~DetectionIndexWriter();
+
+    // root: carpeta del índice (DetectionIndex::defaultRoot() en la aplicación)
+    void open(const QString &root, const QString &camera_key);
+    void close();
+
+    void add(const std::vector<Detection> &detections, cv::Size frame_size, qint64 epoch_ms);
+
+    // Para generar archivos sintéticos con otra sesión
+    void setSession(uint32_t session) { this->session = session; }
+
+private:
+    bool openDay(qint64 epoch_ms);
+    void closeDay();
+    void writeMinute();
+
+    QString dir;
+    uint32_t session;
+    QString path;          // archivo del día; vacío = cerrado
+    qint64 day_start_ms;
+    qint64 day_end_ms;
+    int minute;
+    qtvcr::DetectionIndexMinute entry;
+    uint32_t record_count;
+    qint64 last_entry_write_ms;
+};
+
+// Consultas sobre el índice (solo lectura; los archivos se mapean)
+class DetectionIndex
+{
+public:
+    struct Query
+    {
+        QString camera_key;    // vacío = todas las cámaras
+        qint64 from_ms;        // epoch
+        qint64 to_ms;
+        QRectF region;         // normalizada 0..1; vacía = todo el cuadro
+        qint64 min_dwell_ms;   // permanencia mínima continua en la región
+        qint64 max_gap_ms;     // hueco máximo entre detecciones de la misma persona
+
+        Query() : from_ms(0), to_ms(0), min_dwell_ms(0), max_gap_ms(2000) {}
+    };
+
+    struct Hit
+    {
+        QString camera_key;
+        uint32_t session;
+        int32_t track_id;
+        qint64 start_ms;   // epoch
+        qint64 end_ms;
+        QRectF first_box;  // normalizada
+        int detections;
+    };
+
+    struct Stats
+    {
+        qint64 files;
+        qint64 minutes_scanned;
+        qint64 records_scanned;
+    };
+
+    explicit DetectionIndex(const QString &root = defaultRoot());
+
+    static QString defaultRoot();
+    static QString dayFileName(qint64 epoch_ms);
+
+    QStringList cameras() const;
+    std::vector<Hit> query(const Query &q, Stats *stats = nullptr) const;
+
+    // Modo "qtvcr buscar ...": imprime los resultados, uno por línea
+    static int runCli(const QStringList &args);
+
+private:
+    QString root;
+};
@@ -0,0 +1,123 @@
+#include <time.h>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+
+#include "metrics.h"
+#include "detection_scheduler.h"
+
+namespace {
+QMutex cpu_lock;
+double cpu_budget = 0;      // % de un núcleo
+double cpu_backoff = 1.0;
+QElapsedTimer cpu_wall;
+double cpu_last_seconds = 0;
+
+const double MAX_BACKOFF = 8.0;
+
+double processCpuSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+}
+
+DetectionScheduler::DetectionScheduler() :
+    active_ms(0), motion_ms(100), idle_ms(1000), current_interval_ms(0), detections_in_window(0)
+{
+}
+
+void DetectionScheduler::configure(const QString &camera_key, int active_ms, int motion_ms, int idle_ms)
+{
+    this->camera_key = camera_key;
+    this->active_ms = active_ms;
+    this->motion_ms = motion_ms;
+    this->idle_ms = idle_ms;
+    since_last.invalidate();
+    rate_window.start();
+    detections_in_window = 0;
+}
+
+bool DetectionScheduler::shouldDetect(bool event_active, bool motion_present, double load_factor)
+{
+    sampleCpu();
+
+    int base = event_active ? active_ms : (motion_present ? motion_ms : idle_ms);
+    double factor = backoffFactor() * load_factor;
+    if (factor > 1.0)
+    {
+        // Con retroceso hasta los eventos activos dejan de analizar todos los frames
+        base = qMax(base, 40);
+    }
+    current_interval_ms = int(base * factor);
+
+    bool due = !since_last.isValid() || since_last.elapsed() >= current_interval_ms;
+    if (due)
+    {
+        since_last.start();
+        detections_in_window++;
+    }
+
+    // Tasa efectiva medida, además del intervalo objetivo
+    if (rate_window.elapsed() >= 1000)
+    {
+        Metrics::set(camera_key + ".deteccion_intervalo_ms", current_interval_ms);
+        Metrics::set(camera_key + ".deteccion_hz", detections_in_window * 1000.0 / rate_window.elapsed());
+        Metrics::set(camera_key + ".deteccion_estado",
+                     event_active ? QString("activo") : (motion_present ? QString("movimiento") : QString("reposo")));
+        rate_window.restart();
+        detections_in_window = 0;
+    }
+    return due;
+}
+
+void DetectionScheduler::setCpuBudget(double percent)
+{
+    QMutexLocker locker(&cpu_lock);
+    cpu_budget = percent;
+}
+
+double DetectionScheduler::backoffFactor()
+{
+    QMutexLocker locker(&cpu_lock);
+    return cpu_backoff;
+}
+
+// Mide el uso de CPU del proceso una vez por segundo y ajusta el retroceso global.
+void DetectionScheduler::sampleCpu()
+{
+    QMutexLocker locker(&cpu_lock);
+    if (!cpu_wall.isValid())
+    {
+        cpu_wall.start();
+        cpu_last_seconds = processCpuSeconds();
+        return;
+    }
+    if (cpu_wall.elapsed() < 1000)
+    {
+        return;
+    }
+
+    double now = processCpuSeconds();
+    double usage = (now - cpu_last_seconds) * 100.0 / (cpu_wall.restart() / 1000.0);
+    cpu_last_seconds = now;
+
+    double previous = cpu_backoff;
+    if (cpu_budget > 0 && usage > cpu_budget)
+    {
+        cpu_backoff = qMin(MAX_BACKOFF, cpu_backoff * 1.5);
+    }
+    else if (usage < cpu_budget * 0.8 || cpu_budget <= 0)
+    {
+        cpu_backoff = qMax(1.0, cpu_backoff / 1.25);
+    }
+    if (cpu_backoff != previous)
+    {
+        qDebug() << "Uso de CPU" << int(usage) << "% (presupuesto" << cpu_budget << "%): factor de retroceso" << cpu_backoff;
+    }
+
+    Metrics::set("cpu.uso_pct", usage);
+    Metrics::set("cpu.presupuesto_pct", cpu_budget);
+    Metrics::set("cpu.factor_retroceso", cpu_backoff);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QString>
+#include <QElapsedTimer>
+
+// Decide cada cuánto corre el detector de personas en una cámara.
+//
+// - Evento activo (grabando): intervalo "activo" (0 = todos los frames).
+// - Movimiento o personas recientes: intervalo "movimiento".
+// - Escena quieta: intervalo "reposo" (muestreo lento).
+//
+// Si el uso de CPU del proceso supera el presupuesto (cpu_presupuesto, en % de
+// un núcleo) todos los intervalos de todas las cámaras se multiplican por un
+// factor de retroceso que vuelve a 1 cuando baja la carga.
+class DetectionScheduler
+{
+public:
+    DetectionScheduler();
+
+    void configure(const QString &camera_key, int active_ms, int motion_ms, int idle_ms);
+
+    // true si toca detectar en este frame. load_factor permite que el control
+    // de sobrecarga de la cámara alargue el intervalo (ver LoadShedder).
+    bool shouldDetect(bool event_active, bool motion_present, double load_factor = 1.0);
+
+    int currentIntervalMs() const { return current_interval_ms; }
+
+    // Presupuesto global de CPU (0 desactiva el retroceso)
+    static void setCpuBudget(double percent);
+    static double backoffFactor();
+
+private:
+    static void sampleCpu();
+
+    QString camera_key;
+    int active_ms, motion_ms, idle_ms;
+    int current_interval_ms;
+
+    QElapsedTimer since_last;
+    QElapsedTimer rate_window;
+    int detections_in_window;
+};
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <QtConcurrent>
+#include <QMutexLocker>
+#include <QDebug>
+
+#include "utilities.h"
+#include "metrics.h"
+#include "frame_grabber.h"
+#include "thread_placement.h"
+#include "detection_service.h"
+
+DetectionService *DetectionService::instance()
+{
+    static DetectionService *service = nullptr;
+    static QMutex create_lock;
+    QMutexLocker locker(&create_lock);
+    if (service == nullptr)
+    {
+        service = new DetectionService();
+        service->configure(Utilities::getParamInt("deteccion_latencia_max_ms", 10),
+                           Utilities::getParamInt("deteccion_lote_max", 16),
+                           Utilities::getParamInt("deteccion_hilos", qMax(1, QThread::idealThreadCount() / 2)));
+        service->start();
+    }
+    return service;
+}
+
+bool DetectionService::enabledInConfig()
+{
+    return Utilities::getParam("deteccion_central") == QString("true");
+}
+
+DetectionService::DetectionService() :
+    pending_images(0), clients(0), max_latency_ms(10), max_batch(16), stopping(false)
+{
+}
+
+DetectionService::~DetectionService()
+{
+    stop();
+    pool.waitForDone();
+    for (auto it = groups.begin(); it != groups.end(); ++it)
+    {
+        delete it->second->detector;
+        delete it->second;
+    }
+}
+
+void DetectionService::configure(int max_latency_ms, int max_batch, int workers)
+{
+    QMutexLocker locker(&lock);
+    this->max_latency_ms = qMax(0, max_latency_ms);
+    this->max_batch = qMax(1, max_batch);
+    pool.setMaxThreadCount(qMax(1, workers));
+}
+
+Detector *DetectionService::acquire(const QString &camera_key)
+{
+    QMutexLocker locker(&lock);
+    auto cam = cameras.find(camera_key);
+    if (cam != cameras.end())
+    {
+        return cam->second->detector;
+    }
+
+    QString key = Detector::configKey(camera_key);
+    auto it = groups.find(key);
+    Group *group;
+    if (it == groups.end())
+    {
+        group = new Group();
+        group->detector = Detector::create(camera_key);
+        groups[key] = group;
+        qDebug() << "Detector compartido" << group->detector->name() << "para" << camera_key;
+    }
+    else
+    {
+        group = it->second;
+    }
+    cameras[camera_key] = group;
+    return group->detector;
+}
+
+void DetectionService::detect(const QString &camera_key, const std::vector<cv::Mat> &images,
+                              std::vector<std::vector<Detection>> &results)
+{
+    Detector *detector = acquire(camera_key);
+    if (images.empty())
+    {
+        results.clear();
+        return;
+    }
+
+    Request request;
+    request.images = &images;
+    request.results = &results;
+    request.submitted_ms = FrameGrabber::nowMs();
+    request.done = false;
+
+    QMutexLocker locker(&lock);
+    request.group = cameras[camera_key];
+    if (stopping)
+    {
+        // Sin despachador: se detecta en el hilo de la cámara
+        locker.unlock();
+        detectGuarded(request.group, images, results);
+        return;
+    }
+    // Cada hilo que pide (uno por cámara) cuenta una vez
+    thread_local bool registered = false;
+    if (!registered)
+    {
+        registered = true;
+        clients++;
+    }
+    pending.push_back(&request);
+    pending_images += int(images.size());
+    pending_cond.wakeOne();
+    while (!request.done)
+    {
+        done_cond.wait(&lock);
+    }
+}
+
+void DetectionService::stop()
+{
+    QMutexLocker locker(&lock);
+    stopping = true;
+    pending_cond.wakeAll();
+}
+
+// Despachador: espera a que se llene el lote o venza la ventana del pedido más viejo
+void DetectionService::run()
+{
+    ThreadPlacement::apply(ThreadPlacement::DETECTION);
+    QMutexLocker locker(&lock);
+    while (true)
+    {
+        if (pending.empty())
+        {
+            if (stopping)
+            {
+                break;
+            }
+            pending_cond.wait(&lock);
+            continue;
+        }
+
+        // Cada cámara espera su resultado, así que tiene a lo sumo un pedido en
+        // la cola: si ya pidieron todas (o hay una sola) no tiene sentido esperar
+        qint64 age = FrameGrabber::nowMs() - pending.front()->submitted_ms;
+        const bool all_cameras = int(pending.size()) >= clients;
+        if (!stopping && !all_cameras && pending_images < max_batch && age < max_latency_ms)
+        {
+            pending_cond.wait(&lock, (unsigned long)(max_latency_ms - age));
+            continue;
+        }
+
+        // Un lote por detector compartido
+        std::map<Group *, std::vector<Request *>> batches;
+        for (size_t i = 0; i < pending.size(); i++)
+        {
+            batches[pending[i]->group].push_back(pending[i]);
+        }
+        Metrics::add("deteccion_central.lotes", double(batches.size()));
+        Metrics::set("deteccion_central.imagenes_por_lote", double(pending_images) / batches.size());
+        pending.clear();
+        pending_images = 0;
+
+        for (auto it = batches.begin(); it != batches.end(); ++it)
+        {
+            std::shared_ptr<Job> job = std::make_shared<Job>();
+            job->group = it->first;
+            job->batch = it->second;
+            for (size_t i = 0; i < job->batch.size(); i++)
+                job->images.insert(job->images.end(), job->batch[i]->images->begin(), job->batch[i]->images->end());
+            job->results.resize(job->images.size());
+
+            // Con un detector reentrante cada hilo del pool toma un tramo del lote
+            const size_t count = job->images.size();
+            const size_t chunks = job->group->detector->isReentrant()
+                                      ? std::max<size_t>(1, std::min<size_t>(size_t(pool.maxThreadCount()), count))
+                                      : 1;
+            job->remaining = int(chunks);
+            for (size_t c = 0; c < chunks; c++)
+            {
+                const size_t begin = count * c / chunks;
+                const size_t end = count * (c + 1) / chunks;
+                QtConcurrent::run(&pool, [this, job, begin, end]() { runChunk(job, begin, end); });
+            }
+        }
+    }
+}
+
+// Corre el detector sobre images sin dejar escapar excepciones: si falla,
+// results queda con una lista vacía por imagen
+void DetectionService::detectGuarded(Group *group, const std::vector<cv::Mat> &images,
+                                     std::vector<std::vector<Detection>> &results)
+{
+    try
+    {
+        if (group->detector->isReentrant())
+        {
+            group->detector->detect(images, results);
+        }
+        else
+        {
+            QMutexLocker run_locker(&group->run_lock);
+            group->detector->detect(images, results);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        qWarning() << "Detección central:" << group->detector->name() << "falló:" << e.what();
+        Metrics::add("deteccion_central.errores", 1);
+        results.clear();
+    }
+    results.resize(images.size());
+}
+
+void DetectionService::runChunk(std::shared_ptr<Job> job, size_t begin, size_t end)
+{
+    std::vector<cv::Mat> images(job->images.begin() + begin, job->images.begin() + end);
+    std::vector<std::vector<Detection>> results;
+    detectGuarded(job->group, images, results);
+    std::move(results.begin(), results.end(), job->results.begin() + begin);
+
+    // El último tramo en terminar entrega los resultados
+    if (--job->remaining == 0)
+    {
+        finish(job.get());
+    }
+}
+
+void DetectionService::finish(Job *job)
+{
+    QMutexLocker locker(&lock);
+    size_t next = 0;
+    for (size_t i = 0; i < job->batch.size(); i++)
+    {
+        Request *request = job->batch[i];
+        const size_t n = request->images->size();
+        request->results->assign(job->results.begin() + next, job->results.begin() + next + n);
+        next += n;
+        request->done = true;
+    }
+    done_cond.wakeAll();
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <QThread>
+#include <QThreadPool>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+#include "detector.h"
+
+// Servicio central de detección compartido por todas las cámaras del proceso.
+//
+// Cada CaptureThread entrega sus imágenes con detect() y espera el resultado.
+// Un hilo despachador junta los pedidos que llegan dentro de una ventana
+// (deteccion_latencia_max_ms) o hasta completar deteccion_lote_max imágenes
+// (la ventana se corta apenas todas las cámaras del proceso pidieron), y
+// los corre en un solo lote por detector en un pool de hilos
+// (deteccion_hilos). Las cámaras con la misma configuración de detector
+// comparten la instancia; si el detector es reentrante (HOG) el lote se
+// reparte en tramos entre los hilos del pool. Si el detector falla, las
+// imágenes de ese tramo quedan sin detecciones.
+//
+// Se activa con "deteccion_central": true. Desactivado, cada cámara usa su
+// propio detector como antes.
+class DetectionService : public QThread
+{
+public:
+    static DetectionService *instance();
+
+    // Lee la configuración global. Devuelve false si el servicio está desactivado.
+    static bool enabledInConfig();
+
+    void configure(int max_latency_ms, int max_batch, int workers);
+
+    // Detector compartido para la cámara (lo crea la primera vez). No se debe borrar.
+    Detector *acquire(const QString &camera_key);
+
+    // Igual que Detector::detect(), pero en lote con las demás cámaras. Bloquea
+    // hasta tener el resultado.
+    void detect(const QString &camera_key, const std::vector<cv::Mat> &images,
+                std::vector<std::vector<Detection>> &results);
+
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    struct Group;
+    struct Request
+    {
+        Group *group;
+        const std::vector<cv::Mat> *images;
+        std::vector<std::vector<Detection>> *results;
+        qint64 submitted_ms;
+        bool done;
+    };
+    struct Group
+    {
+        Detector *detector;
+        QMutex run_lock; // un lote a la vez si el detector no es reentrante (cv::dnn::Net)
+    };
+
+    // Un lote de un detector, repartido en tramos entre los hilos del pool
+    struct Job
+    {
+        Group *group;
+        std::vector<Request *> batch;
+        std::vector<cv::Mat> images;
+        std::vector<std::vector<Detection>> results;
+        std::atomic<int> remaining; // tramos sin terminar
+    };
+
+    DetectionService();
+    ~DetectionService();
+
+    static void detectGuarded(Group *group, const std::vector<cv::Mat> &images,
+                              std::vector<std::vector<Detection>> &results);
+    void runChunk(std::shared_ptr<Job> job, size_t begin, size_t end);
+    void finish(Job *job);
+
+    QMutex lock;
+    QWaitCondition pending_cond;
+    QWaitCondition done_cond;
+    std::vector<Request *> pending;
+    int pending_images;
+    int clients; // hilos de cámara que usaron el servicio
+    std::map<QString, Group *> groups; // clave: Detector::configKey()
+    std::map<QString, Group *> cameras;
+    QThreadPool pool;
+    int max_latency_ms;
+    int max_batch;
+    bool stopping;
+};
@@ -0,0 +1,92 @@
+#include <algorithm>
+
+#include "detection_tracker.h"
+
+DetectionTracker::DetectionTracker() :
+    min_iou(0.3), max_missing_ms(2000), next_id(1)
+{
+}
+
+void DetectionTracker::configure(double min_iou, int max_missing_ms)
+{
+    this->min_iou = min_iou;
+    this->max_missing_ms = max_missing_ms;
+}
+
+void DetectionTracker::reset()
+{
+    tracks.clear();
+}
+
+double DetectionTracker::iou(const cv::Rect &a, const cv::Rect &b)
+{
+    const double inter = (a & b).area();
+    const double uni = a.area() + b.area() - inter;
+    return uni > 0 ? inter / uni : 0;
+}
+
+void DetectionTracker::update(std::vector<Detection> &detections, qint64 now_ms)
+{
+    // Pistas vencidas
+    for (size_t t = 0; t < tracks.size();)
+    {
+        if (now_ms - tracks[t].last_seen_ms > max_missing_ms)
+        {
+            tracks[t] = tracks.back();
+            tracks.pop_back();
+        }
+        else
+        {
+            t++;
+        }
+    }
+
+    // Asociación voraz: primero los pares con más solapamiento
+    struct Pair
+    {
+        double iou;
+        size_t detection;
+        size_t track;
+    };
+    std::vector<Pair> pairs;
+    for (size_t d = 0; d < detections.size(); d++)
+    {
+        for (size_t t = 0; t < tracks.size(); t++)
+        {
+            Pair p;
+            p.iou = iou(detections[d].box, tracks[t].box);
+            p.detection = d;
+            p.track = t;
+            if (p.iou >= min_iou)
+                pairs.push_back(p);
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Pair &a, const Pair &b) { return a.iou > b.iou; });
+
+    std::vector<char> detection_used(detections.size(), 0);
+    std::vector<char> track_used(tracks.size(), 0);
+    for (size_t i = 0; i < pairs.size(); i++)
+    {
+        const Pair &p = pairs[i];
+        if (detection_used[p.detection] || track_used[p.track])
+            continue;
+        detection_used[p.detection] = 1;
+        track_used[p.track] = 1;
+        Track &track = tracks[p.track];
+        track.box = detections[p.detection].box;
+        track.last_seen_ms = now_ms;
+        detections[p.detection].track_id = track.id;
+    }
+
+    for (size_t d = 0; d < detections.size(); d++)
+    {
+        if (detection_used[d])
+            continue;
+        Track track;
+        track.id = next_id++;
+        track.box = detections[d].box;
+        track.last_seen_ms = now_ms;
+        tracks.push_back(track);
+        detections[d].track_id = track.id;
+    }
+}
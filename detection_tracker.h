@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <QtGlobal>
+#include "opencv2/opencv.hpp"
+
+#include "detector.h"
+
+// Seguimiento simple de personas entre detecciones sucesivas de una cámara.
+//
+// Cada caja se asocia con la pista de mayor solapamiento (IoU) de la
+// detección anterior; las que no se asocian abren una pista nueva. Una pista
+// que no se ve durante max_missing_ms se cierra. Alcanza para agrupar
+// detecciones en el sidecar .trk y en los eventos; no intenta seguir a través
+// de oclusiones largas.
+class DetectionTracker
+{
+public:
+    DetectionTracker();
+
+    void configure(double min_iou, int max_missing_ms);
+    void reset();
+
+    // Asigna track_id a cada detección. now_ms: reloj monotónico.
+    void update(std::vector<Detection> &detections, qint64 now_ms);
+
+    int activeTracks() const { return int(tracks.size()); }
+
+private:
+    struct Track
+    {
+        int id;
+        cv::Rect box;
+        qint64 last_seen_ms;
+    };
+
+    static double iou(const cv::Rect &a, const cv::Rect &b);
+
+    double min_iou;
+    int max_missing_ms;
+    int next_id;
+    std::vector<Track> tracks;
+};
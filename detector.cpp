@@ -0,0 +1,100 @@
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QVariant>
+#include <QDebug>
+
+#include "utilities.h"
+#include "metrics.h"
+#include "detector.h"
+#include "dnn_detector.h"
+
+Detector::Detector() : average_ms(0)
+{
+}
+
+void Detector::detect(const std::vector<cv::Mat> &images, std::vector<std::vector<Detection>> &results)
+{
+    results.assign(images.size(), std::vector<Detection>());
+    if (images.empty())
+    {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    run(images, results);
+    double per_image_ms = timer.nsecsElapsed() / 1e6 / images.size();
+
+    double average = average_ms.load();
+    average = average == 0 ? per_image_ms : average * 0.9 + per_image_ms * 0.1;
+    average_ms.store(average);
+    Metrics::set(QString("detector.%1.inferencia_ms").arg(name()), average);
+    Metrics::add(QString("detector.%1.imagenes").arg(name()), double(images.size()));
+}
+
+Detector *Detector::create(const QString &camera_key)
+{
+    QString type = Utilities::getParam(camera_key + ".detector");
+    if (type == QString("dnn"))
+    {
+        DnnDetector *dnn = new DnnDetector();
+        if (dnn->load(camera_key))
+        {
+            return dnn;
+        }
+        qWarning() << "No se pudo cargar el detector DNN de" << camera_key << "- se usa HOG.";
+        delete dnn;
+    }
+    return new HogDetector();
+}
+
+QString Detector::configKey(const QString &camera_key)
+{
+    QString type = Utilities::getParam(camera_key + ".detector");
+    if (type != QString("dnn"))
+    {
+        return "hog";
+    }
+
+    const char *keys[] = {"dnn_modelo", "dnn_config", "dnn_tipo", "dnn_entrada",
+                          "dnn_confianza", "dnn_clase_persona", "dnn_fp16"};
+    QStringList parts;
+    parts << type;
+    for (const char *k : keys)
+    {
+        parts << Utilities::getParamValue(camera_key + "." + k).toVariant().toString();
+    }
+    return parts.join("|");
+}
+
+HogDetector::HogDetector()
+{
+    // Inicialización del Detector HOG/SVM para personas
+    hog.setSVMDetector(cv::HOGDescriptor::getDefaultPeopleDetector());
+}
+
+void HogDetector::run(const std::vector<cv::Mat> &images, std::vector<std::vector<Detection>> &results)
+{
+    for (size_t k = 0; k < images.size(); k++)
+    {
+        std::vector<cv::Rect> found;
+        std::vector<double> weights;
+        hog.detectMultiScale(
+            images[k],
+            found,
+            weights,
+            1.0,
+            cv::Size(8, 8),
+            cv::Size(32, 32),
+            1.05,
+            2
+        );
+        for (size_t i = 0; i < found.size(); i++)
+        {
+            Detection d;
+            d.box = found[i];
+            d.score = i < weights.size() ? float(weights[i]) : 1.0f;
+            results[k].push_back(d);
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <QString>
+#include "opencv2/opencv.hpp"
+#include "opencv2/objdetect.hpp"
+
+// Una persona encontrada, en coordenadas de la imagen analizada
+struct Detection
+{
+    cv::Rect box;
+    float score;
+    int track_id = -1; // lo asigna DetectionTracker; -1 = sin seguimiento
+};
+
+// Interfaz de los detectores de personas que usa CaptureThread.
+//
+// detect() recibe varias imágenes a la vez (regiones de una cámara o frames de
+// varias cámaras) para que los backends que lo soportan las procesen en un solo
+// lote. Cada backend indica qué formato de imagen necesita.
+class Detector
+{
+public:
+    enum InputFormat
+    {
+        GRAY, // gris reducido de FrameConverter
+        BGR   // frame original a color
+    };
+
+    Detector();
+    virtual ~Detector() {}
+
+    virtual const char *name() const = 0;
+    virtual InputFormat inputFormat() const = 0;
+
+    // true si run() se puede llamar desde varios hilos a la vez
+    virtual bool isReentrant() const { return false; }
+
+    // results[i] son las detecciones de images[i]. Mide el tiempo de inferencia.
+    void detect(const std::vector<cv::Mat> &images, std::vector<std::vector<Detection>> &results);
+
+    // Tiempo medio de inferencia por imagen (ms), promedio móvil
+    double averageMs() const { return average_ms.load(); }
+
+    // Crea el detector configurado en <camera_key>.detector ("hog" por defecto, "dnn")
+    static Detector *create(const QString &camera_key);
+
+    // Identifica la configuración del detector de la cámara: dos cámaras con la
+    // misma clave pueden compartir la instancia.
+    static QString configKey(const QString &camera_key);
+
+protected:
+    virtual void run(const std::vector<cv::Mat> &images, std::vector<std::vector<Detection>> &results) = 0;
+
+private:
+    std::atomic<double> average_ms; // detect() puede correr en varios hilos (isReentrant)
+};
+
+// Detector HOG + SVM de OpenCV (el original de la aplicación)
+class HogDetector : public Detector
+{
+public:
+    HogDetector();
+
+    const char *name() const override { return "hog"; }
+    InputFormat inputFormat() const override { return GRAY; }
+    bool isReentrant() const override { return true; }
+
+protected:
+    void run(const std::vector<cv::Mat> &images, std::vector<std::vector<Detection>> &results) override;
+
+private:
+    cv::HOGDescriptor hog;
+};
@@ -0,0 +1,189 @@
+#include <QDebug>
+
+#include "utilities.h"
+#include "metrics.h"
+#include "dnn_detector.h"
+
+DnnDetector::DnnDetector() :
+    yolo(true), input_size(640), confidence(0.5f), person_class(0), batching(true), warned(false)
+{
+}
+
+bool DnnDetector::load(const QString &camera_key)
+{
+    QString model = Utilities::getParam(camera_key + ".dnn_modelo");
+    QString config = Utilities::getParam(camera_key + ".dnn_config");
+    if (model.isEmpty())
+    {
+        qWarning() << "Falta" << camera_key + ".dnn_modelo";
+        return false;
+    }
+
+    yolo = Utilities::getParam(camera_key + ".dnn_tipo") != QString("ssd");
+    input_size = Utilities::getParamInt(camera_key + ".dnn_entrada", yolo ? 640 : 300);
+    confidence = float(Utilities::getParamDouble(camera_key + ".dnn_confianza", 0.5));
+    person_class = Utilities::getParamInt(camera_key + ".dnn_clase_persona", yolo ? 0 : 15);
+
+    try
+    {
+        net = cv::dnn::readNet(model.toStdString(), config.toStdString());
+    }
+    catch (const cv::Exception &e)
+    {
+        qWarning() << "Error cargando el modelo" << model << ":" << e.what();
+        return false;
+    }
+    if (net.empty())
+    {
+        return false;
+    }
+
+    net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    bool fp16 = Utilities::getParam(camera_key + ".dnn_fp16") == QString("true");
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 9)
+    net.setPreferableTarget(fp16 ? cv::dnn::DNN_TARGET_CPU_FP16 : cv::dnn::DNN_TARGET_CPU);
+#else
+    if (fp16)
+    {
+        qWarning() << "Esta versión de OpenCV no tiene inferencia FP16 en CPU; se usa FP32.";
+    }
+    net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+#endif
+
+    qDebug() << "Detector DNN" << (yolo ? "YOLO" : "SSD") << model << "entrada" << input_size;
+    return true;
+}
+
+void DnnDetector::run(const std::vector<cv::Mat> &images, std::vector<std::vector<Detection>> &results)
+{
+    if (batching)
+    {
+        try
+        {
+            forward(images, results, 0);
+            return;
+        }
+        catch (const cv::Exception &e)
+        {
+            for (size_t i = 0; i < images.size(); i++)
+                results[i].clear();
+            if (images.size() == 1)
+            {
+                failed(e);
+                return;
+            }
+            // Modelo exportado con lote fijo: seguir de a una imagen
+            qWarning() << "El modelo no acepta lotes de" << int(images.size()) << "imágenes; se procesan de a una." << e.what();
+            batching = false;
+        }
+    }
+
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        std::vector<cv::Mat> single(1, images[i]);
+        try
+        {
+            forward(single, results, i);
+        }
+        catch (const cv::Exception &e)
+        {
+            // Esa imagen queda sin detecciones; las demás siguen
+            results[i].clear();
+            failed(e);
+        }
+    }
+}
+
+// Un forward() que falla no corta la captura: se avisa una vez y se cuenta
+void DnnDetector::failed(const cv::Exception &e)
+{
+    if (!warned)
+        qWarning() << "Detector DNN: falló la inferencia, la imagen queda sin detecciones:" << e.what();
+    warned = true;
+    Metrics::add("detector.dnn.errores", 1);
+}
+
+void DnnDetector::forward(const std::vector<cv::Mat> &images, std::vector<std::vector<Detection>> &results, size_t first)
+{
+    cv::Mat blob;
+    if (yolo)
+        blob = cv::dnn::blobFromImages(images, 1.0 / 255, cv::Size(input_size, input_size), cv::Scalar(), true, false);
+    else
+        blob = cv::dnn::blobFromImages(images, 1.0 / 127.5, cv::Size(input_size, input_size), cv::Scalar(127.5, 127.5, 127.5), false, false);
+
+    net.setInput(blob);
+    cv::Mat out = net.forward();
+
+    if (yolo)
+        parseYolo(out, images, results, first);
+    else
+        parseSsd(out, images, results, first);
+}
+
+// Salida SSD: [1, 1, N, 7] con filas (imagen, clase, confianza, x1, y1, x2, y2) normalizadas
+void DnnDetector::parseSsd(const cv::Mat &out, const std::vector<cv::Mat> &images,
+                           std::vector<std::vector<Detection>> &results, size_t first)
+{
+    cv::Mat rows(out.size[2], out.size[3], CV_32F, (void *)out.ptr<float>());
+    for (int i = 0; i < rows.rows; i++)
+    {
+        const float *r = rows.ptr<float>(i);
+        int image = int(r[0]);
+        if (image < 0 || image >= int(images.size()) || int(r[1]) != person_class || r[2] < confidence)
+            continue;
+
+        const cv::Mat &img = images[image];
+        cv::Rect box(cv::Point(cvRound(r[3] * img.cols), cvRound(r[4] * img.rows)),
+                     cv::Point(cvRound(r[5] * img.cols), cvRound(r[6] * img.rows)));
+        Detection d;
+        d.box = box & cv::Rect(0, 0, img.cols, img.rows);
+        d.score = r[2];
+        results[first + image].push_back(d);
+    }
+}
+
+// Salida YOLO: [B, N, 5 + clases] (v5) o [B, 4 + clases, N] (v8), cajas en píxeles de la entrada
+void DnnDetector::parseYolo(const cv::Mat &out, const std::vector<cv::Mat> &images,
+                            std::vector<std::vector<Detection>> &results, size_t first)
+{
+    const bool v8 = out.size[1] < out.size[2];
+    const int count = v8 ? out.size[2] : out.size[1];
+    const int attrs = v8 ? out.size[1] : out.size[2];
+    const int class_offset = v8 ? 4 : 5;
+
+    for (size_t b = 0; b < images.size(); b++)
+    {
+        cv::Mat preds(v8 ? attrs : count, v8 ? count : attrs, CV_32F, (void *)out.ptr<float>(int(b)));
+        if (v8)
+            preds = preds.t();
+
+        const cv::Mat &img = images[b];
+        const float sx = float(img.cols) / input_size;
+        const float sy = float(img.rows) / input_size;
+
+        std::vector<cv::Rect> boxes;
+        std::vector<float> scores;
+        for (int i = 0; i < preds.rows; i++)
+        {
+            const float *p = preds.ptr<float>(i);
+            float score = p[class_offset + person_class];
+            if (!v8)
+                score *= p[4]; // objectness
+            if (score < confidence)
+                continue;
+            float cx = p[0] * sx, cy = p[1] * sy, w = p[2] * sx, h = p[3] * sy;
+            boxes.push_back(cv::Rect(cvRound(cx - w / 2), cvRound(cy - h / 2), cvRound(w), cvRound(h)));
+            scores.push_back(score);
+        }
+
+        std::vector<int> keep;
+        cv::dnn::NMSBoxes(boxes, scores, confidence, 0.45f, keep);
+        for (size_t k = 0; k < keep.size(); k++)
+        {
+            Detection d;
+            d.box = boxes[keep[k]] & cv::Rect(0, 0, img.cols, img.rows);
+            d.score = scores[keep[k]];
+            results[first + b].push_back(d);
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QString>
+#include "opencv2/dnn.hpp"
+#include "detector.h"
+
+// Detector de personas con el módulo DNN de OpenCV en CPU.
+//
+// Usa un modelo local (no se descarga nada), configurado por cámara:
+//   "detector": "dnn",
+//   "dnn_modelo": "/ruta/yolov5s.onnx",   (o .caffemodel/.pb + "dnn_config")
+//   "dnn_tipo": "yolo" | "ssd",
+//   "dnn_entrada": 640,                    (lado de la imagen de entrada)
+//   "dnn_confianza": 0.5,
+//   "dnn_clase_persona": 0,                (0 en COCO/YOLO, 15 en MobileNet-SSD VOC)
+//   "dnn_fp16": true                       (precisión reducida si OpenCV la soporta en CPU)
+//
+// Todas las imágenes de una llamada se procesan en un solo forward(). Si el
+// modelo tiene el tamaño de lote fijo en 1, pasa a procesarlas de a una. Si la
+// inferencia de una imagen falla, esa imagen queda sin detecciones.
+class DnnDetector : public Detector
+{
+public:
+    DnnDetector();
+
+    bool load(const QString &camera_key);
+
+    const char *name() const override { return "dnn"; }
+    InputFormat inputFormat() const override { return BGR; }
+
+protected:
+    void run(const std::vector<cv::Mat> &images, std::vector<std::vector<Detection>> &results) override;
+
+private:
+    void forward(const std::vector<cv::Mat> &images, std::vector<std::vector<Detection>> &results, size_t first);
+    void failed(const cv::Exception &e);
+    void parseSsd(const cv::Mat &out, const std::vector<cv::Mat> &images,
+                  std::vector<std::vector<Detection>> &results, size_t first);
+    void parseYolo(const cv::Mat &out, const std::vector<cv::Mat> &images,
+                   std::vector<std::vector<Detection>> &results, size_t first);
+
+    cv::dnn::Net net;
+    bool yolo;
+    int input_size;
+    float confidence;
+    int person_class;
+    bool batching;
+    bool warned;
+};
@@ -0,0 +1,174 @@
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QDebug>
+
+#include "utilities.h"
+#include "metrics.h"
+#include "event_stream.h"
+
+namespace {
+const size_t MAX_QUEUED_EVENTS = 4096;
+}
+
+QMutex EventStream::queue_lock;
+std::deque<QByteArray> EventStream::queue;
+bool EventStream::flush_pending = false;
+quint64 EventStream::next_seq = 1;
+quint64 EventStream::dropped = 0;
+EventStream *EventStream::instance = nullptr;
+QThread *EventStream::thread = nullptr;
+
+EventStream::EventStream() :
+    QObject(nullptr), server(nullptr), max_buffer_bytes(1024 * 1024)
+{
+}
+
+void EventStream::startFromConfig(const QString &camera_key)
+{
+    QString path = Utilities::getParam(camera_key + ".eventos_socket");
+    if (path.isEmpty() || instance != nullptr)
+    {
+        return;
+    }
+
+    EventStream *stream = new EventStream();
+    stream->max_buffer_bytes = qint64(Utilities::getParamInt("eventos_max_kb", 1024)) * 1024;
+
+    // El servidor vive en su propio hilo: la GUI ocupada no retrasa los eventos
+    thread = new QThread(QCoreApplication::instance());
+    thread->setObjectName("eventos");
+    stream->moveToThread(thread);
+    connect(thread, &QThread::finished, stream, &QObject::deleteLater);
+    connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, thread, &QThread::quit);
+    thread->start();
+
+    QMetaObject::invokeMethod(stream, [stream, path]() {
+        stream->server = new QLocalServer(stream);
+        stream->server->setSocketOptions(QLocalServer::UserAccessOption);
+        QLocalServer::removeServer(path); // socket de una ejecución anterior
+        if (!stream->server->listen(path))
+        {
+            qWarning() << "No se pudo abrir el socket de eventos" << path << ":" << stream->server->errorString();
+            return;
+        }
+        connect(stream->server, &QLocalServer::newConnection, stream, &EventStream::acceptClients);
+        qDebug() << "Eventos en" << path;
+    }, Qt::QueuedConnection);
+
+    QMutexLocker locker(&queue_lock);
+    instance = stream;
+}
+
+void EventStream::publish(const QString &camera_key, const QString &type, QJsonObject fields)
+{
+    // Sin socket configurado no se serializa nada
+    {
+        QMutexLocker locker(&queue_lock);
+        if (instance == nullptr)
+        {
+            return;
+        }
+    }
+
+    fields.insert("t", QDateTime::currentMSecsSinceEpoch());
+    fields.insert("cam", camera_key);
+    fields.insert("tipo", type);
+    QByteArray line = QJsonDocument(fields).toJson(QJsonDocument::Compact);
+
+    QMutexLocker locker(&queue_lock);
+    // "seq" va primero para que los clientes detecten huecos sin parsear todo
+    line = "{\"seq\":" + QByteArray::number(next_seq++) + "," + line.mid(1) + "\n";
+    if (queue.size() >= MAX_QUEUED_EVENTS)
+    {
+        queue.pop_front();
+        dropped++;
+    }
+    queue.push_back(line);
+    if (!flush_pending)
+    {
+        flush_pending = true;
+        QMetaObject::invokeMethod(instance, "flush", Qt::QueuedConnection);
+    }
+}
+
+void EventStream::publishDetections(const QString &camera_key, const std::vector<Detection> &detections)
+{
+    QJsonArray boxes;
+    for (size_t i = 0; i < detections.size(); i++)
+    {
+        const Detection &d = detections[i];
+        QJsonArray box;
+        box << d.box.x << d.box.y << d.box.width << d.box.height << double(qRound(d.score * 1000) / 1000.0) << d.track_id;
+        boxes.append(box);
+    }
+    QJsonObject fields;
+    fields.insert("cajas", boxes);
+    publish(camera_key, "deteccion", fields);
+}
+
+void EventStream::acceptClients()
+{
+    while (server->hasPendingConnections())
+    {
+        QLocalSocket *socket = server->nextPendingConnection();
+        Client client;
+        client.socket = socket;
+        client.lost = 0;
+        clients[socket] = client;
+        connect(socket, &QLocalSocket::disconnected, this, &EventStream::clientGone);
+    }
+    Metrics::set("eventos.clientes", double(clients.size()));
+}
+
+void EventStream::clientGone()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    clients.erase(socket);
+    socket->deleteLater();
+    Metrics::set("eventos.clientes", double(clients.size()));
+}
+
+// Todo lo que se acumuló desde el último aviso sale en una sola escritura por cliente
+void EventStream::flush()
+{
+    QByteArray batch;
+    size_t count;
+    quint64 dropped_now;
+    {
+        QMutexLocker locker(&queue_lock);
+        flush_pending = false;
+        count = queue.size();
+        for (size_t i = 0; i < queue.size(); i++)
+        {
+            batch.append(queue[i]);
+        }
+        queue.clear();
+        dropped_now = dropped;
+    }
+    if (count == 0)
+    {
+        return;
+    }
+    Metrics::set("eventos.descartados_cola", double(dropped_now));
+
+    for (auto it = clients.begin(); it != clients.end(); ++it)
+    {
+        Client &client = it->second;
+        if (client.socket->bytesToWrite() > max_buffer_bytes)
+        {
+            // Cliente lento: no se le acumula nada más
+            client.lost += count;
+            Metrics::add("eventos.descartados_clientes", double(count));
+            continue;
+        }
+        if (client.lost > 0)
+        {
+            client.socket->write("{\"tipo\":\"perdidos\",\"cantidad\":" + QByteArray::number(client.lost) + "}\n");
+            client.lost = 0;
+        }
+        client.socket->write(batch);
+    }
+}
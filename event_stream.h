@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QJsonObject>
+#include <QMutex>
+#include <QByteArray>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "detector.h"
+
+// Flujo de eventos para integraciones locales: una línea JSON por evento en
+// un socket Unix (<cam>.eventos_socket, ej. "/tmp/qtvcr-cam1.sock").
+//
+//   {"seq":12,"t":1729330000123,"cam":"cam1","tipo":"deteccion","cajas":[[x,y,w,h,score,pista],...]}
+//   {"seq":13,...,"tipo":"grabacion","estado":"inicio"}
+//   {"seq":14,...,"tipo":"video","nombre":"2026-10-19+10:00:00"}
+//   {"seq":15,...,"tipo":"fps","valor":24.8}
+//   {"seq":16,...,"tipo":"carga","nivel":"deteccion_reducida"}
+//   {"seq":17,...,"tipo":"error","mensaje":"..."}
+//   {"tipo":"perdidos","cantidad":40}   (eventos que este cliente no recibió por lento)
+//
+// publish() se puede llamar desde cualquier hilo y nunca espera por la red:
+// serializa el evento y lo deja en una cola acotada (si se llena se descarta
+// el más viejo). Un hilo propio junta lo que haya en la cola y lo escribe de
+// una vez en cada cliente. Un cliente con más de eventos_max_kb sin leer deja
+// de recibir eventos hasta ponerse al día y entonces recibe "perdidos".
+class EventStream : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Abre el socket de la cámara si está configurado. Llamar desde el hilo principal.
+    static void startFromConfig(const QString &camera_key);
+
+    static void publish(const QString &camera_key, const QString &type, QJsonObject fields = QJsonObject());
+
+    // Atajo para el resultado de una detección (cajas en coordenadas del frame)
+    static void publishDetections(const QString &camera_key, const std::vector<Detection> &detections);
+
+private slots:
+    void acceptClients();
+    void clientGone();
+    void flush();
+
+private:
+    struct Client
+    {
+        QLocalSocket *socket;
+        quint64 lost;
+    };
+
+    EventStream();
+
+    QLocalServer *server;
+    std::map<QLocalSocket *, Client> clients;
+    qint64 max_buffer_bytes;
+
+    // Compartido con los hilos que publican
+    static QMutex queue_lock;
+    static std::deque<QByteArray> queue;
+    static bool flush_pending;
+    static quint64 next_seq;
+    static quint64 dropped;
+    static EventStream *instance;
+    static QThread *thread;
+};
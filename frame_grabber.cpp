@@ -0,0 +1,151 @@
+#include <QMutexLocker>
+#include <QDebug>
+
+#include "thread_placement.h"
+#include "frame_grabber.h"
+
+namespace {
+qint64 frameBytes(const cv::Mat &image)
+{
+    return qint64(image.total() * image.elemSize());
+}
+
+QElapsedTimer &monotonicClock()
+{
+    static QElapsedTimer clock;
+    if (!clock.isValid())
+        clock.start();
+    return clock;
+}
+}
+
+FrameGrabber::FrameGrabber(cv::VideoCapture *cap, int max_queue, const QString &camera_key) :
+    cap(cap), max_queue(qMax(1, max_queue)), camera_key(camera_key),
+    memory(camera_key.isEmpty() ? QString("cola_frames") : camera_key + ".cola_frames", MemoryBudget::DROPPABLE),
+    stopping(false), finished(false),
+    recording(false), seq(0), dropped(0)
+{
+}
+
+qint64 FrameGrabber::nowMs()
+{
+    return monotonicClock().elapsed();
+}
+
+void FrameGrabber::run()
+{
+    nowMs(); // inicializa el reloj en este hilo antes de la primera lectura
+    ThreadPlacement::apply(ThreadPlacement::GRAB, camera_key);
+    while (true)
+    {
+        GrabbedFrame frame;
+        (*cap) >> frame.image;
+        frame.captured_ms = nowMs();
+
+        if (frame.image.empty())
+        {
+            break;
+        }
+
+        // Presupuesto de memoria: los frames de una grabación esperan lugar; los
+        // en vivo, pasado el límite suave, dejan en la cola solo el más nuevo
+        const qint64 bytes = frameBytes(frame.image);
+        bool keep;
+        {
+            QMutexLocker locker(&lock);
+            keep = recording;
+        }
+        bool reserved = true;
+        if (keep)
+            memory.reserve(bytes);
+        else
+            reserved = memory.tryReserve(bytes);
+
+        QMutexLocker locker(&lock);
+        if (!reserved)
+        {
+            // La grabación pudo empezar mientras se reservaba: esos frames no se tiran
+            while (!recording && !queue.isEmpty())
+            {
+                memory.release(frameBytes(queue.dequeue().image));
+                dropped++;
+            }
+            memory.charge(bytes);
+        }
+        if (stopping)
+        {
+            memory.release(bytes);
+            break;
+        }
+        frame.seq = seq++;
+
+        if (recording)
+        {
+            // Nunca descartar frames que van a una grabación
+            while (queue.size() >= max_queue * 4 && !stopping)
+                not_full.wait(&lock, 100);
+        }
+        else
+        {
+            while (queue.size() >= max_queue)
+            {
+                memory.release(frameBytes(queue.dequeue().image));
+                dropped++;
+            }
+        }
+        queue.enqueue(frame);
+        not_empty.wakeOne();
+    }
+
+    QMutexLocker locker(&lock);
+    finished = true;
+    not_empty.wakeAll();
+}
+
+void FrameGrabber::stop()
+{
+    QMutexLocker locker(&lock);
+    stopping = true;
+    not_full.wakeAll();
+}
+
+void FrameGrabber::setRecording(bool recording)
+{
+    QMutexLocker locker(&lock);
+    this->recording = recording;
+}
+
+bool FrameGrabber::take(GrabbedFrame &frame, int timeout_ms)
+{
+    QMutexLocker locker(&lock);
+    if (queue.isEmpty() && !finished)
+    {
+        not_empty.wait(&lock, timeout_ms);
+    }
+    if (queue.isEmpty())
+    {
+        return false;
+    }
+    frame = queue.dequeue();
+    memory.release(frameBytes(frame.image));
+    not_full.wakeOne();
+    return true;
+}
+
+int FrameGrabber::depth()
+{
+    QMutexLocker locker(&lock);
+    return queue.size();
+}
+
+bool FrameGrabber::endOfStream()
+{
+    QMutexLocker locker(&lock);
+    return finished && queue.isEmpty();
+}
+
+quint64 FrameGrabber::droppedCount()
+{
+    QMutexLocker locker(&lock);
+    return dropped;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QElapsedTimer>
+#include "opencv2/opencv.hpp"
+#include "opencv2/videoio.hpp"
+#include "memory_budget.h"
+
+// Frame leído de la fuente, con la hora de captura para medir su antigüedad
+struct GrabbedFrame
+{
+    cv::Mat image;
+    qint64 captured_ms; // reloj monotónico de FrameGrabber::nowMs()
+    quint64 seq;
+};
+
+// Hilo que solo lee de la cámara y deja los frames en una cola acotada, para
+// que el análisis no frene la lectura y se pueda medir cuánto se atrasa.
+//
+// Si la cola se llena y no hay grabación se descarta el frame más viejo. Con
+// una grabación en curso no se descarta nada: la cola crece hasta
+// max_queue * 4 y, si aun así se llena, la lectura espera. Los frames en cola
+// se cuentan en el presupuesto de memoria (<cam>.cola_frames).
+class FrameGrabber : public QThread
+{
+    Q_OBJECT
+
+public:
+    // camera_key: ubicación del hilo de lectura (etapa captura, ver thread_placement.h)
+    FrameGrabber(cv::VideoCapture *cap, int max_queue, const QString &camera_key = QString());
+
+    void stop();
+    void setRecording(bool recording);
+
+    // Saca el frame más viejo. Devuelve false si no llegó nada en timeout_ms.
+    bool take(GrabbedFrame &frame, int timeout_ms);
+
+    int depth();
+    bool endOfStream(); // la fuente terminó y ya no quedan frames en la cola
+    quint64 droppedCount();
+
+    static qint64 nowMs();
+
+protected:
+    void run() override;
+
+private:
+    cv::VideoCapture *cap;
+    int max_queue;
+    QString camera_key;
+    MemoryBudget::Account memory; // frames en la cola (ver memory_budget.h)
+
+    QMutex lock;
+    QWaitCondition not_empty;
+    QWaitCondition not_full;
+    QQueue<GrabbedFrame> queue;
+    bool stopping;
+    bool finished;
+    bool recording;
+    quint64 seq;
+    quint64 dropped;
+};
@@ -0,0 +1,429 @@
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FRAME_KERNELS_HAVE_AVX2
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <opencv2/imgproc.hpp>
+
+#include "frame_kernels.h"
+
+namespace {
+
+// Pesos BT.601 en punto fijo de 14 bits (los mismos que usa cv::COLOR_BGR2GRAY)
+const int GRAY_B = 1868;
+const int GRAY_G = 9617;
+const int GRAY_R = 4899;
+const int GRAY_SHIFT = 14;
+
+// acc[i] (+)= src[i] para n bytes. Es la parte que toca todo el frame, por eso va en SIMD.
+typedef void (*AccumulateFn)(uint16_t *acc, const uint8_t *src, int n, bool first);
+
+void accumulateScalar(uint16_t *acc, const uint8_t *src, int n, bool first)
+{
+    if (first)
+    {
+        for (int i = 0; i < n; i++)
+            acc[i] = src[i];
+    }
+    else
+    {
+        for (int i = 0; i < n; i++)
+            acc[i] += src[i];
+    }
+}
+
+#if defined(__SSE2__)
+void accumulateSse2(uint16_t *acc, const uint8_t *src, int n, bool first)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        if (!first)
+        {
+            lo = _mm_add_epi16(lo, _mm_loadu_si128((const __m128i *)(acc + i)));
+            hi = _mm_add_epi16(hi, _mm_loadu_si128((const __m128i *)(acc + i + 8)));
+        }
+        _mm_storeu_si128((__m128i *)(acc + i), lo);
+        _mm_storeu_si128((__m128i *)(acc + i + 8), hi);
+    }
+    accumulateScalar(acc + i, src + i, n - i, first);
+}
+#endif
+
+#if defined(FRAME_KERNELS_HAVE_AVX2)
+__attribute__((target("avx2")))
+void accumulateAvx2(uint16_t *acc, const uint8_t *src, int n, bool first)
+{
+    int i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i lo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(src + i)));
+        __m256i hi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(src + i + 16)));
+        if (!first)
+        {
+            lo = _mm256_add_epi16(lo, _mm256_loadu_si256((const __m256i *)(acc + i)));
+            hi = _mm256_add_epi16(hi, _mm256_loadu_si256((const __m256i *)(acc + i + 16)));
+        }
+        _mm256_storeu_si256((__m256i *)(acc + i), lo);
+        _mm256_storeu_si256((__m256i *)(acc + i + 16), hi);
+    }
+    accumulateScalar(acc + i, src + i, n - i, first);
+}
+#endif
+
+#if defined(__ARM_NEON)
+void accumulateNeon(uint16_t *acc, const uint8_t *src, int n, bool first)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        uint8x16_t v = vld1q_u8(src + i);
+        uint16x8_t lo, hi;
+        if (first)
+        {
+            lo = vmovl_u8(vget_low_u8(v));
+            hi = vmovl_u8(vget_high_u8(v));
+        }
+        else
+        {
+            lo = vaddw_u8(vld1q_u16(acc + i), vget_low_u8(v));
+            hi = vaddw_u8(vld1q_u16(acc + i + 8), vget_high_u8(v));
+        }
+        vst1q_u16(acc + i, lo);
+        vst1q_u16(acc + i + 8, hi);
+    }
+    accumulateScalar(acc + i, src + i, n - i, first);
+}
+#endif
+
+AccumulateFn selectAccumulate()
+{
+#if defined(FRAME_KERNELS_HAVE_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+        return accumulateAvx2;
+#endif
+#if defined(__SSE2__)
+    return accumulateSse2;
+#elif defined(__ARM_NEON)
+    return accumulateNeon;
+#else
+    return accumulateScalar;
+#endif
+}
+
+const AccumulateFn accumulate = selectAccumulate();
+
+int log2Factor(int factor)
+{
+    int shift = 0;
+    while ((1 << shift) < factor)
+        shift++;
+    return shift;
+}
+
+// Estado de una salida durante la pasada
+struct Stage
+{
+    int factor;
+    int log2;
+    int out_w;
+    int out_h;
+    int n; // bytes por fila que entran en la salida (out_w * factor * 3)
+    uint16_t *acc;
+    cv::Mat *dst;
+};
+
+Stage makeStage(int factor, int w, int h, int type, std::vector<uint16_t> &acc, cv::Mat &dst)
+{
+    Stage s;
+    s.factor = factor;
+    s.log2 = log2Factor(factor);
+    s.out_w = w >> s.log2;
+    s.out_h = h >> s.log2;
+    s.n = s.out_w * factor * 3;
+    if (factor > 1 && (int)acc.size() < s.n)
+        acc.resize(s.n);
+    s.acc = acc.empty() ? nullptr : &acc[0];
+    dst.create(s.out_h, s.out_w, type);
+    s.dst = &dst;
+    return s;
+}
+
+// Sumas horizontales en el lugar: acc[i] += acc[i + stride] para i < n - stride.
+// Repetido con stride 3, 6, 12... deja en acc[x * factor * 3 + c] la suma de
+// los factor píxeles del bloque x (canal c). Las sumas de factor x factor
+// píxeles entran en 16 bits (8 x 8 x 255).
+typedef void (*FoldFn)(uint16_t *acc, int n, int stride);
+
+void foldScalar(uint16_t *acc, int n, int stride)
+{
+    for (int i = 0; i + stride < n; i++)
+        acc[i] += acc[i + stride];
+}
+
+// Cada vuelta lee acc[i + stride] antes de escribir acc[i]; lo que se lee
+// adelante todavía no se escribió, igual que en la versión escalar
+#if defined(__SSE2__)
+void foldSse2(uint16_t *acc, int n, int stride)
+{
+    int i = 0;
+    for (; i + stride + 8 <= n; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(acc + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(acc + i + stride));
+        _mm_storeu_si128((__m128i *)(acc + i), _mm_add_epi16(a, b));
+    }
+    for (; i + stride < n; i++)
+        acc[i] += acc[i + stride];
+}
+#endif
+
+#if defined(FRAME_KERNELS_HAVE_AVX2)
+__attribute__((target("avx2")))
+void foldAvx2(uint16_t *acc, int n, int stride)
+{
+    int i = 0;
+    for (; i + stride + 16 <= n; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(acc + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(acc + i + stride));
+        _mm256_storeu_si256((__m256i *)(acc + i), _mm256_add_epi16(a, b));
+    }
+    for (; i + stride < n; i++)
+        acc[i] += acc[i + stride];
+}
+#endif
+
+#if defined(__ARM_NEON)
+void foldNeon(uint16_t *acc, int n, int stride)
+{
+    int i = 0;
+    for (; i + stride + 8 <= n; i += 8)
+        vst1q_u16(acc + i, vaddq_u16(vld1q_u16(acc + i), vld1q_u16(acc + i + stride)));
+    for (; i + stride < n; i++)
+        acc[i] += acc[i + stride];
+}
+#endif
+
+FoldFn selectFold()
+{
+#if defined(FRAME_KERNELS_HAVE_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+        return foldAvx2;
+#endif
+#if defined(__SSE2__)
+    return foldSse2;
+#elif defined(__ARM_NEON)
+    return foldNeon;
+#else
+    return foldScalar;
+#endif
+}
+
+const FoldFn fold = selectFold();
+
+void foldRow(uint16_t *acc, int n, int factor)
+{
+    for (int stride = 3; stride < factor * 3; stride *= 2)
+        fold(acc, n, stride);
+}
+
+// Promedio de factor x factor píxeles BGR a partir de las sumas verticales
+void emitBgrRow(uint16_t *acc, uint8_t *dst, int out_w, int factor, int shift)
+{
+    foldRow(acc, out_w * factor * 3, factor);
+    const int round = 1 << (shift - 1);
+    const int step = factor * 3;
+    for (int x = 0; x < out_w; x++)
+    {
+        const uint16_t *p = acc + x * step;
+        dst[0] = uint8_t((p[0] + round) >> shift);
+        dst[1] = uint8_t((p[1] + round) >> shift);
+        dst[2] = uint8_t((p[2] + round) >> shift);
+        dst += 3;
+    }
+}
+
+// Igual que emitBgrRow pero el promedio y el gris se calculan en un solo redondeo
+void emitGrayRow(uint16_t *acc, uint8_t *dst, int out_w, int factor, int shift)
+{
+    foldRow(acc, out_w * factor * 3, factor);
+    const int total_shift = GRAY_SHIFT + shift;
+    const int round = 1 << (total_shift - 1);
+    const int step = factor * 3;
+    for (int x = 0; x < out_w; x++)
+    {
+        const uint16_t *p = acc + x * step;
+        dst[x] = uint8_t((p[0] * GRAY_B + p[1] * GRAY_G + p[2] * GRAY_R + round) >> total_shift);
+    }
+}
+
+inline void feedRow(Stage &s, const uint8_t *row, int y, bool gray)
+{
+    const int oy = y >> s.log2;
+    if (oy >= s.out_h)
+        return;
+
+    uint8_t *dst = s.dst->ptr<uint8_t>(oy);
+    if (s.factor == 1)
+    {
+        // El gris sin reducir lo hace cvtColor sobre todo el frame (ver processOutputs)
+        if (!gray)
+            memcpy(dst, row, s.out_w * 3);
+        return;
+    }
+
+    const int phase = y & (s.factor - 1);
+    accumulate(s.acc, row, s.n, phase == 0);
+    if (phase == s.factor - 1)
+    {
+        if (gray)
+            emitGrayRow(s.acc, dst, s.out_w, s.factor, 2 * s.log2);
+        else
+            emitBgrRow(s.acc, dst, s.out_w, s.factor, 2 * s.log2);
+    }
+}
+
+// Solo se aceptan factores potencia de dos hasta 8 (las sumas entran en 16 bits)
+int normalizeFactor(int factor)
+{
+    if (factor <= 0)
+        return 0;
+    if (factor >= 8)
+        return 8;
+    if (factor >= 4)
+        return 4;
+    if (factor >= 2)
+        return 2;
+    return 1;
+}
+
+}
+
+FrameConverter::FrameConverter() :
+    preview_factor(1), detection_factor(0), motion_factor(0)
+{
+}
+
+void FrameConverter::configure(int preview_factor, int detection_factor, int motion_factor)
+{
+    this->preview_factor = normalizeFactor(preview_factor);
+    this->detection_factor = normalizeFactor(detection_factor);
+    this->motion_factor = normalizeFactor(motion_factor);
+}
+
+template <int Outputs>
+void FrameConverter::processOutputs(const cv::Mat &bgr)
+{
+    CV_Assert(bgr.type() == CV_8UC3);
+    const int w = bgr.cols;
+    const int h = bgr.rows;
+
+    Stage p = Stage(), d = Stage(), m = Stage();
+    if (Outputs & PREVIEW)
+        p = makeStage(preview_factor, w, h, CV_8UC3, preview_acc, preview);
+    if (Outputs & DETECTION)
+        d = makeStage(detection_factor, w, h, CV_8UC1, detection_acc, detection);
+    if (Outputs & MOTION)
+        m = makeStage(motion_factor, w, h, CV_8UC1, motion_acc, motion);
+
+    // Gris a tamaño completo: cvtColor ya es SIMD y usa los mismos pesos
+    if ((Outputs & DETECTION) && d.factor == 1)
+        cv::cvtColor(bgr, detection, cv::COLOR_BGR2GRAY);
+    if ((Outputs & MOTION) && m.factor == 1)
+        cv::cvtColor(bgr, motion, cv::COLOR_BGR2GRAY);
+
+    for (int y = 0; y < h; y++)
+    {
+        const uint8_t *row = bgr.ptr<uint8_t>(y);
+        if (Outputs & PREVIEW)
+            feedRow(p, row, y, false);
+        if ((Outputs & DETECTION) && d.factor > 1)
+            feedRow(d, row, y, true);
+        if ((Outputs & MOTION) && m.factor > 1)
+            feedRow(m, row, y, true);
+    }
+}
+
+template void FrameConverter::processOutputs<0>(const cv::Mat &);
+template void FrameConverter::processOutputs<1>(const cv::Mat &);
+template void FrameConverter::processOutputs<2>(const cv::Mat &);
+template void FrameConverter::processOutputs<3>(const cv::Mat &);
+template void FrameConverter::processOutputs<4>(const cv::Mat &);
+template void FrameConverter::processOutputs<5>(const cv::Mat &);
+template void FrameConverter::processOutputs<6>(const cv::Mat &);
+template void FrameConverter::processOutputs<7>(const cv::Mat &);
+
+void FrameConverter::process(const cv::Mat &bgr, int wanted)
+{
+    int outputs = 0;
+    if (preview_factor == 1)
+        preview = bgr;
+    else if (preview_factor > 1)
+        outputs |= PREVIEW;
+    if (detection_factor > 0)
+        outputs |= DETECTION;
+    if (motion_factor > 0)
+        outputs |= MOTION;
+    outputs &= wanted;
+
+    // La vista previa se entrega a otros hilos (GUI): cada frame usa un buffer nuevo
+    if (outputs & PREVIEW)
+        preview.release();
+
+    if (bgr.type() != CV_8UC3)
+    {
+        // Fuentes que no entregan BGR (ej. cámaras en escala de grises): camino OpenCV
+        cv::Mat gray;
+        if (bgr.channels() == 1)
+            gray = bgr;
+        else
+            cv::cvtColor(bgr, gray, bgr.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+        if (outputs & PREVIEW)
+            cv::resize(bgr, preview, cv::Size(bgr.cols / preview_factor, bgr.rows / preview_factor), 0, 0, cv::INTER_AREA);
+        if (outputs & DETECTION)
+            cv::resize(gray, detection, cv::Size(gray.cols / detection_factor, gray.rows / detection_factor), 0, 0, cv::INTER_AREA);
+        if (outputs & MOTION)
+            cv::resize(gray, motion, cv::Size(gray.cols / motion_factor, gray.rows / motion_factor), 0, 0, cv::INTER_AREA);
+        return;
+    }
+
+    switch (outputs)
+    {
+    case 0: processOutputs<0>(bgr); break;
+    case 1: processOutputs<1>(bgr); break;
+    case 2: processOutputs<2>(bgr); break;
+    case 3: processOutputs<3>(bgr); break;
+    case 4: processOutputs<4>(bgr); break;
+    case 5: processOutputs<5>(bgr); break;
+    case 6: processOutputs<6>(bgr); break;
+    case 7: processOutputs<7>(bgr); break;
+    }
+}
+
+void FrameConverter::processScaled(const cv::Mat &bgr, int scale, int wanted)
+{
+    const int p = preview_factor, d = detection_factor, m = motion_factor;
+    if (scale > 1)
+    {
+        preview_factor = p > 0 ? std::max(1, p / scale) : 0;
+        detection_factor = d > 0 ? std::max(1, d / scale) : 0;
+        motion_factor = m > 0 ? std::max(1, m / scale) : 0;
+    }
+    process(bgr, wanted);
+    preview_factor = p;
+    detection_factor = d;
+    motion_factor = m;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "opencv2/opencv.hpp"
+
+// Conversión de un frame BGR en una sola pasada.
+//
+// Recorre cada fila del frame original una sola vez y genera, según se pida:
+//  - PREVIEW:   BGR reducido para mostrar (QImage::Format_BGR888, sin swap a RGB)
+//  - DETECTION: escala de grises reducida para el detector
+//  - MOTION:    escala de grises más chica para el detector de movimiento
+//
+// Las reducciones son promedios de bloques de factor x factor (factor 1, 2, 4 u 8).
+// Las sumas verticales y horizontales usan SIMD (AVX2/SSE2/NEON según la CPU);
+// el gris sin reducir sale de cv::cvtColor.
+class FrameConverter
+{
+public:
+    enum Output
+    {
+        PREVIEW = 1,
+        DETECTION = 2,
+        MOTION = 4
+    };
+
+    FrameConverter();
+
+    // factor 0 desactiva la salida. Con preview_factor 1 la vista previa es
+    // el mismo frame original (sin copia).
+    void configure(int preview_factor, int detection_factor, int motion_factor);
+
+    // Procesa el frame y deja los resultados en preview, detection y motion.
+    // "wanted" limita las salidas a calcular en este frame (ej. sin DETECTION
+    // cuando el monitor está apagado).
+    void process(const cv::Mat &bgr, int wanted = PREVIEW | DETECTION | MOTION);
+
+    // Igual que process() con un frame que ya viene reducido a 1/scale (ej.
+    // JPEG decodificado con escala). Los factores siguen siendo relativos al
+    // frame completo; scale no puede superar a ninguno de los activos.
+    void processScaled(const cv::Mat &bgr, int scale, int wanted = PREVIEW | DETECTION | MOTION);
+
+    // Versión especializada: las salidas que no están en Outputs no cuestan nada.
+    template <int Outputs>
+    void processOutputs(const cv::Mat &bgr);
+
+    int previewFactor() const { return preview_factor; }
+    int detectionFactor() const { return detection_factor; }
+    int motionFactor() const { return motion_factor; }
+
+    cv::Mat preview;
+    cv::Mat detection;
+    cv::Mat motion;
+
+private:
+    int preview_factor;
+    int detection_factor;
+    int motion_factor;
+
+    std::vector<uint16_t> preview_acc;
+    std::vector<uint16_t> detection_acc;
+    std::vector<uint16_t> motion_acc;
+};
@@ -0,0 +1,207 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <string.h>
+#include <QDebug>
+
+#include "frame_ring.h"
+
+namespace {
+const size_t SLOT_ALIGN = 64;
+
+size_t alignUp(size_t n, size_t align)
+{
+    return (n + align - 1) & ~(align - 1);
+}
+}
+
+FrameRing::FrameRing() :
+    fd(-1), base(nullptr), size(0), header(nullptr), slot_stride(0)
+{
+}
+
+FrameRing::~FrameRing()
+{
+    close();
+}
+
+int64_t FrameRing::monotonicMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+bool FrameRing::create(const QString &name, int slot_count, size_t slot_bytes)
+{
+    close();
+    QByteArray shm_name = name.toUtf8();
+
+    // Si quedó un segmento de un escritor anterior se reemplaza: los lectores
+    // que lo tenían mapeado siguen con el viejo hasta que vuelvan a abrir.
+    shm_unlink(shm_name.constData());
+    fd = shm_open(shm_name.constData(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+    {
+        qWarning() << "shm_open" << name << strerror(errno);
+        return false;
+    }
+
+    slot_count = qMax(2, slot_count);
+    slot_bytes = alignUp(slot_bytes, SLOT_ALIGN);
+    slot_stride = sizeof(qtvcr::FrameTapSlot) + slot_bytes;
+    size = sizeof(qtvcr::FrameTapHeader) + slot_stride * slot_count;
+    if (ftruncate(fd, off_t(size)) != 0)
+    {
+        qWarning() << "ftruncate" << name << strerror(errno);
+        ::close(fd);
+        fd = -1;
+        shm_unlink(shm_name.constData());
+        return false;
+    }
+
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+    {
+        qWarning() << "mmap" << name << strerror(errno);
+        ::close(fd);
+        fd = -1;
+        shm_unlink(shm_name.constData());
+        return false;
+    }
+    base = static_cast<uint8_t *>(p);
+    this->name = name;
+
+    // ftruncate deja todo en cero: seq = 0 (par, vacío) y latest = 0
+    header = reinterpret_cast<qtvcr::FrameTapHeader *>(base);
+    header->version = qtvcr::FRAME_TAP_VERSION;
+    header->slot_count = uint32_t(slot_count);
+    header->slot_bytes = uint32_t(slot_bytes);
+    header->writer_pid = int32_t(getpid());
+    header->heartbeat_ms.store(monotonicMs(), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = qtvcr::FRAME_TAP_MAGIC; // último: los lectores lo usan para saber que está listo
+    return true;
+}
+
+bool FrameRing::open(const QString &name)
+{
+    close();
+    return reader.open(name.toUtf8().constData());
+}
+
+void FrameRing::close()
+{
+    reader.close();
+    if (base != nullptr)
+    {
+        munmap(base, size);
+        ::close(fd);
+        shm_unlink(name.toUtf8().constData());
+    }
+    fd = -1;
+    base = nullptr;
+    header = nullptr;
+    size = 0;
+}
+
+qtvcr::FrameTapSlot *FrameRing::slot(int index) const
+{
+    return reinterpret_cast<qtvcr::FrameTapSlot *>(base + sizeof(qtvcr::FrameTapHeader) + slot_stride * index);
+}
+
+bool FrameRing::publish(const cv::Mat &image, int64_t timestamp_ms, const Metadata *metadata)
+{
+    const size_t row_bytes = image.cols * image.elemSize();
+    if (header == nullptr || row_bytes * image.rows > header->slot_bytes ||
+        (image.type() != CV_8UC3 && image.type() != CV_8UC1))
+    {
+        return false;
+    }
+
+    const uint64_t number = header->latest.load(std::memory_order_relaxed) + 1;
+    qtvcr::FrameTapSlot *s = slot(int(number % header->slot_count));
+    uint8_t *pixels = reinterpret_cast<uint8_t *>(s) + sizeof(qtvcr::FrameTapSlot);
+
+    // seq impar: el slot se está escribiendo
+    const uint64_t seq = s->seq.load(std::memory_order_relaxed);
+    s->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if (image.isContinuous())
+    {
+        memcpy(pixels, image.data, row_bytes * image.rows);
+    }
+    else
+    {
+        for (int y = 0; y < image.rows; y++)
+            memcpy(pixels + y * row_bytes, image.ptr(y), row_bytes);
+    }
+    s->frame_number = number;
+    s->timestamp_ms = timestamp_ms;
+    s->width = image.cols;
+    s->height = image.rows;
+    s->stride = int32_t(row_bytes);
+    s->format = image.type() == CV_8UC3 ? qtvcr::FRAME_TAP_BGR24 : qtvcr::FRAME_TAP_GRAY8;
+
+    s->epoch_ms = metadata ? metadata->epoch_ms : 0;
+    s->detections_epoch_ms = metadata ? metadata->detections_epoch_ms : 0;
+    s->source_width = metadata ? metadata->source_size.width : image.cols;
+    s->source_height = metadata ? metadata->source_size.height : image.rows;
+    int count = 0;
+    if (metadata != nullptr && metadata->detections != nullptr)
+    {
+        const std::vector<Detection> &detections = *metadata->detections;
+        for (; count < int(detections.size()) && count < qtvcr::FRAME_TAP_MAX_DETECTIONS; count++)
+        {
+            qtvcr::FrameTapDetection &d = s->detections[count];
+            d.x = detections[count].box.x;
+            d.y = detections[count].box.y;
+            d.width = detections[count].box.width;
+            d.height = detections[count].box.height;
+            d.score = detections[count].score;
+            d.track_id = detections[count].track_id;
+        }
+    }
+    s->detection_count = count;
+
+    s->seq.store(seq + 2, std::memory_order_release);
+    header->latest.store(number, std::memory_order_release);
+    header->heartbeat_ms.store(monotonicMs(), std::memory_order_release);
+    return true;
+}
+
+bool FrameRing::latest(View &view, uint64_t after) const
+{
+    qtvcr::FrameTapReader::Frame frame;
+    if (!reader.latest(frame, after))
+    {
+        return false;
+    }
+    view.image = cv::Mat(frame.height, frame.width, frame.format == qtvcr::FRAME_TAP_GRAY8 ? CV_8UC1 : CV_8UC3,
+                         const_cast<uint8_t *>(frame.data), size_t(frame.stride));
+    view.frame_number = frame.frame_number;
+    view.timestamp_ms = frame.timestamp_ms;
+    view.slot = frame.slot;
+    view.seq = frame.seq;
+    return true;
+}
+
+bool FrameRing::isValid(const View &view) const
+{
+    qtvcr::FrameTapReader::Frame frame;
+    frame.slot = view.slot;
+    frame.seq = view.seq;
+    return reader.isValid(frame);
+}
+
+int64_t FrameRing::heartbeatMs() const
+{
+    if (header != nullptr)
+    {
+        return header->heartbeat_ms.load(std::memory_order_acquire);
+    }
+    return reader.heartbeatMs();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <QString>
+#include "opencv2/opencv.hpp"
+
+#include "frame_tap_format.h"
+#include "frame_tap_reader.h"
+#include "detector.h"
+
+// Anillo de frames en memoria compartida POSIX (shm_open) entre un proceso que
+// escribe (CaptureThread o el trabajador de una cámara) y los que leen (la
+// GUI, otras herramientas). El formato está en frame_tap_format.h y los
+// programas externos pueden leerlo con frame_tap_reader.h.
+//
+// El lector arma un cv::Mat directamente sobre la memoria del slot, sin
+// copiar, y después de usarlo comprueba con isValid() que el escritor no lo
+// haya pisado.
+class FrameRing
+{
+public:
+    // Datos opcionales que acompañan al frame
+    struct Metadata
+    {
+        int64_t epoch_ms;            // hora de la captura (ms desde 1970)
+        int64_t detections_epoch_ms; // hora del análisis de "detections"
+        cv::Size source_size;        // frame original al que se refieren las cajas
+        const std::vector<Detection> *detections;
+    };
+
+    // Un frame leído: image apunta a la memoria compartida
+    struct View
+    {
+        cv::Mat image;
+        uint64_t frame_number;
+        int64_t timestamp_ms;
+        int slot;
+        uint64_t seq;
+    };
+
+    FrameRing();
+    ~FrameRing();
+
+    // Escritor: crea (o reemplaza) el segmento "name" (ej. "/qtvcr-cam1-1234")
+    bool create(const QString &name, int slot_count, size_t slot_bytes);
+    // Lector: se conecta a un segmento existente
+    bool open(const QString &name);
+    void close();
+
+    bool isOpen() const { return header != nullptr || reader.isOpen(); }
+    size_t slotBytes() const { return header ? header->slot_bytes : 0; }
+
+    // Copia el frame (CV_8UC3 o CV_8UC1) al próximo slot. Devuelve false si no entra.
+    bool publish(const cv::Mat &image, int64_t timestamp_ms, const Metadata *metadata = nullptr);
+
+    // Último frame completo más nuevo que "after". No copia.
+    bool latest(View &view, uint64_t after = 0) const;
+    // true si el slot de la vista no se reescribió mientras se usaba
+    bool isValid(const View &view) const;
+
+    int64_t heartbeatMs() const;
+
+    static int64_t monotonicMs();
+
+private:
+    qtvcr::FrameTapSlot *slot(int index) const;
+
+    // Escritor
+    QString name;
+    int fd;
+    uint8_t *base;
+    size_t size;
+    qtvcr::FrameTapHeader *header;
+    size_t slot_stride;
+
+    // Lector
+    qtvcr::FrameTapReader reader;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+// Formato del anillo de frames en memoria compartida de QtVCR.
+//
+// Este archivo y frame_tap_reader.h no dependen de Qt ni de OpenCV: se pueden
+// copiar a cualquier programa C++11 que quiera leer los frames de una cámara
+// sin volver a abrirla.
+//
+// El segmento es un objeto POSIX (shm_open, en Linux /dev/shm/<nombre>):
+//
+//   offset 0                      FrameTapHeader                    (64 bytes)
+//   offset 64 + i * slot_stride   FrameTapSlot del slot i           (896 bytes)
+//                                 píxeles del slot i                (slot_bytes)
+//
+//   slot_stride = sizeof(FrameTapSlot) + slot_bytes
+//
+// Todos los enteros están en el orden de bytes de la máquina. Los píxeles de
+// una fila son contiguos; entre filas hay "stride" bytes.
+//
+// Protocolo (seqlock por slot):
+//  - El escritor pone seq en impar, copia píxeles y metadatos, pone seq en
+//    el par siguiente y recién entonces actualiza header.latest.
+//  - El lector toma latest, mira el slot latest % slot_count, lee seq (debe
+//    ser par y frame_number == latest), usa los datos y vuelve a leer seq: si
+//    cambió, el frame se pisó mientras se leía y hay que descartarlo.
+//  - El escritor recorre los slots en orden, así que un frame sigue intacto
+//    durante los slot_count - 1 frames siguientes.
+//
+// Si el escritor se reinicia (la cámara se reconecta) el segmento se vuelve a
+// crear con el mismo nombre; los lectores tienen que volver a abrirlo
+// (FrameTapReader::reopenIfReplaced).
+
+#include <atomic>
+#include <stdint.h>
+
+namespace qtvcr {
+
+const uint32_t FRAME_TAP_MAGIC = 0x52435651; // "QVCR"
+const uint32_t FRAME_TAP_VERSION = 2;
+const int FRAME_TAP_MAX_DETECTIONS = 32;
+
+enum FrameTapFormat
+{
+    FRAME_TAP_BGR24 = 1, // 3 bytes por píxel, orden B, G, R
+    FRAME_TAP_GRAY8 = 2  // 1 byte por píxel
+};
+
+struct FrameTapHeader
+{
+    uint32_t magic;                    // FRAME_TAP_MAGIC, se escribe al final de la creación
+    uint32_t version;                  // FRAME_TAP_VERSION
+    uint32_t slot_count;
+    uint32_t slot_bytes;               // capacidad de píxeles de cada slot (múltiplo de 64)
+    std::atomic<uint64_t> latest;      // frame_number del último frame publicado (0 = ninguno)
+    std::atomic<int64_t> heartbeat_ms; // CLOCK_MONOTONIC (ms) de la última publicación
+    int32_t writer_pid;
+    uint8_t reserved[28];
+};
+
+// Persona detectada, en coordenadas del frame original (source_width x source_height)
+struct FrameTapDetection
+{
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    float score;
+    int32_t track_id; // misma persona en frames sucesivos; -1 = sin seguimiento
+};
+
+struct FrameTapSlot
+{
+    std::atomic<uint64_t> seq;   // impar mientras se escribe
+    uint64_t frame_number;       // empieza en 1
+    int64_t timestamp_ms;        // CLOCK_MONOTONIC (ms) de la captura
+    int64_t epoch_ms;            // hora de la captura, ms desde 1970 (UTC)
+    int64_t detections_epoch_ms; // hora del análisis que produjo "detections" (0 = nunca)
+    int32_t width;               // tamaño de la imagen publicada
+    int32_t height;
+    int32_t stride;
+    int32_t format;              // FrameTapFormat
+    int32_t source_width;        // tamaño del frame de la cámara
+    int32_t source_height;
+    int32_t detection_count;
+    uint32_t reserved0;
+    uint8_t reserved[56];
+    FrameTapDetection detections[FRAME_TAP_MAX_DETECTIONS];
+};
+
+static_assert(sizeof(FrameTapHeader) == 64, "FrameTapHeader ocupa 64 bytes");
+static_assert(sizeof(FrameTapDetection) == 24, "FrameTapDetection ocupa 24 bytes");
+static_assert(sizeof(FrameTapSlot) == 896, "FrameTapSlot ocupa 896 bytes");
+
+}
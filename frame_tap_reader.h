@@ -0,0 +1,221 @@
+#pragma once
+
+// Lector del anillo de frames de QtVCR (ver frame_tap_format.h).
+//
+// Solo usa POSIX y C++11; se compila con "g++ -std=c++11 programa.cpp -lrt".
+//
+//   qtvcr::FrameTapReader tap;
+//   if (!tap.open("/qtvcr-tap-cam1"))
+//       return 1;
+//   qtvcr::FrameTapReader::Frame frame;
+//   std::vector<uint8_t> pixels;
+//   uint64_t last = 0;
+//   while (true)
+//   {
+//       tap.reopenIfReplaced();
+//       if (tap.copyLatest(frame, pixels, last))
+//       {
+//           last = frame.frame_number;
+//           // pixels: frame.height filas de frame.width * bytesPerPixel(frame.format)
+//       }
+//       usleep(10000);
+//   }
+//
+// latest() no copia: frame.data apunta a la memoria compartida y hay que
+// confirmar con isValid() después de usarla. copyLatest() copia y valida.
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "frame_tap_format.h"
+
+namespace qtvcr {
+
+class FrameTapReader
+{
+public:
+    struct Frame
+    {
+        const uint8_t *data;
+        int width;
+        int height;
+        int stride;
+        FrameTapFormat format;
+        uint64_t frame_number;
+        int64_t timestamp_ms;
+        int64_t epoch_ms;
+        int64_t detections_epoch_ms;
+        int source_width;
+        int source_height;
+        std::vector<FrameTapDetection> detections;
+        int slot;
+        uint64_t seq;
+    };
+
+    FrameTapReader() : fd(-1), base(nullptr), size(0), header(nullptr), slot_stride(0), inode(0) {}
+    ~FrameTapReader() { close(); }
+
+    static int bytesPerPixel(FrameTapFormat format) { return format == FRAME_TAP_GRAY8 ? 1 : 3; }
+
+    bool open(const char *name)
+    {
+        close();
+        fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(FrameTapHeader))
+        {
+            close();
+            return false;
+        }
+        size = size_t(st.st_size);
+        inode = st.st_ino;
+        void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+        base = static_cast<const uint8_t *>(p);
+        header = reinterpret_cast<const FrameTapHeader *>(base);
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        slot_stride = sizeof(FrameTapSlot) + header->slot_bytes;
+        if (header->magic != FRAME_TAP_MAGIC || header->version != FRAME_TAP_VERSION ||
+            header->slot_count == 0 || sizeof(FrameTapHeader) + slot_stride * header->slot_count > size)
+        {
+            close();
+            return false;
+        }
+        this->name = name;
+        return true;
+    }
+
+    void close()
+    {
+        if (base != nullptr)
+            munmap(const_cast<uint8_t *>(base), size);
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+        base = nullptr;
+        header = nullptr;
+        size = 0;
+        inode = 0;
+    }
+
+    bool isOpen() const { return header != nullptr; }
+
+    // Si el escritor volvió a crear el segmento (mismo nombre, otro objeto) se
+    // abre el nuevo. Devuelve true si se cambió.
+    bool reopenIfReplaced()
+    {
+        if (name.empty())
+            return false;
+        int probe = shm_open(name.c_str(), O_RDONLY, 0);
+        if (probe < 0)
+            return false;
+        struct stat st;
+        bool replaced = fstat(probe, &st) == 0 && (!isOpen() || st.st_ino != inode);
+        ::close(probe);
+        if (!replaced)
+            return false;
+        std::string n = name;
+        return open(n.c_str());
+    }
+
+    int64_t heartbeatMs() const { return header ? header->heartbeat_ms.load(std::memory_order_acquire) : 0; }
+    int writerPid() const { return header ? header->writer_pid : 0; }
+
+    // Último frame completo más nuevo que "after", sin copiar
+    bool latest(Frame &frame, uint64_t after = 0) const
+    {
+        if (header == nullptr)
+            return false;
+
+        // Si el escritor está justo en el slot más nuevo se prueba con el anterior
+        const uint64_t newest = header->latest.load(std::memory_order_acquire);
+        for (uint64_t number = newest; number > after && number + header->slot_count > newest; number--)
+        {
+            const int index = int(number % header->slot_count);
+            const FrameTapSlot *s = slot(index);
+            const uint64_t seq = s->seq.load(std::memory_order_acquire);
+            if ((seq & 1) || s->frame_number != number)
+                continue;
+
+            frame.data = reinterpret_cast<const uint8_t *>(s) + sizeof(FrameTapSlot);
+            frame.width = s->width;
+            frame.height = s->height;
+            frame.stride = s->stride;
+            frame.format = FrameTapFormat(s->format);
+            frame.frame_number = number;
+            frame.timestamp_ms = s->timestamp_ms;
+            frame.epoch_ms = s->epoch_ms;
+            frame.detections_epoch_ms = s->detections_epoch_ms;
+            frame.source_width = s->source_width;
+            frame.source_height = s->source_height;
+            int count = s->detection_count;
+            if (count < 0 || count > FRAME_TAP_MAX_DETECTIONS)
+                count = 0;
+            frame.detections.assign(s->detections, s->detections + count);
+            frame.slot = index;
+            frame.seq = seq;
+            if (size_t(frame.stride) * frame.height <= header->slot_bytes && isValid(frame))
+                return true;
+        }
+        return false;
+    }
+
+    // true si el slot del frame no se reescribió desde latest()
+    bool isValid(const Frame &frame) const
+    {
+        if (header == nullptr)
+            return false;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot(frame.slot)->seq.load(std::memory_order_relaxed) == frame.seq;
+    }
+
+    // Como latest(), pero copia los píxeles (filas contiguas, sin stride) y valida
+    bool copyLatest(Frame &frame, std::vector<uint8_t> &pixels, uint64_t after = 0) const
+    {
+        for (int attempt = 0; attempt < 3; attempt++)
+        {
+            if (!latest(frame, after))
+                return false;
+            const size_t row = size_t(frame.width) * bytesPerPixel(frame.format);
+            pixels.resize(row * frame.height);
+            for (int y = 0; y < frame.height; y++)
+                memcpy(&pixels[y * row], frame.data + size_t(y) * frame.stride, row);
+            if (isValid(frame))
+            {
+                frame.data = pixels.data();
+                frame.stride = int(row);
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    const FrameTapSlot *slot(int index) const
+    {
+        return reinterpret_cast<const FrameTapSlot *>(base + sizeof(FrameTapHeader) + slot_stride * index);
+    }
+
+    std::string name;
+    int fd;
+    const uint8_t *base;
+    size_t size;
+    const FrameTapHeader *header;
+    size_t slot_stride;
+    ino_t inode;
+};
+
+}
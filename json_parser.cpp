@@ -60,6 +60,27 @@ QString JsonParser::getParam(const QString &jsonString, const QString &paramPath
 
     return QString(); // Debería ser inaccesible si la lógica es correcta, pero se añade por seguridad.
 }
+QJsonValue JsonParser::getValue(const QString &jsonString, const QString &paramPath)
+{
+    QJsonDocument doc = QJsonDocument::fromJson(jsonString.toUtf8());
+
+    if (doc.isNull() || !doc.isObject()) {
+        qWarning() << "Error: La cadena no es un documento JSON válido con un objeto raíz.";
+        return QJsonValue(QJsonValue::Undefined);
+    }
+
+    QJsonValue value = doc.object();
+    QStringList pathSegments = paramPath.split('.');
+
+    for (int i = 0; i < pathSegments.size(); ++i) {
+        if (!value.isObject()) {
+            qWarning() << "Advertencia: La clave intermedia '" << pathSegments.at(i - 1) << "' no es un objeto. No se puede continuar la ruta.";
+            return QJsonValue(QJsonValue::Undefined);
+        }
+        value = value.toObject().value(pathSegments.at(i));
+    }
+    return value;
+}
 int JsonParser::getParamCount(const QString &jsonString)
 {
     // 1. Convertir QString a QJsonDocument
@@ -25,5 +25,13 @@ public:
      * @return El valor del parámetro como QString, o un QString vacío si no se encuentra o hay error.
      */
     QString getParam(const QString &jsonString, const QString &paramPath);
+
+    /**
+     * @brief Igual que getParam pero devuelve el QJsonValue sin convertir,
+     * para parámetros que son arreglos u objetos (ej. las zonas de una cámara).
+     *
+     * @return El valor, o un QJsonValue Undefined si no se encuentra o hay error.
+     */
+    QJsonValue getValue(const QString &jsonString, const QString &paramPath);
     int getParamCount(const QString &jsonString);
 };
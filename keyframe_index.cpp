@@ -0,0 +1,215 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include "utilities.h"
+#include "keyframe_index.h"
+
+using namespace qtvcr;
+
+namespace {
+// La API del índice del contenedor cambió en FFmpeg 5 (libavformat 59)
+int indexEntryCount(AVStream *stream)
+{
+#if LIBAVFORMAT_VERSION_MAJOR >= 59
+    return avformat_index_get_entries_count(stream);
+#else
+    return stream->nb_index_entries;
+#endif
+}
+
+const AVIndexEntry *indexEntry(AVStream *stream, int i)
+{
+#if LIBAVFORMAT_VERSION_MAJOR >= 59
+    return avformat_index_get_entry(stream, i);
+#else
+    return &stream->index_entries[i];
+#endif
+}
+}
+
+KeyframeIndex::KeyframeIndex()
+{
+    memset(&header, 0, sizeof(header));
+}
+
+bool KeyframeIndex::loadOrBuild(const QString &name)
+{
+    QString video = Utilities::getSavedVideoPath(name, "mp4");
+    QString path = Utilities::getSavedVideoPath(name, "kfi");
+    QFileInfo index_info(path);
+    if (index_info.exists() && index_info.lastModified() >= QFileInfo(video).lastModified() && load(path))
+    {
+        return true;
+    }
+    if (!build(video))
+    {
+        return false;
+    }
+    save(path);
+    return true;
+}
+
+bool KeyframeIndex::build(const QString &video_path)
+{
+    AVFormatContext *format = nullptr;
+    if (avformat_open_input(&format, video_path.toUtf8().constData(), nullptr, nullptr) < 0)
+    {
+        qWarning() << "No se pudo abrir" << video_path << "para indexar";
+        return false;
+    }
+    if (avformat_find_stream_info(format, nullptr) < 0)
+    {
+        avformat_close_input(&format);
+        return false;
+    }
+    int s = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (s < 0)
+    {
+        avformat_close_input(&format);
+        return false;
+    }
+    AVStream *stream = format->streams[s];
+    AVRational rate = stream->avg_frame_rate.num > 0 ? stream->avg_frame_rate : stream->r_frame_rate;
+    // Grabaciones VFR: la tasa nominal la deja LibavWriter en los metadatos
+    const AVDictionaryEntry *nominal = av_dict_get(format->metadata, "fps", nullptr, 0);
+    if (nominal != nullptr && atof(nominal->value) > 0)
+    {
+        rate = av_d2q(atof(nominal->value), 100000);
+    }
+    // Sin reordenamiento (sin B-frames) el número de frame sale del pts: con
+    // frames omitidos (VFR) el número de muestra no sirve
+    const bool by_pts = stream->codecpar->video_delay == 0;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, KEYFRAME_INDEX_MAGIC, sizeof(header.magic));
+    header.version = KEYFRAME_INDEX_VERSION;
+    header.header_size = sizeof(KeyframeIndexHeader);
+    header.entry_size = sizeof(KeyframeIndexEntry);
+    header.time_base_num = stream->time_base.num;
+    header.time_base_den = stream->time_base.den;
+    header.fps_num = rate.num;
+    header.fps_den = rate.den;
+    header.start_pts = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    entries.clear();
+
+    // mp4: el índice de muestras ya está en el moov, no hace falta leer el archivo.
+    // Con GOP cerrado el número de muestra de un keyframe es su número de frame.
+    const int count = indexEntryCount(stream);
+    int64_t frame_count = count;
+    for (int i = 0; i < count; i++)
+    {
+        const AVIndexEntry *e = indexEntry(stream, i);
+        const int64_t frame = by_pts ? frameOfPts(e->timestamp) : i;
+        if (e->flags & AVINDEX_KEYFRAME)
+        {
+            KeyframeIndexEntry entry = {e->timestamp, e->pos, uint32_t(frame), 0};
+            entries.push_back(entry);
+        }
+        frame_count = qMax(frame_count, frame + 1);
+    }
+    header.frame_count = frame_count;
+
+    if (entries.empty())
+    {
+        // Sin índice en el contenedor: se recorren los paquetes (sin decodificar)
+        AVPacket *packet = av_packet_alloc();
+        int64_t frames = 0;
+        while (av_read_frame(format, packet) >= 0)
+        {
+            if (packet->stream_index == s)
+            {
+                const int64_t ts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+                const int64_t frame = by_pts && ts != AV_NOPTS_VALUE ? frameOfPts(ts) : frames;
+                if (packet->flags & AV_PKT_FLAG_KEY)
+                {
+                    KeyframeIndexEntry entry = {ts, packet->pos, uint32_t(frame), 0};
+                    entries.push_back(entry);
+                }
+                frames = qMax(frames + 1, frame + 1);
+            }
+            av_packet_unref(packet);
+        }
+        av_packet_free(&packet);
+        header.frame_count = frames;
+    }
+    avformat_close_input(&format);
+
+    header.count = uint32_t(entries.size());
+    return !entries.empty();
+}
+
+bool KeyframeIndex::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    KeyframeIndexHeader h;
+    if (file.read(reinterpret_cast<char *>(&h), sizeof(h)) != sizeof(h) ||
+        memcmp(h.magic, KEYFRAME_INDEX_MAGIC, sizeof(h.magic)) != 0 || h.version != KEYFRAME_INDEX_VERSION ||
+        h.header_size != sizeof(KeyframeIndexHeader) || h.entry_size != sizeof(KeyframeIndexEntry) || h.count == 0)
+    {
+        return false;
+    }
+    std::vector<KeyframeIndexEntry> e(h.count);
+    const qint64 bytes = qint64(h.count) * sizeof(KeyframeIndexEntry);
+    if (file.read(reinterpret_cast<char *>(e.data()), bytes) != bytes)
+    {
+        return false;
+    }
+    header = h;
+    entries.swap(e);
+    return true;
+}
+
+bool KeyframeIndex::save(const QString &path) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return false;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(entries.data()), qint64(entries.size() * sizeof(KeyframeIndexEntry)));
+    return true;
+}
+
+double KeyframeIndex::fps() const
+{
+    return header.fps_num > 0 && header.fps_den > 0 ? double(header.fps_num) / header.fps_den : 30;
+}
+
+const KeyframeIndexEntry &KeyframeIndex::keyframeFor(int64_t frame) const
+{
+    auto it = std::upper_bound(entries.begin(), entries.end(), frame,
+                               [](int64_t f, const KeyframeIndexEntry &e) { return f < int64_t(e.frame); });
+    return it == entries.begin() ? entries.front() : *(it - 1);
+}
+
+int64_t KeyframeIndex::frameOfPts(int64_t pts) const
+{
+    if (header.time_base_den == 0)
+    {
+        return 0;
+    }
+    return llround(double(pts - header.start_pts) * header.time_base_num / header.time_base_den * fps());
+}
+
+int64_t KeyframeIndex::ptsOfFrame(int64_t frame) const
+{
+    if (header.time_base_num == 0)
+    {
+        return header.start_pts;
+    }
+    return header.start_pts + llround(frame / fps() * header.time_base_den / header.time_base_num);
+}
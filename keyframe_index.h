@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <QString>
+
+// Índice de keyframes de una grabación, en <nombre>.kfi.
+//
+//   [KeyframeIndexHeader 64 B][KeyframeIndexEntry 24 B] x count
+//
+// Se genera al cerrar la grabación leyendo el índice del contenedor (o, si no
+// lo tiene, recorriendo los paquetes sin decodificar) para que el reproductor
+// pueda ir a cualquier frame buscando el keyframe anterior y decodificando
+// solo desde ahí. Los tiempos están en la base de tiempo del stream de video.
+
+namespace qtvcr {
+
+const char KEYFRAME_INDEX_MAGIC[8] = {'Q', 'V', 'C', 'R', 'K', 'F', 'I', '\0'};
+const uint32_t KEYFRAME_INDEX_VERSION = 1;
+
+struct KeyframeIndexHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t entry_size;
+    uint32_t count;
+    int32_t time_base_num;
+    int32_t time_base_den;
+    int32_t fps_num;
+    int32_t fps_den;
+    int64_t start_pts;
+    int64_t frame_count;
+    uint8_t reserved[8];
+};
+
+struct KeyframeIndexEntry
+{
+    int64_t timestamp; // para av_seek_frame (mismo dominio que el índice del contenedor)
+    int64_t pos;       // byte en el archivo, -1 si no se conoce
+    uint32_t frame;    // número de frame en orden de presentación
+    uint32_t reserved;
+};
+
+static_assert(sizeof(KeyframeIndexHeader) == 64, "KeyframeIndexHeader cambió de tamaño");
+static_assert(sizeof(KeyframeIndexEntry) == 24, "KeyframeIndexEntry cambió de tamaño");
+
+} // namespace qtvcr
+
+class KeyframeIndex
+{
+public:
+    KeyframeIndex();
+
+    // Lee el .kfi de la grabación o lo genera (y lo guarda) si falta
+    bool loadOrBuild(const QString &name);
+
+    bool build(const QString &video_path);
+    bool load(const QString &path);
+    bool save(const QString &path) const;
+
+    bool isEmpty() const { return entries.empty(); }
+    int64_t frameCount() const { return header.frame_count; }
+    double fps() const;
+    int64_t startPts() const { return header.start_pts; }
+    int timeBaseNum() const { return header.time_base_num; }
+    int timeBaseDen() const { return header.time_base_den; }
+
+    // Último keyframe en o antes del frame
+    const qtvcr::KeyframeIndexEntry &keyframeFor(int64_t frame) const;
+
+    // Frame que corresponde a un pts del stream (y al revés)
+    int64_t frameOfPts(int64_t pts) const;
+    int64_t ptsOfFrame(int64_t frame) const;
+
+private:
+    qtvcr::KeyframeIndexHeader header;
+    std::vector<qtvcr::KeyframeIndexEntry> entries;
+};
@@ -0,0 +1,219 @@
+#include <memory>
+#include <QDebug>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+#include "thread_placement.h"
+#include "libav_writer.h"
+
+namespace {
+const int IO_BUFFER_SIZE = 256 * 1024;
+
+// El muxer escribe con estas funciones sobre el StorageFile
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+int writePacket(void *opaque, const uint8_t *data, int size)
+#else
+int writePacket(void *opaque, uint8_t *data, int size)
+#endif
+{
+    return static_cast<StorageFile *>(opaque)->write(data, size) ? size : AVERROR(EIO);
+}
+
+int64_t seekFile(void *opaque, int64_t offset, int whence)
+{
+    StorageFile *file = static_cast<StorageFile *>(opaque);
+    if (whence & AVSEEK_SIZE)
+    {
+        return file->size();
+    }
+    return file->seek(offset, whence & ~AVSEEK_FORCE);
+}
+}
+
+LibavWriter::LibavWriter() :
+    format(nullptr), codec(nullptr), stream(nullptr), picture(nullptr), packet(nullptr), scaler(nullptr),
+    last_pts(-1)
+{
+}
+
+LibavWriter::~LibavWriter()
+{
+    release();
+}
+
+bool LibavWriter::open(const QString &path, const Options &options)
+{
+    release();
+    this->options = options;
+    const QByteArray file_name = path.toUtf8();
+
+    // libx264 si está; si no, el H.264 que tenga FFmpeg y en último caso MPEG-4
+    const AVCodec *encoder = avcodec_find_encoder_by_name("libx264");
+    if (encoder == nullptr)
+        encoder = avcodec_find_encoder(AV_CODEC_ID_H264);
+    if (encoder == nullptr)
+        encoder = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    if (encoder == nullptr || avformat_alloc_output_context2(&format, nullptr, "mp4", file_name.constData()) < 0)
+    {
+        qWarning() << "No hay encoder de video disponible para" << path;
+        release();
+        return false;
+    }
+
+    codec = avcodec_alloc_context3(encoder);
+    codec->width = options.size.width & ~1;
+    codec->height = options.size.height & ~1;
+    codec->pix_fmt = AV_PIX_FMT_YUV420P;
+    codec->time_base = AVRational{1, 1000};
+    codec->framerate = av_d2q(options.fps, 1000);
+    codec->gop_size = qMax(1, options.gop);
+    codec->max_b_frames = 0;
+    codec->thread_count = options.threads;
+    if (format->oformat->flags & AVFMT_GLOBALHEADER)
+        codec->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    AVDictionary *settings = nullptr;
+    av_dict_set(&settings, "preset", options.preset.toUtf8().constData(), 0);
+    av_dict_set_int(&settings, "crf", options.crf, 0);
+    int opened;
+    {
+        // Los hilos del encoder se crean acá y heredan la ubicación de la etapa codificacion
+        std::unique_ptr<ThreadPlacement::Scope> placement;
+        if (!options.camera_key.isEmpty())
+            placement.reset(new ThreadPlacement::Scope(ThreadPlacement::ENCODING, options.camera_key));
+        opened = avcodec_open2(codec, encoder, &settings);
+    }
+    av_dict_free(&settings);
+    if (opened < 0)
+    {
+        qWarning() << "No se pudo abrir el encoder" << encoder->name;
+        release();
+        return false;
+    }
+
+    stream = avformat_new_stream(format, nullptr);
+    avcodec_parameters_from_context(stream->codecpar, codec);
+    stream->time_base = codec->time_base;
+    stream->avg_frame_rate = codec->framerate;
+    // Con VFR la tasa que calcula el demuxer es la promedio: la nominal va como
+    // metadato para que el índice de keyframes numere los frames igual que acá
+    av_dict_set(&format->metadata, "fps", QByteArray::number(options.fps, 'g', 10).constData(), 0);
+    if (!options.tier.isEmpty())
+        av_dict_set(&format->metadata, "nivel", options.tier.toUtf8().constData(), 0);
+    AVDictionary *muxer_settings = nullptr;
+    if (options.fragment_ms > 0)
+    {
+        // mp4 fragmentado: moov vacío al principio y un moof+mdat autocontenido
+        // cada fragment_ms (cortando en keyframes). Si el proceso muere el
+        // archivo se puede reproducir hasta el último fragmento, y cerrar
+        // cuesta lo mismo sin importar el largo.
+        av_dict_set(&muxer_settings, "movflags", "+use_metadata_tags+frag_keyframe+empty_moov+default_base_moof", 0);
+        av_dict_set_int(&muxer_settings, "min_frag_duration", int64_t(options.fragment_ms) * 1000, 0);
+    }
+    else
+    {
+        av_dict_set(&muxer_settings, "movflags", "+use_metadata_tags", 0);
+    }
+    bool written = file.open(path, options.storage);
+    if (written)
+    {
+        uint8_t *buffer = static_cast<uint8_t *>(av_malloc(IO_BUFFER_SIZE));
+        format->pb = avio_alloc_context(buffer, IO_BUFFER_SIZE, 1, &file, nullptr, writePacket, seekFile);
+        format->flags |= AVFMT_FLAG_CUSTOM_IO;
+        written = avformat_write_header(format, &muxer_settings) >= 0;
+    }
+    av_dict_free(&muxer_settings);
+    if (!written)
+    {
+        qWarning() << "No se pudo crear" << path;
+        release();
+        return false;
+    }
+
+    picture = av_frame_alloc();
+    picture->format = codec->pix_fmt;
+    picture->width = codec->width;
+    picture->height = codec->height;
+    av_frame_get_buffer(picture, 0);
+    packet = av_packet_alloc();
+    scaler = sws_getContext(options.size.width, options.size.height, AV_PIX_FMT_BGR24,
+                            codec->width, codec->height, AV_PIX_FMT_YUV420P, SWS_BILINEAR,
+                            nullptr, nullptr, nullptr);
+    last_pts = -1;
+    return true;
+}
+
+bool LibavWriter::write(const cv::Mat &frame, qint64 pts_ms)
+{
+    if (format == nullptr || frame.cols != options.size.width || frame.rows != options.size.height)
+    {
+        return false;
+    }
+    if (av_frame_make_writable(picture) < 0)
+    {
+        return false;
+    }
+    const uint8_t *src[1] = {frame.data};
+    const int src_stride[1] = {int(frame.step)};
+    sws_scale(scaler, src, src_stride, 0, frame.rows, picture->data, picture->linesize);
+
+    picture->pts = qMax(pts_ms, last_pts + 1);
+    last_pts = picture->pts;
+    if (avcodec_send_frame(codec, picture) < 0)
+    {
+        return false;
+    }
+    return writePackets();
+}
+
+bool LibavWriter::writePackets()
+{
+    while (avcodec_receive_packet(codec, packet) == 0)
+    {
+        av_packet_rescale_ts(packet, codec->time_base, stream->time_base);
+        packet->stream_index = stream->index;
+        const bool keyframe = packet->flags & AV_PKT_FLAG_KEY;
+        if (av_interleaved_write_frame(format, packet) < 0)
+        {
+            return false;
+        }
+        if (keyframe && options.fragment_ms > 0)
+        {
+            // El fragmento anterior se cierra al llegar un keyframe: se saca del
+            // buffer de avio y se pide el writeback
+            avio_flush(format->pb);
+            file.checkpoint();
+        }
+    }
+    return true;
+}
+
+void LibavWriter::release()
+{
+    if (format != nullptr && format->pb != nullptr && codec != nullptr && packet != nullptr)
+    {
+        avcodec_send_frame(codec, nullptr);
+        writePackets();
+        av_write_trailer(format);
+    }
+    if (format != nullptr && format->pb != nullptr)
+    {
+        avio_flush(format->pb);
+        av_freep(&format->pb->buffer);
+        avio_context_free(&format->pb);
+    }
+    file.close();
+    sws_freeContext(scaler);
+    scaler = nullptr;
+    av_packet_free(&packet);
+    av_frame_free(&picture);
+    avcodec_free_context(&codec);
+    avformat_free_context(format);
+    format = nullptr;
+    stream = nullptr;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QString>
+#include "opencv2/opencv.hpp"
+#include "storage_file.h"
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVStream;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+// Encoder H.264 + mp4 con libavcodec/libavformat para las grabaciones.
+//
+// A diferencia de cv::VideoWriter cada frame lleva su propio tiempo (ms desde
+// el comienzo), así que se pueden omitir frames repetidos y el contenedor
+// queda con tiempos variables (VFR): el reproductor muestra el último frame
+// hasta el siguiente. Sin B-frames, para que el orden de decodificación sea
+// el de presentación (el índice de keyframes y los recortes dependen de eso).
+//
+// El mp4 se escribe a través de StorageFile (reserva de espacio, writeback
+// por tramos y límite por disco) con un AVIOContext propio.
+class LibavWriter
+{
+public:
+    struct Options
+    {
+        double fps;       // nominal (metadato y control de tasa)
+        cv::Size size;
+        int gop;          // frames entre keyframes
+        QString preset;   // libx264: ultrafast..veryslow
+        int crf;          // libx264: calidad constante (menor = mejor)
+        int threads;      // hilos del encoder; 0 = automático
+        QString tier;     // metadato "nivel" del mp4 (vacío = grabación original)
+        int fragment_ms;  // mp4 fragmentado cada tanto; 0 = mp4 normal (índice al cerrar)
+        StorageFile::Options storage;
+        QString camera_key; // ubicación de los hilos del encoder (thread_placement.h); vacío = la de quien abre
+
+        Options() : fps(30), gop(30), preset("veryfast"), crf(23), threads(0), fragment_ms(0) {}
+    };
+
+    LibavWriter();
+    ~LibavWriter();
+
+    bool open(const QString &path, const Options &options);
+    bool isOpened() const { return format != nullptr; }
+
+    // frame BGR del tamaño de Options::size. pts_ms tiene que crecer.
+    bool write(const cv::Mat &frame, qint64 pts_ms);
+
+    // Vacía el encoder y cierra el archivo
+    void release();
+
+    double fps() const { return options.fps; }
+
+private:
+    bool writePackets();
+
+    Options options;
+    StorageFile file;
+    AVFormatContext *format;
+    AVCodecContext *codec;
+    AVStream *stream;
+    AVFrame *picture;
+    AVPacket *packet;
+    SwsContext *scaler;
+    qint64 last_pts;
+};
@@ -0,0 +1,89 @@
+#include <QDebug>
+
+#include "metrics.h"
+#include "event_stream.h"
+#include "load_shedder.h"
+
+namespace {
+// Tiempos de histéresis para no oscilar entre niveles
+const int ESCALATE_AFTER_MS = 500;
+const int RECOVER_AFTER_MS = 3000;
+const int MIN_LEVEL_MS = 1000;
+}
+
+LoadShedder::LoadShedder() :
+    max_age_ms(500), max_queue(8), current(NORMAL)
+{
+}
+
+void LoadShedder::configure(const QString &camera_key, int max_age_ms, int max_queue)
+{
+    this->camera_key = camera_key;
+    this->max_age_ms = max_age_ms;
+    this->max_queue = max_queue;
+    current = NORMAL;
+    pressure_since.invalidate();
+    calm_since.start();
+    last_change.start();
+}
+
+void LoadShedder::update(int queue_depth, qint64 frame_age_ms)
+{
+    bool pressure = frame_age_ms > max_age_ms || queue_depth > max_queue / 2;
+    Metrics::set(camera_key + ".cola_frames", queue_depth);
+    Metrics::set(camera_key + ".antiguedad_frame_ms", double(frame_age_ms));
+
+    if (pressure)
+    {
+        calm_since.invalidate();
+        if (!pressure_since.isValid())
+            pressure_since.start();
+        if (current < ANALYSIS_SUSPENDED &&
+            pressure_since.elapsed() >= ESCALATE_AFTER_MS &&
+            last_change.elapsed() >= MIN_LEVEL_MS)
+        {
+            setLevel(Level(current + 1), queue_depth, frame_age_ms);
+        }
+    }
+    else
+    {
+        pressure_since.invalidate();
+        if (!calm_since.isValid())
+            calm_since.start();
+        if (current > NORMAL &&
+            calm_since.elapsed() >= RECOVER_AFTER_MS &&
+            last_change.elapsed() >= MIN_LEVEL_MS)
+        {
+            setLevel(Level(current - 1), queue_depth, frame_age_ms);
+            calm_since.start(); // cada paso de recuperación espera su propio intervalo
+        }
+    }
+}
+
+void LoadShedder::setLevel(Level level, int queue_depth, qint64 frame_age_ms)
+{
+    qDebug() << "Carga" << camera_key << ":" << levelName(current) << "->" << levelName(level)
+             << "(cola" << queue_depth << "frames, antigüedad" << frame_age_ms << "ms)";
+    current = level;
+    last_change.start();
+    Metrics::set(camera_key + ".nivel_carga", QString(levelName(level)));
+    Metrics::add(camera_key + ".cambios_nivel_carga", 1);
+
+    QJsonObject fields;
+    fields.insert("nivel", QString(levelName(level)));
+    fields.insert("cola", queue_depth);
+    fields.insert("antiguedad_ms", double(frame_age_ms));
+    EventStream::publish(camera_key, "carga", fields);
+}
+
+const char *LoadShedder::levelName(Level level)
+{
+    switch (level)
+    {
+    case NORMAL: return "normal";
+    case PREVIEW_REDUCED: return "preview_reducida";
+    case DETECTION_REDUCED: return "deteccion_reducida";
+    case ANALYSIS_SUSPENDED: return "analisis_suspendido";
+    }
+    return "?";
+}
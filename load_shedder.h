@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QString>
+#include <QElapsedTimer>
+
+// Controlador de sobrecarga de una cámara.
+//
+// Mira la profundidad de la cola del FrameGrabber y la antigüedad de cada
+// frame al procesarlo. Si el análisis se atrasa sube un nivel a la vez, y
+// cuando la presión desaparece baja de a uno:
+//
+//   NORMAL               todo activo
+//   PREVIEW_REDUCED      vista previa a 1 de cada 3 frames
+//   DETECTION_REDUCED    además, la detección corre 4 veces menos seguido
+//   ANALYSIS_SUSPENDED   además, sin grabación activa no se analiza
+//
+// Los frames que van a una grabación nunca se descartan (ver FrameGrabber).
+class LoadShedder
+{
+public:
+    enum Level
+    {
+        NORMAL,
+        PREVIEW_REDUCED,
+        DETECTION_REDUCED,
+        ANALYSIS_SUSPENDED
+    };
+
+    LoadShedder();
+
+    void configure(const QString &camera_key, int max_age_ms, int max_queue);
+    void update(int queue_depth, qint64 frame_age_ms);
+
+    Level level() const { return current; }
+    bool skipPreview(quint64 seq) const { return current >= PREVIEW_REDUCED && seq % 3 != 0; }
+    double detectionFactor() const { return current >= DETECTION_REDUCED ? 4.0 : 1.0; }
+    bool suspendAnalysis(bool recording) const { return current >= ANALYSIS_SUSPENDED && !recording; }
+
+    static const char *levelName(Level level);
+
+private:
+    void setLevel(Level level, int queue_depth, qint64 frame_age_ms);
+
+    QString camera_key;
+    int max_age_ms;
+    int max_queue;
+
+    Level current;
+    QElapsedTimer pressure_since;  // inválido si no hay presión
+    QElapsedTimer calm_since;      // inválido si hay presión
+    QElapsedTimer last_change;
+};
@@ -1,11 +1,77 @@
 #include <QApplication>
 #include "mainwindow.h"
+#include "benchmarks.h"
+#include "camera_worker.h"
+#include "detection_index.h"
+#include "clip_export.h"
+#include "archive_transcoder.h"
+#include "async_io.h"
+#include "metrics.h"
+#include "thread_placement.h"
+#include "video_recorder.h"
 
 int main(int argc, char *argv[])
 {
+    // Modos sin ventana
+    for (int i = 1; i < argc; i++)
+    {
+        QString arg(argv[i]);
+        if (arg.startsWith("bench="))
+        {
+            QCoreApplication app(argc, argv);
+            return Benchmarks::run(arg.mid(6));
+        }
+        if (arg == "buscar")
+        {
+            // Búsqueda en el índice de detecciones (ver DetectionIndex::runCli)
+            QCoreApplication app(argc, argv);
+            return DetectionIndex::runCli(app.arguments().mid(i + 1));
+        }
+        if (arg == "exportar")
+        {
+            // Recorte/unión de grabaciones sin recodificar (ver ClipExport::runCli)
+            QCoreApplication app(argc, argv);
+            return ClipExport::runCli(app.arguments().mid(i + 1));
+        }
+        if (arg == "archivar")
+        {
+            // Una pasada del archivado de grabaciones viejas (ver ArchiveTranscoder)
+            QCoreApplication app(argc, argv);
+            return ArchiveTranscoder::runCli();
+        }
+        if (CameraWorker::isWorkerArgument(arg))
+        {
+            // Proceso trabajador de una cámara, lanzado por WorkerSupervisor
+            QCoreApplication app(argc, argv);
+            QString ring_name;
+            foreach (const QString &a, app.arguments())
+            {
+                if (a.startsWith("ring="))
+                    ring_name = a.mid(5);
+            }
+            int result;
+            {
+                CameraWorker worker(ring_name);
+                result = app.exec();
+            }
+            AsyncIO::instance()->waitForIdle(); // índices y archivos auxiliares pendientes
+            Metrics::removeFile();
+            return result;
+        }
+    }
+
     QApplication app(argc, argv);
-    MainWindow window;
-    window.setWindowTitle("QtVCR");
-    window.show();
-    return app.exec();
+    ThreadPlacement::apply(ThreadPlacement::GUI);
+    VideoRecorder::removeStaleSpares();
+    Metrics::removeStale();
+    int result;
+    {
+        MainWindow window;
+        window.setWindowTitle("QtVCR");
+        window.show();
+        result = app.exec();
+    }
+    AsyncIO::instance()->waitForIdle();
+    Metrics::removeFile();
+    return result;
 }
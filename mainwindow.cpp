@@ -3,22 +3,35 @@
 #include <QMessageBox>
 #include <QPixmap>
 #include <QKeyEvent>
+#include <QMouseEvent>
 #include <QDebug>
 #include <QCameraInfo>
 #include <QGridLayout>
 #include <QIcon>
 #include <QStandardItem>
 #include <QSize>
+#include <QtConcurrent>
 
 #include "opencv2/videoio.hpp"
 
 #include "mainwindow.h"
 #include "utilities.h"
+#include "mjpeg_server.h"
+#include "event_stream.h"
+#include "track_file.h"
+#include "player_window.h"
+#include "sprite_sheet.h"
+#include "clip_export.h"
 
-MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), fileMenu(nullptr), capturer(nullptr)
+MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), fileMenu(nullptr), capturer(nullptr), supervisor(nullptr), archiver(nullptr)
 {
     initUI();
     data_lock = new QMutex();
+    if (ArchiveTranscoder::enabledInConfig())
+    {
+        archiver = new ArchiveTranscoder(this);
+        archiver->start();
+    }
 }
 
 void MainWindow::initUI()
@@ -58,6 +71,10 @@ void MainWindow::initUI()
     list_model = new QStandardItemModel(this);
     saved_list->setModel(list_model);
     main_layout->addWidget(saved_list, 13, 0, 4, 1);
+    connect(saved_list, &QListView::doubleClicked, this, &MainWindow::openSavedVideo);
+    saved_list->setMouseTracking(true);
+    saved_list->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    saved_list->viewport()->installEventFilter(this);
 
     QWidget *widget = new QWidget();
     widget->setLayout(main_layout);
@@ -82,6 +99,8 @@ void MainWindow::createActions()
     fileMenu->addAction(openCameraAction);
     calcFPSAction = new QAction("&Calculate FPS", this);
     fileMenu->addAction(calcFPSAction);
+    exportAction = new QAction("&Exportar videos seleccionados...", this);
+    fileMenu->addAction(exportAction);
     exitAction = new QAction("E&xit", this);
     fileMenu->addAction(exitAction);
 
@@ -90,6 +109,7 @@ void MainWindow::createActions()
     connect(cameraInfoAction, SIGNAL(triggered(bool)), this, SLOT(showCameraInfo()));
     connect(openCameraAction, SIGNAL(triggered(bool)), this, SLOT(openCamera()));
     connect(calcFPSAction, SIGNAL(triggered(bool)), this, SLOT(calculateFPS()));
+    connect(exportAction, SIGNAL(triggered(bool)), this, SLOT(exportSelected()));
 }
 
 void MainWindow::showCameraInfo()
@@ -107,6 +127,23 @@ void MainWindow::showCameraInfo()
 
 void MainWindow::openCamera()
 {
+    if (WorkerSupervisor::enabledInConfig())
+    {
+        // Captura, detección y grabación en un proceso aparte que se reinicia si falla
+        QString current = Utilities::currentCameraKey();
+        delete supervisor;
+        supervisor = new WorkerSupervisor(current, this);
+        connect(supervisor, &WorkerSupervisor::frameReady, this, &MainWindow::showFrame);
+        connect(supervisor, &WorkerSupervisor::fpsChanged, this, &MainWindow::updateFPS);
+        connect(supervisor, &WorkerSupervisor::videoSaved, this, &MainWindow::appendSavedVideo);
+        supervisor->start();
+        mainStatusLabel->setText(QString("Capturing Camera %1 (worker)").arg(current));
+        monitorCheckBox->setCheckState(Qt::Unchecked);
+        recordButton->setText("Record");
+        recordButton->setEnabled(true);
+        return;
+    }
+
     if (capturer != nullptr)
     {
         // if a thread is already running, stop it
@@ -117,6 +154,10 @@ void MainWindow::openCamera()
         connect(capturer, &CaptureThread::finished, capturer, &CaptureThread::deleteLater);
     }
     
+    // Vista en vivo por HTTP (<cam>.http_puerto) y eventos por socket (<cam>.eventos_socket)
+    MjpegServer::startFromConfig(Utilities::currentCameraKey());
+    EventStream::startFromConfig(Utilities::currentCameraKey());
+
     int camID = 0;
     capturer = new CaptureThread(camID, data_lock);
     connect(capturer, &CaptureThread::frameCaptured, this, &MainWindow::updateFrame);
@@ -131,7 +172,11 @@ void MainWindow::openCamera()
 
 void MainWindow::calculateFPS()
 {
-    if (capturer != nullptr)
+    if (supervisor != nullptr)
+    {
+        supervisor->calculateFPS();
+    }
+    else if (capturer != nullptr)
     {
         capturer->startCalcFPS();
     }
@@ -148,9 +193,12 @@ void MainWindow::updateFrame(cv::Mat *mat)
         currentFrame.cols,
         currentFrame.rows,
         currentFrame.step,
-        QImage::Format_RGB888);
-    QPixmap image = QPixmap::fromImage(frame);
+        QImage::Format_BGR888);
+    showFrame(QPixmap::fromImage(frame));
+}
 
+void MainWindow::showFrame(QPixmap image)
+{
     imageScene->clear();
     imageView->resetTransform();
     imageScene->addPixmap(image);
@@ -166,7 +214,20 @@ void MainWindow::updateFPS(float fps)
 void MainWindow::recordingStartStop()
 {
     QString text = recordButton->text();
-    if (text == "Record" && capturer != nullptr)
+    if (text == "Record" && supervisor != nullptr)
+    {
+        supervisor->setRecording(true);
+        recordButton->setText("Stop Recording");
+        monitorCheckBox->setCheckState(Qt::Unchecked);
+        monitorCheckBox->setEnabled(false);
+    }
+    else if (text == "Stop Recording" && supervisor != nullptr)
+    {
+        supervisor->setRecording(false);
+        recordButton->setText("Record");
+        monitorCheckBox->setEnabled(true);
+    }
+    else if (text == "Record" && capturer != nullptr)
     {
         capturer->setVideoSavingStatus(CaptureThread::STARTING);
         recordButton->setText("Stop Recording");
@@ -181,38 +242,97 @@ void MainWindow::recordingStartStop()
     }
 }
 
+// Portada de la lista: primera miniatura (o el .jpg de las grabaciones anteriores)
+static QPixmap savedVideoCover(const QString &name)
+{
+    QImage cover = SpriteSheet::cover(name);
+    if (!cover.isNull())
+    {
+        return QPixmap::fromImage(cover).scaledToHeight(145);
+    }
+    return QPixmap(Utilities::getSavedVideoPath(name, "jpg")).scaledToHeight(145);
+}
+
 void MainWindow::populateSavedList()
 {
     QDir dir(Utilities::getDataPath());
     QStringList nameFilters;
-    nameFilters << "*.jpg";
+    nameFilters << "*.mp4";
     QFileInfoList files = dir.entryInfoList(
         nameFilters, QDir::NoDotAndDotDot | QDir::Files, QDir::Name);
 
-    foreach (QFileInfo cover, files)
+    foreach (QFileInfo video, files)
     {
-        QString name = cover.baseName();
+        QString name = video.baseName();
         QStandardItem *item = new QStandardItem();
         list_model->appendRow(item);
         QModelIndex index = list_model->indexFromItem(item);
-        list_model->setData(index, QPixmap(cover.absoluteFilePath()).scaledToHeight(145), Qt::DecorationRole);
+        list_model->setData(index, savedVideoCover(name), Qt::DecorationRole);
         list_model->setData(index, name, Qt::DisplayRole);
+        list_model->setData(index, TrackFile::describe(Utilities::getSavedVideoPath(name, "trk")), Qt::ToolTipRole);
     }
 }
 
 void MainWindow::appendSavedVideo(QString name)
 {
-    QString cover = Utilities::getSavedVideoPath(name, "jpg");
     QStandardItem *item = new QStandardItem();
     list_model->appendRow(item);
     QModelIndex index = list_model->indexFromItem(item);
-    list_model->setData(index, QPixmap(cover).scaledToHeight(145), Qt::DecorationRole);
+    list_model->setData(index, savedVideoCover(name), Qt::DecorationRole);
     list_model->setData(index, name, Qt::DisplayRole);
+    list_model->setData(index, TrackFile::describe(Utilities::getSavedVideoPath(name, "trk")), Qt::ToolTipRole);
     saved_list->scrollTo(index);
 }
 
+// Al pasar el mouse sobre un video la portada recorre sus miniaturas según la posición
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == saved_list->viewport())
+    {
+        if (event->type() == QEvent::MouseMove)
+        {
+            QPoint pos = static_cast<QMouseEvent *>(event)->pos();
+            QModelIndex index = saved_list->indexAt(pos);
+            if (index != hover_index)
+            {
+                endHoverPreview();
+                if (index.isValid() && hover_sprites.load(index.data(Qt::DisplayRole).toString()))
+                    hover_index = index;
+            }
+            if (hover_index.isValid())
+            {
+                QRect rect = saved_list->visualRect(hover_index);
+                double fraction = qBound(0.0, double(pos.x() - rect.left()) / qMax(1, rect.width()), 0.999);
+                QImage thumbnail = hover_sprites.thumbnail(int(fraction * hover_sprites.count()));
+                list_model->setData(hover_index, QPixmap::fromImage(thumbnail).scaledToHeight(145), Qt::DecorationRole);
+            }
+        }
+        else if (event->type() == QEvent::Leave)
+        {
+            endHoverPreview();
+        }
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
+void MainWindow::endHoverPreview()
+{
+    if (hover_index.isValid())
+    {
+        list_model->setData(hover_index, QPixmap::fromImage(hover_sprites.thumbnail(0)).scaledToHeight(145),
+                            Qt::DecorationRole);
+    }
+    hover_index = QPersistentModelIndex();
+}
+
 void MainWindow::updateMonitorStatus(int status)
 {
+    if (supervisor != nullptr)
+    {
+        supervisor->setMotionDetecting(status != 0);
+        recordButton->setEnabled(!status);
+        return;
+    }
     if (capturer == nullptr)
     {
         return;
@@ -228,3 +348,48 @@ void MainWindow::updateMonitorStatus(int status)
         recordButton->setEnabled(true);
     }
 }
+
+void MainWindow::openSavedVideo(const QModelIndex &index)
+{
+    PlayerWindow *player = new PlayerWindow(index.data(Qt::DisplayRole).toString(), this);
+    player->show();
+}
+
+// Une los videos seleccionados, en orden de fecha, en un solo mp4 sin recodificar
+void MainWindow::exportSelected()
+{
+    QStringList names;
+    foreach (const QModelIndex &index, saved_list->selectionModel()->selectedIndexes())
+    {
+        names << index.data(Qt::DisplayRole).toString();
+    }
+    if (names.isEmpty())
+    {
+        QMessageBox::information(this, "Exportar", "Seleccione uno o más videos de la lista.");
+        return;
+    }
+    names.sort();
+    QString output = QFileDialog::getSaveFileName(this, "Exportar", names.first() + ".mp4", "Video (*.mp4)");
+    if (output.isEmpty())
+    {
+        return;
+    }
+
+    std::vector<ClipExport::Segment> segments;
+    foreach (const QString &name, names)
+    {
+        segments.push_back(ClipExport::Segment(name));
+    }
+    mainStatusLabel->setText("Exportando " + output);
+    QFutureWatcher<QString> *watcher = new QFutureWatcher<QString>(this);
+    connect(watcher, &QFutureWatcher<QString>::finished, this, [this, watcher, output]() {
+        QString error = watcher->result();
+        watcher->deleteLater();
+        mainStatusLabel->setText(error.isEmpty() ? "Exportado " + output : error);
+    });
+    watcher->setFuture(QtConcurrent::run([segments, output]() {
+        QString error;
+        ClipExport::run(segments, output, &error);
+        return error;
+    }));
+}
@@ -16,6 +16,9 @@
 
 #include "opencv2/opencv.hpp"
 #include "capture_thread.h"
+#include "worker_supervisor.h"
+#include "sprite_sheet.h"
+#include "archive_transcoder.h"
 
 class MainWindow : public QMainWindow
 {
@@ -29,16 +32,23 @@ private:
     void initUI();
     void createActions();
     void populateSavedList();
+    void endHoverPreview();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
 
 private slots:
     void showCameraInfo();
     void openCamera();
     void updateFrame(cv::Mat *);
+    void showFrame(QPixmap image);
     void calculateFPS();
     void updateFPS(float);
     void recordingStartStop();
     void appendSavedVideo(QString name);
     void updateMonitorStatus(int status);
+    void openSavedVideo(const QModelIndex &index);
+    void exportSelected();
 
 private:
     QMenu *fileMenu;
@@ -46,6 +56,7 @@ private:
     QAction *cameraInfoAction;
     QAction *openCameraAction;
     QAction *calcFPSAction;
+    QAction *exportAction;
     QAction *exitAction;
 
     QGraphicsScene *imageScene;
@@ -56,6 +67,8 @@ private:
 
     QListView *saved_list;
     QStandardItemModel *list_model;
+    QPersistentModelIndex hover_index; // video con la vista previa activa
+    SpriteSheet hover_sprites;
 
     QStatusBar *mainStatusBar;
     QLabel *mainStatusLabel;
@@ -65,4 +78,10 @@ private:
     // for capture thread
     QMutex *data_lock;
     CaptureThread *capturer;
+
+    // Modo trabajadores: la cámara corre en otro proceso
+    WorkerSupervisor *supervisor;
+
+    // Recodificación de grabaciones viejas en segundo plano (archivo_dias)
+    ArchiveTranscoder *archiver;
 };
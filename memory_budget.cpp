@@ -0,0 +1,235 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <QDebug>
+
+#include "utilities.h"
+#include "metrics.h"
+#include "memory_budget.h"
+
+namespace {
+const char *SHARED_NAME = "/qtvcr-memoria";
+const int SHARED_SLOTS = 128;
+const int OTHERS_REFRESH_MS = 100;
+const int PUBLISH_MS = 1000;
+}
+
+// Un proceso por ranura: pid 0 = libre. Un pid muerto se puede reusar.
+struct MemoryBudget::SharedSlot
+{
+    std::atomic<int32_t> pid;
+    std::atomic<int64_t> bytes;
+};
+
+MemoryBudget *MemoryBudget::instance()
+{
+    static MemoryBudget *budget = nullptr;
+    static QMutex create_lock;
+    QMutexLocker locker(&create_lock);
+    if (budget == nullptr)
+    {
+        budget = new MemoryBudget();
+    }
+    return budget;
+}
+
+MemoryBudget::MemoryBudget() :
+    process_bytes(0), pressure(0), shared(nullptr), own_slot(nullptr), others_bytes(0)
+{
+    budget = qint64(qMax(0, Utilities::getParamInt("memoria_max_mb", 0))) << 20;
+    soft = qint64(budget * qBound(0.1, Utilities::getParamDouble("memoria_suave", 0.8), 1.0));
+    max_wait_ms = qMax(0, Utilities::getParamInt("memoria_espera_max_ms", 1000));
+    published.start();
+    if (budget > 0)
+    {
+        attachShared();
+    }
+}
+
+bool MemoryBudget::underPressure()
+{
+    return instance()->pressure.load(std::memory_order_relaxed) > 0;
+}
+
+// Segmento con el uso de cada proceso qtvcr. Si no se puede crear el
+// presupuesto queda por proceso.
+void MemoryBudget::attachShared()
+{
+    const size_t size = sizeof(SharedSlot) * SHARED_SLOTS;
+    const int fd = shm_open(SHARED_NAME, O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+    {
+        qWarning() << "Memoria: shm_open" << SHARED_NAME << strerror(errno) << "- presupuesto por proceso";
+        return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t(info.st_size) < size && ftruncate(fd, off_t(size)) != 0))
+    {
+        qWarning() << "Memoria: ftruncate" << SHARED_NAME << strerror(errno) << "- presupuesto por proceso";
+        ::close(fd);
+        return;
+    }
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+    {
+        qWarning() << "Memoria: mmap" << SHARED_NAME << strerror(errno) << "- presupuesto por proceso";
+        return;
+    }
+    shared = static_cast<SharedSlot *>(p);
+
+    const int32_t self = int32_t(getpid());
+    for (int i = 0; i < SHARED_SLOTS && own_slot == nullptr; i++)
+    {
+        int32_t pid = shared[i].pid.load();
+        const bool free_slot = pid == 0 || pid == self || (kill(pid, 0) != 0 && errno == ESRCH);
+        if (free_slot && shared[i].pid.compare_exchange_strong(pid, self))
+        {
+            shared[i].bytes.store(0);
+            own_slot = &shared[i];
+        }
+    }
+    if (own_slot == nullptr)
+    {
+        qWarning() << "Memoria: no hay lugar en" << SHARED_NAME << "- presupuesto por proceso";
+        munmap(shared, size);
+        shared = nullptr;
+    }
+}
+
+// Con lock tomado. El uso de los demás procesos se relee cada OTHERS_REFRESH_MS.
+qint64 MemoryBudget::total()
+{
+    if (shared != nullptr && (!others_read.isValid() || others_read.elapsed() >= OTHERS_REFRESH_MS))
+    {
+        qint64 sum = 0;
+        for (int i = 0; i < SHARED_SLOTS; i++)
+        {
+            const int32_t pid = shared[i].pid.load();
+            if (pid == 0 || &shared[i] == own_slot)
+                continue;
+            if (kill(pid, 0) != 0 && errno == ESRCH)
+                continue; // murió sin liberar: no cuenta
+            sum += shared[i].bytes.load();
+        }
+        others_bytes = sum;
+        others_read.start();
+    }
+    return process_bytes + others_bytes;
+}
+
+// Con lock tomado
+bool MemoryBudget::fits(Class type, qint64 bytes)
+{
+    if (budget <= 0)
+    {
+        return true;
+    }
+    return total() + bytes <= (type == ESSENTIAL ? budget : soft);
+}
+
+// Con lock tomado
+void MemoryBudget::add(const QString &name, qint64 bytes)
+{
+    components[name] += bytes;
+    process_bytes += bytes;
+    if (own_slot != nullptr)
+    {
+        own_slot->bytes.store(process_bytes);
+    }
+    if (budget > 0)
+    {
+        const qint64 used = total();
+        pressure.store(used > budget ? 2 : used > soft ? 1 : 0, std::memory_order_relaxed);
+    }
+    if (bytes < 0)
+    {
+        released.wakeAll();
+    }
+    if (published.elapsed() >= PUBLISH_MS)
+    {
+        publish();
+    }
+}
+
+// Con lock tomado
+void MemoryBudget::publish()
+{
+    published.restart();
+    for (auto it = components.begin(); it != components.end(); ++it)
+    {
+        Metrics::set("memoria." + it->first, double(it->second) / (1 << 20));
+    }
+    Metrics::set("memoria.proceso_mb", double(process_bytes) / (1 << 20));
+    Metrics::set("memoria.total_mb", double(total()) / (1 << 20));
+    Metrics::set("memoria.presion", double(pressure.load()));
+}
+
+MemoryBudget::Account::Account(const QString &name, Class type) :
+    name(name), type(type), bytes(0)
+{
+}
+
+MemoryBudget::Account::~Account()
+{
+    release(bytes.load());
+}
+
+bool MemoryBudget::Account::tryReserve(qint64 bytes)
+{
+    MemoryBudget *budget = MemoryBudget::instance();
+    QMutexLocker locker(&budget->lock);
+    if (!budget->fits(type, bytes))
+    {
+        Metrics::add("memoria.rechazos", 1);
+        return false;
+    }
+    this->bytes += bytes;
+    budget->add(name, bytes);
+    return true;
+}
+
+void MemoryBudget::Account::reserve(qint64 bytes)
+{
+    MemoryBudget *budget = MemoryBudget::instance();
+    QMutexLocker locker(&budget->lock);
+    if (!budget->fits(ESSENTIAL, bytes))
+    {
+        // Se espera a que algo se libere; lo de otros procesos no avisa, así que se vuelve a mirar seguido
+        QElapsedTimer waited;
+        waited.start();
+        while (!budget->fits(ESSENTIAL, bytes) && waited.elapsed() < budget->max_wait_ms)
+        {
+            budget->released.wait(&budget->lock, OTHERS_REFRESH_MS);
+        }
+        Metrics::add("memoria.esperas_ms", double(waited.elapsed()));
+        if (!budget->fits(ESSENTIAL, bytes))
+            Metrics::add("memoria.excedido", 1);
+    }
+    this->bytes += bytes;
+    budget->add(name, bytes);
+}
+
+void MemoryBudget::Account::charge(qint64 bytes)
+{
+    MemoryBudget *budget = MemoryBudget::instance();
+    QMutexLocker locker(&budget->lock);
+    this->bytes += bytes;
+    budget->add(name, bytes);
+}
+
+void MemoryBudget::Account::release(qint64 bytes)
+{
+    if (bytes == 0)
+    {
+        return;
+    }
+    MemoryBudget *budget = MemoryBudget::instance();
+    QMutexLocker locker(&budget->lock);
+    this->bytes -= bytes;
+    budget->add(name, -bytes);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <map>
+#include <atomic>
+#include <QString>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+
+// Presupuesto de memoria compartido por todos los componentes que guardan
+// frames o datos en memoria (colas de frames, escrituras pendientes, cachés
+// de miniaturas y del reproductor).
+//
+// Cada componente abre una cuenta (Account) con un nombre y una clase, y
+// reserva bytes antes de crecer:
+//
+//  - CACHE: se puede rehacer. Pasado el límite suave no crece y se achica
+//    (el dueño mira underPressure() y libera).
+//  - DROPPABLE: se puede perder (frames en vivo sin grabación). Pasado el
+//    límite suave la reserva falla y el componente descarta lo más viejo.
+//  - ESSENTIAL: no se pierde (frames de una grabación, escrituras). Entra
+//    hasta el límite duro; pasado ese, quien reserva espera a que se libere
+//    (memoria_espera_max_ms, después sigue y suma a memoria.excedido).
+//
+// memoria_max_mb es el presupuesto (0 = sin límite, solo se mide) y
+// memoria_suave la fracción donde empieza la presión (0.8). En modo
+// trabajadores cada cámara es un proceso: el uso de cada uno se publica en
+// un segmento compartido (/qtvcr-memoria) y el presupuesto es de la suma.
+//
+// Métricas: memoria.<componente> (MB), memoria.proceso_mb, memoria.total_mb,
+// memoria.presion (0 normal, 1 suave, 2 duro), memoria.rechazos,
+// memoria.esperas_ms y memoria.excedido.
+class MemoryBudget
+{
+public:
+    enum Class
+    {
+        CACHE,
+        DROPPABLE,
+        ESSENTIAL
+    };
+
+    class Account
+    {
+    public:
+        Account(const QString &name, Class type);
+        ~Account(); // devuelve lo que quedó reservado
+
+        // Según la clase; false = no hay lugar (no se reservó nada)
+        bool tryReserve(qint64 bytes);
+        // Espera mientras el presupuesto esté lleno (backpressure), para lo que no se puede perder
+        void reserve(qint64 bytes);
+        // Sin condiciones: lo mínimo para que el componente funcione
+        void charge(qint64 bytes);
+        void release(qint64 bytes);
+
+        qint64 used() const { return bytes.load(); }
+
+    private:
+        QString name;
+        Class type;
+        std::atomic<qint64> bytes;
+    };
+
+    static MemoryBudget *instance();
+
+    // Uso total por encima del límite suave: las cachés tienen que achicarse
+    static bool underPressure();
+
+private:
+    MemoryBudget();
+
+    bool fits(Class type, qint64 bytes);
+    void add(const QString &name, qint64 bytes);
+    qint64 total();
+    void publish();
+    void attachShared();
+
+    QMutex lock;
+    QWaitCondition released;
+    qint64 budget;
+    qint64 soft;
+    int max_wait_ms;
+    qint64 process_bytes;
+    std::atomic<int> pressure; // 0 normal, 1 suave, 2 duro
+    std::map<QString, qint64> components;
+    QElapsedTimer published;
+
+    // Uso de los demás procesos (segmento compartido), releído cada tanto
+    struct SharedSlot;
+    SharedSlot *shared;
+    SharedSlot *own_slot;
+    qint64 others_bytes;
+    QElapsedTimer others_read;
+};
@@ -0,0 +1,112 @@
+#include <atomic>
+#include <errno.h>
+#include <signal.h>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDir>
+#include <QFile>
+
+#include "utilities.h"
+#include "metrics.h"
+#include "async_io.h"
+
+namespace {
+QMutex metrics_lock;
+QJsonObject metrics_values;
+QElapsedTimer metrics_write_timer;
+QString metrics_path;
+std::atomic<bool> metrics_writing(false);
+bool metrics_closed = false;
+
+QString metricsDir()
+{
+    QDir dir(Utilities::getDataPath());
+    dir.mkpath("metrics");
+    return dir.absoluteFilePath("metrics");
+}
+}
+
+void Metrics::set(const QString &key, double value)
+{
+    QMutexLocker locker(&metrics_lock);
+    metrics_values.insert(key, value);
+}
+
+void Metrics::set(const QString &key, const QString &value)
+{
+    QMutexLocker locker(&metrics_lock);
+    metrics_values.insert(key, value);
+}
+
+void Metrics::add(const QString &key, double delta)
+{
+    QMutexLocker locker(&metrics_lock);
+    metrics_values.insert(key, metrics_values.value(key).toDouble() + delta);
+}
+
+QJsonObject Metrics::snapshot()
+{
+    QMutexLocker locker(&metrics_lock);
+    return metrics_values;
+}
+
+void Metrics::writeIfDue(int interval_ms)
+{
+    QJsonObject values;
+    {
+        QMutexLocker locker(&metrics_lock);
+        if (metrics_closed || (metrics_write_timer.isValid() && metrics_write_timer.elapsed() < interval_ms))
+        {
+            return;
+        }
+        metrics_write_timer.start();
+        if (metrics_path.isEmpty())
+        {
+            metrics_path = QDir(metricsDir()).absoluteFilePath(QString("%1.json").arg(QCoreApplication::applicationPid()));
+        }
+        values = metrics_values;
+    }
+
+    // Se escribe en un temporal y se renombra (los lectores nunca ven un archivo
+    // a medias), en el hilo de E/S: quien llama es el bucle de captura.
+    // Mientras no termina una escritura no se encola otra.
+    if (metrics_writing.exchange(true))
+    {
+        return;
+    }
+    const QString temp = metrics_path + ".tmp";
+    AsyncIO::instance()->replace(temp, QJsonDocument(values).toJson(QJsonDocument::Indented));
+    AsyncIO::instance()->rename(temp, metrics_path, [](bool) { metrics_writing = false; });
+}
+
+void Metrics::removeFile()
+{
+    QString path;
+    {
+        QMutexLocker locker(&metrics_lock);
+        metrics_closed = true;
+        path = metrics_path;
+    }
+    if (path.isEmpty())
+    {
+        return;
+    }
+    AsyncIO::instance()->waitFor(QStringList() << path + ".tmp" << path);
+    QFile::remove(path + ".tmp");
+    QFile::remove(path);
+}
+
+void Metrics::removeStale()
+{
+    QDir dir(metricsDir());
+    foreach (const QFileInfo &file, dir.entryInfoList(QStringList() << "*.json" << "*.json.tmp", QDir::Files))
+    {
+        const qint64 pid = file.fileName().section('.', 0, 0).toLongLong();
+        if (pid <= 0 || pid == QCoreApplication::applicationPid() || ::kill(pid_t(pid), 0) == 0 || errno == EPERM)
+            continue;
+        QFile::remove(file.absoluteFilePath());
+    }
+}
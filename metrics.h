@@ -0,0 +1,23 @@
+#pragma once
+
+#include <QString>
+#include <QJsonObject>
+
+// Métricas del proceso (tasas, tiempos, estados) compartidas por todos los hilos.
+// Se guardan en <carpeta de datos>/metrics/<pid>.json cada pocos segundos.
+class Metrics
+{
+ public:
+    static void set(const QString &key, double value);
+    static void set(const QString &key, const QString &value);
+    static void add(const QString &key, double delta);
+    static QJsonObject snapshot();
+
+    // Escribe el archivo si pasaron al menos interval_ms desde la última vez.
+    static void writeIfDue(int interval_ms = 5000);
+
+    // Al salir bien: borra el archivo de este proceso (no se escribe más)
+    static void removeFile();
+    // Borra los archivos de procesos que ya no existen (trabajadores caídos)
+    static void removeStale();
+};
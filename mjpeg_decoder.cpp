@@ -0,0 +1,55 @@
+#include <turbojpeg.h>
+
+#include "mjpeg_decoder.h"
+
+MjpegDecoder::MjpegDecoder() :
+    handle(tjInitDecompress())
+{
+}
+
+MjpegDecoder::~MjpegDecoder()
+{
+    if (handle != nullptr)
+    {
+        tjDestroy(handle);
+    }
+}
+
+bool MjpegDecoder::size(const cv::Mat &jpeg, cv::Size &size)
+{
+    int width, height, subsampling, colorspace;
+    if (handle == nullptr || jpeg.empty() || !jpeg.isContinuous() ||
+        tjDecompressHeader3(handle, jpeg.data, (unsigned long)jpeg.total() * jpeg.elemSize(),
+                            &width, &height, &subsampling, &colorspace) != 0)
+    {
+        return false;
+    }
+    size = cv::Size(width, height);
+    return true;
+}
+
+bool MjpegDecoder::decode(const cv::Mat &jpeg, int factor, cv::Mat &bgr)
+{
+    // jpeg puede ser el mismo Mat que bgr
+    const cv::Mat source = jpeg;
+    cv::Size full;
+    if (!size(source, full))
+    {
+        return false;
+    }
+    const tjscalingfactor scale = {1, factor};
+    const int width = TJSCALED(full.width, scale);
+    const int height = TJSCALED(full.height, scale);
+    bgr = cv::Mat(height, width, CV_8UC3);
+
+    // Para las salidas reducidas la precisión de la IDCT y del upsampling no se nota
+    const int flags = factor > 1 ? TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE : 0;
+    if (tjDecompress2(handle, source.data, (unsigned long)source.total() * source.elemSize(),
+                      bgr.data, width, int(bgr.step), height, TJPF_BGR, flags) != 0 &&
+        tjGetErrorCode(handle) != TJERR_WARNING)
+    {
+        bgr.release();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+// Decodificación de los frames MJPEG de las webcams USB (<cam>.mjpeg_directo).
+//
+// En ese modo V4L2 entrega el JPEG tal como sale de la cámara (una fila de
+// bytes, sin CONVERT_RGB) y lo decodifica CaptureThread. libjpeg-turbo puede
+// reducir 1/2, 1/4 u 1/8 dentro de la IDCT, así que para vista previa y
+// detección se decodifica directamente a esa resolución en vez de decodificar
+// entera y volver a reducir. La resolución completa queda para los frames que
+// se graban o se publican enteros.
+class MjpegDecoder
+{
+public:
+    MjpegDecoder();
+    ~MjpegDecoder();
+
+    // Buffer crudo de V4L2 (1xN CV_8UC1) en lugar de una imagen
+    static bool isRaw(const cv::Mat &frame) { return frame.type() == CV_8UC1 && frame.rows == 1; }
+
+    // Tamaño completo del JPEG; false si no es un JPEG válido
+    bool size(const cv::Mat &jpeg, cv::Size &size);
+
+    // BGR a 1/factor (1, 2, 4 u 8) del tamaño completo, redondeado hacia
+    // arriba. Cada llamada usa un buffer nuevo (el frame pasa a otros hilos).
+    // Un JPEG con datos dañados pero decodificable se acepta.
+    bool decode(const cv::Mat &jpeg, int factor, cv::Mat &bgr);
+
+private:
+    void *handle; // tjhandle
+};
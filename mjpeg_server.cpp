@@ -0,0 +1,380 @@
+#include <QtConcurrent>
+#include <QMutexLocker>
+#include <QHostAddress>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QJsonDocument>
+#include <QDebug>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "utilities.h"
+#include "metrics.h"
+#include "mjpeg_server.h"
+
+namespace {
+const char *BOUNDARY = "qtvcrframe";
+const int MAX_REQUEST_BYTES = 8192;
+
+int normalizeScale(int scale)
+{
+    if (scale >= 8)
+        return 8;
+    if (scale >= 4)
+        return 4;
+    if (scale >= 2)
+        return 2;
+    return 1;
+}
+}
+
+QMutex MjpegServer::cameras_lock;
+std::map<QString, MjpegServer::Camera> MjpegServer::cameras;
+MjpegServer *MjpegServer::instance = nullptr;
+bool MjpegServer::notify_pending = false;
+
+MjpegServer::MjpegServer(QObject *parent) :
+    QObject(parent), quality(80)
+{
+    connect(&server, &QTcpServer::newConnection, this, &MjpegServer::acceptClients);
+}
+
+void MjpegServer::startFromConfig(const QString &camera_key)
+{
+    const int port = Utilities::getParamInt(camera_key + ".http_puerto", 0);
+    if (port <= 0)
+    {
+        return;
+    }
+
+    if (instance == nullptr)
+    {
+        MjpegServer *s = new MjpegServer(QCoreApplication::instance());
+        s->quality = Utilities::getParamInt("http_calidad", 80);
+        QString address = Utilities::getParam("http_direccion");
+        if (!s->listen(address.isEmpty() ? QString("127.0.0.1") : address, port))
+        {
+            delete s;
+            return;
+        }
+        instance = s;
+    }
+    else if (instance->server.serverPort() != port)
+    {
+        qWarning() << "Un solo servidor HTTP por proceso: se sirve" << camera_key
+                   << "en el puerto" << instance->server.serverPort();
+    }
+
+    QMutexLocker locker(&cameras_lock);
+    Camera &camera = cameras[camera_key];
+    camera.seq = 0;
+    camera.watched = false;
+}
+
+bool MjpegServer::listen(const QString &address, int port)
+{
+    if (!server.listen(QHostAddress(address), quint16(port)))
+    {
+        qWarning() << "No se pudo abrir el servidor HTTP en" << address << port << ":" << server.errorString();
+        return false;
+    }
+    qDebug() << "Vista en vivo en http://" + address + ":" + QString::number(port) + "/";
+    return true;
+}
+
+void MjpegServer::publish(const QString &camera_key, const cv::Mat &frame)
+{
+    QMutexLocker locker(&cameras_lock);
+    auto it = cameras.find(camera_key);
+    if (it == cameras.end() || !it->second.watched)
+    {
+        return;
+    }
+    it->second.latest = frame;
+    it->second.seq++;
+
+    // Un solo aviso pendiente: si el servidor está atrasado se codifica el último frame
+    if (!notify_pending)
+    {
+        notify_pending = true;
+        QMetaObject::invokeMethod(instance, "framesArrived", Qt::QueuedConnection);
+    }
+}
+
+bool MjpegServer::watched(const QString &camera_key)
+{
+    QMutexLocker locker(&cameras_lock);
+    auto it = cameras.find(camera_key);
+    return it != cameras.end() && it->second.watched;
+}
+
+void MjpegServer::acceptClients()
+{
+    while (server.hasPendingConnections())
+    {
+        QTcpSocket *socket = server.nextPendingConnection();
+        Client client;
+        client.socket = socket;
+        client.stream = nullptr;
+        clients[socket] = client;
+        connect(socket, &QTcpSocket::readyRead, this, &MjpegServer::readRequest);
+        connect(socket, &QTcpSocket::disconnected, this, &MjpegServer::clientGone);
+    }
+}
+
+void MjpegServer::readRequest()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    auto it = clients.find(socket);
+    if (it == clients.end())
+    {
+        return;
+    }
+    Client &client = it->second;
+    if (client.stream != nullptr)
+    {
+        socket->readAll(); // ya está recibiendo el stream; se ignora lo que mande
+        return;
+    }
+
+    client.request.append(socket->readAll());
+    if (client.request.size() > MAX_REQUEST_BYTES)
+    {
+        socket->write("HTTP/1.0 413 Request Entity Too Large\r\nConnection: close\r\n\r\n");
+        socket->disconnectFromHost();
+        return;
+    }
+    if (client.request.contains("\r\n\r\n"))
+    {
+        QByteArray request = client.request;
+        client.request.clear();
+        handleRequest(socket, request);
+    }
+}
+
+void MjpegServer::handleRequest(QTcpSocket *socket, const QByteArray &request)
+{
+    QList<QByteArray> line = request.left(request.indexOf("\r\n")).split(' ');
+    if (line.size() < 2 || line[0] != "GET")
+    {
+        socket->write("HTTP/1.0 405 Method Not Allowed\r\nConnection: close\r\n\r\n");
+        socket->disconnectFromHost();
+        return;
+    }
+
+    QUrl url(QString::fromUtf8(line[1]));
+    QStringList path = url.path().split('/', Qt::SkipEmptyParts);
+    int scale = normalizeScale(QUrlQuery(url).queryItemValue("escala").toInt());
+
+    if (path.size() == 1 && path[0] == "metrics")
+    {
+        QByteArray body = QJsonDocument(Metrics::snapshot()).toJson(QJsonDocument::Compact);
+        socket->write("HTTP/1.0 200 OK\r\nContent-Type: application/json\r\nConnection: close\r\nContent-Length: " +
+                      QByteArray::number(body.size()) + "\r\n\r\n" + body);
+        socket->disconnectFromHost();
+        return;
+    }
+
+    bool known;
+    {
+        QMutexLocker locker(&cameras_lock);
+        known = path.size() == 2 && cameras.count(path[0]) > 0;
+    }
+    if (!known || (path[1] != "stream.mjpg" && path[1] != "snapshot.jpg"))
+    {
+        socket->write("HTTP/1.0 404 Not Found\r\nConnection: close\r\n\r\n");
+        socket->disconnectFromHost();
+        return;
+    }
+
+    Stream *s = stream(path[0], scale);
+    if (path[1] == "stream.mjpg")
+    {
+        clients[socket].stream = s;
+        s->clients.append(socket);
+        socket->write(QByteArray("HTTP/1.0 200 OK\r\n"
+                                 "Cache-Control: no-cache\r\n"
+                                 "Connection: close\r\n"
+                                 "Content-Type: multipart/x-mixed-replace; boundary=") + BOUNDARY + "\r\n\r\n");
+        // Mientras llega el próximo frame se manda el último que haya
+        if (!s->jpeg.isEmpty())
+            sendFrame(socket, s->jpeg);
+    }
+    else if (!s->jpeg.isEmpty() && !s->clients.isEmpty())
+    {
+        // Hay un stream activo en esta escala: su último JPEG está al día
+        clients[socket].stream = s;
+        sendSnapshot(socket, s->jpeg);
+        return;
+    }
+    else
+    {
+        // Se responde con el próximo frame que llegue
+        clients[socket].stream = s;
+        s->snapshot_waiters.append(socket);
+    }
+    updateWatched(s->camera_key);
+    Metrics::set("http.clientes", double(clients.size()));
+}
+
+MjpegServer::Stream *MjpegServer::stream(const QString &camera_key, int scale)
+{
+    QString key = camera_key + "/" + QString::number(scale);
+    auto it = streams.find(key);
+    if (it != streams.end())
+    {
+        return it->second;
+    }
+
+    Stream *s = new Stream();
+    s->camera_key = camera_key;
+    s->scale = scale;
+    s->converter.configure(scale, 0, 0);
+    s->jpeg_seq = 0;
+    s->encoding = false;
+    streams[key] = s;
+    return s;
+}
+
+void MjpegServer::framesArrived()
+{
+    {
+        QMutexLocker locker(&cameras_lock);
+        notify_pending = false;
+    }
+    for (auto it = streams.begin(); it != streams.end(); ++it)
+    {
+        Stream *s = it->second;
+        if (!s->encoding && (!s->clients.isEmpty() || !s->snapshot_waiters.isEmpty()))
+        {
+            encode(s);
+        }
+    }
+}
+
+// Codifica el último frame de la cámara en un hilo del pool (una codificación por stream a la vez)
+void MjpegServer::encode(Stream *s)
+{
+    cv::Mat frame;
+    quint64 seq;
+    {
+        QMutexLocker locker(&cameras_lock);
+        const Camera &camera = cameras[s->camera_key];
+        frame = camera.latest;
+        seq = camera.seq;
+    }
+    if (frame.empty() || seq == s->jpeg_seq)
+    {
+        return;
+    }
+
+    s->encoding = true;
+    const int q = quality;
+    QtConcurrent::run([this, s, frame, seq, q]() {
+        cv::Mat image = frame;
+        if (s->scale > 1)
+        {
+            s->converter.process(frame, FrameConverter::PREVIEW);
+            image = s->converter.preview;
+        }
+        std::vector<uchar> buffer;
+        std::vector<int> params;
+        params.push_back(cv::IMWRITE_JPEG_QUALITY);
+        params.push_back(q);
+        cv::imencode(".jpg", image, buffer, params);
+        QByteArray jpeg(reinterpret_cast<const char *>(buffer.data()), int(buffer.size()));
+        QMetaObject::invokeMethod(this, [this, s, jpeg, seq]() { encoded(s, jpeg, seq); }, Qt::QueuedConnection);
+    });
+}
+
+void MjpegServer::encoded(Stream *s, QByteArray jpeg, quint64 seq)
+{
+    s->encoding = false;
+    s->jpeg = jpeg;
+    s->jpeg_seq = seq;
+    Metrics::add("http.jpeg_codificados", 1);
+
+    // El mismo buffer para todos los clientes de esta escala
+    for (QTcpSocket *socket : s->clients)
+    {
+        if (socket->bytesToWrite() > 0)
+        {
+            // Todavía no salió el frame anterior: se saltea este
+            Metrics::add("http.frames_salteados", 1);
+            continue;
+        }
+        sendFrame(socket, jpeg);
+    }
+    // disconnectFromHost() puede llamar a clientGone(), que modifica la lista
+    QList<QTcpSocket *> waiters = s->snapshot_waiters;
+    s->snapshot_waiters.clear();
+    for (QTcpSocket *socket : waiters)
+    {
+        sendSnapshot(socket, jpeg);
+    }
+    updateWatched(s->camera_key);
+
+    // Llegaron frames mientras se codificaba
+    if (!s->clients.isEmpty())
+    {
+        encode(s);
+    }
+}
+
+void MjpegServer::sendFrame(QTcpSocket *socket, const QByteArray &jpeg)
+{
+    socket->write(QByteArray("--") + BOUNDARY + "\r\nContent-Type: image/jpeg\r\nContent-Length: " +
+                  QByteArray::number(jpeg.size()) + "\r\n\r\n");
+    socket->write(jpeg);
+    socket->write("\r\n");
+}
+
+void MjpegServer::sendSnapshot(QTcpSocket *socket, const QByteArray &jpeg)
+{
+    socket->write("HTTP/1.0 200 OK\r\nContent-Type: image/jpeg\r\nCache-Control: no-cache\r\n"
+                  "Connection: close\r\nContent-Length: " + QByteArray::number(jpeg.size()) + "\r\n\r\n");
+    socket->write(jpeg);
+    socket->disconnectFromHost();
+}
+
+void MjpegServer::clientGone()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    auto it = clients.find(socket);
+    if (it == clients.end())
+    {
+        return;
+    }
+    Stream *s = it->second.stream;
+    clients.erase(it);
+    if (s != nullptr)
+    {
+        s->clients.removeAll(socket);
+        s->snapshot_waiters.removeAll(socket);
+        updateWatched(s->camera_key);
+    }
+    socket->deleteLater();
+    Metrics::set("http.clientes", double(clients.size()));
+}
+
+// Sin nadie mirando, publish() no guarda frames ni despierta al servidor
+void MjpegServer::updateWatched(const QString &camera_key)
+{
+    bool watched = false;
+    for (auto it = streams.begin(); it != streams.end(); ++it)
+    {
+        const Stream *s = it->second;
+        if (s->camera_key == camera_key && (!s->clients.isEmpty() || !s->snapshot_waiters.isEmpty()))
+        {
+            watched = true;
+        }
+    }
+
+    QMutexLocker locker(&cameras_lock);
+    Camera &camera = cameras[camera_key];
+    camera.watched = watched;
+    if (!watched)
+    {
+        camera.latest.release();
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <map>
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QMutex>
+#include <QList>
+#include <QByteArray>
+#include "opencv2/opencv.hpp"
+
+#include "frame_kernels.h"
+
+// Servidor HTTP local con la vista en vivo de las cámaras del proceso.
+//
+//   GET /<cam>/stream.mjpg?escala=2   MJPEG (multipart/x-mixed-replace)
+//   GET /<cam>/snapshot.jpg?escala=2  un frame
+//   GET /metrics                      Metrics::snapshot() en JSON
+//
+// Cada frame se codifica en JPEG una sola vez por escala (1, 2, 4 u 8) y el
+// mismo buffer se envía a todos los clientes de esa escala. Si la codificación
+// no da abasto se codifica solo el último frame. A un cliente que todavía no
+// terminó de recibir el frame anterior se le saltea el nuevo: nunca se
+// acumulan frames en memoria por cliente lento.
+//
+// Se activa con <cam>.http_puerto (0 = apagado); escucha en http_direccion
+// (127.0.0.1 por defecto). Calidad JPEG: http_calidad (80).
+class MjpegServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Crea el servidor de la cámara si está configurado. Llamar desde el hilo principal.
+    static void startFromConfig(const QString &camera_key);
+
+    // Entrega el frame más reciente de la cámara (desde el hilo de captura).
+    // No copia ni codifica; si nadie mira la cámara no hace nada.
+    static void publish(const QString &camera_key, const cv::Mat &frame);
+
+    // ¿Hay alguien mirando la cámara? (publish() necesita el frame entero)
+    static bool watched(const QString &camera_key);
+
+private slots:
+    void acceptClients();
+    void readRequest();
+    void clientGone();
+    void framesArrived();
+
+private:
+    struct Stream;
+    struct Client
+    {
+        QTcpSocket *socket;
+        Stream *stream; // nullptr mientras se lee el pedido
+        QByteArray request;
+    };
+    struct Stream
+    {
+        QString camera_key;
+        int scale;
+        QList<QTcpSocket *> clients;
+        QList<QTcpSocket *> snapshot_waiters;
+        FrameConverter converter;
+        QByteArray jpeg;          // último frame codificado
+        quint64 jpeg_seq;         // frame al que corresponde jpeg
+        bool encoding;
+    };
+    struct Camera
+    {
+        cv::Mat latest;
+        quint64 seq;
+        bool watched; // hay algún cliente o pedido de snapshot pendiente
+    };
+
+    MjpegServer(QObject *parent = nullptr);
+
+    bool listen(const QString &address, int port);
+    void handleRequest(QTcpSocket *socket, const QByteArray &request);
+    Stream *stream(const QString &camera_key, int scale);
+    void encode(Stream *s);
+    void encoded(Stream *s, QByteArray jpeg, quint64 seq);
+    void sendFrame(QTcpSocket *socket, const QByteArray &jpeg);
+    void sendSnapshot(QTcpSocket *socket, const QByteArray &jpeg);
+    void updateWatched(const QString &camera_key);
+
+    QTcpServer server;
+    std::map<QTcpSocket *, Client> clients;
+    std::map<QString, Stream *> streams; // clave: "<cam>/<escala>"
+    int quality;
+
+    // Compartido con los hilos de captura
+    static QMutex cameras_lock;
+    static std::map<QString, Camera> cameras;
+    static MjpegServer *instance;
+    static bool notify_pending;
+};
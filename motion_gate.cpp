@@ -0,0 +1,278 @@
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MOTION_GATE_HAVE_AVX2
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "motion_gate.h"
+
+namespace {
+
+const int BLOCK = MotionGate::BLOCK;
+
+// SAD de una fila de bloques: "blocks" bloques de 16x16 que empiezan en a y b.
+typedef void (*BlockRowSadFn)(const uint8_t *a, const uint8_t *b, size_t stride, int blocks, uint32_t *out);
+
+void blockRowSadScalar(const uint8_t *a, const uint8_t *b, size_t stride, int blocks, uint32_t *out)
+{
+    for (int bx = 0; bx < blocks; bx++)
+    {
+        uint32_t sum = 0;
+        for (int r = 0; r < BLOCK; r++)
+        {
+            const uint8_t *pa = a + r * stride + bx * BLOCK;
+            const uint8_t *pb = b + r * stride + bx * BLOCK;
+            for (int i = 0; i < BLOCK; i++)
+                sum += abs(int(pa[i]) - int(pb[i]));
+        }
+        out[bx] = sum;
+    }
+}
+
+#if defined(__SSE2__)
+void blockRowSadSse2(const uint8_t *a, const uint8_t *b, size_t stride, int blocks, uint32_t *out)
+{
+    for (int bx = 0; bx < blocks; bx++)
+    {
+        __m128i acc = _mm_setzero_si128();
+        for (int r = 0; r < BLOCK; r++)
+        {
+            __m128i va = _mm_loadu_si128((const __m128i *)(a + r * stride + bx * BLOCK));
+            __m128i vb = _mm_loadu_si128((const __m128i *)(b + r * stride + bx * BLOCK));
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+        }
+        out[bx] = uint32_t(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+    }
+}
+#endif
+
+#if defined(MOTION_GATE_HAVE_AVX2)
+// Dos bloques por instrucción: _mm256_sad_epu8 deja 4 sumas parciales, 2 por bloque.
+__attribute__((target("avx2")))
+void blockRowSadAvx2(const uint8_t *a, const uint8_t *b, size_t stride, int blocks, uint32_t *out)
+{
+    int bx = 0;
+    for (; bx + 2 <= blocks; bx += 2)
+    {
+        __m256i acc = _mm256_setzero_si256();
+        for (int r = 0; r < BLOCK; r++)
+        {
+            __m256i va = _mm256_loadu_si256((const __m256i *)(a + r * stride + bx * BLOCK));
+            __m256i vb = _mm256_loadu_si256((const __m256i *)(b + r * stride + bx * BLOCK));
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(va, vb));
+        }
+        __m128i lo = _mm256_castsi256_si128(acc);
+        __m128i hi = _mm256_extracti128_si256(acc, 1);
+        out[bx] = uint32_t(_mm_cvtsi128_si32(lo) + _mm_cvtsi128_si32(_mm_srli_si128(lo, 8)));
+        out[bx + 1] = uint32_t(_mm_cvtsi128_si32(hi) + _mm_cvtsi128_si32(_mm_srli_si128(hi, 8)));
+    }
+    blockRowSadScalar(a + bx * BLOCK, b + bx * BLOCK, stride, blocks - bx, out + bx);
+}
+#endif
+
+#if defined(__ARM_NEON)
+void blockRowSadNeon(const uint8_t *a, const uint8_t *b, size_t stride, int blocks, uint32_t *out)
+{
+    for (int bx = 0; bx < blocks; bx++)
+    {
+        uint16x8_t acc = vdupq_n_u16(0);
+        for (int r = 0; r < BLOCK; r++)
+        {
+            uint8x16_t va = vld1q_u8(a + r * stride + bx * BLOCK);
+            uint8x16_t vb = vld1q_u8(b + r * stride + bx * BLOCK);
+            acc = vpadalq_u8(acc, vabdq_u8(va, vb));
+        }
+        uint32x4_t s32 = vpaddlq_u16(acc);
+        uint64x2_t s64 = vpaddlq_u32(s32);
+        out[bx] = uint32_t(vgetq_lane_u64(s64, 0) + vgetq_lane_u64(s64, 1));
+    }
+}
+#endif
+
+BlockRowSadFn selectBlockRowSad()
+{
+#if defined(MOTION_GATE_HAVE_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+        return blockRowSadAvx2;
+#endif
+#if defined(__SSE2__)
+    return blockRowSadSse2;
+#elif defined(__ARM_NEON)
+    return blockRowSadNeon;
+#else
+    return blockRowSadScalar;
+#endif
+}
+
+const BlockRowSadFn blockRowSad = selectBlockRowSad();
+
+}
+
+MotionGate::MotionGate() :
+    pixel_threshold(12), min_score(0.002), blocks_x(0), blocks_y(0), words_per_row(0),
+    active_blocks(0), motion(false), motion_score(0)
+{
+}
+
+void MotionGate::configure(int pixel_threshold, double min_score)
+{
+    this->pixel_threshold = pixel_threshold;
+    this->min_score = min_score;
+}
+
+void MotionGate::setMask(const cv::Mat &mask)
+{
+    this->mask = mask;
+    mask_bits.clear();
+    blocks_x = blocks_y = 0; // se recalcula la grilla en el próximo update()
+    previous.release();
+}
+
+void MotionGate::reset()
+{
+    previous.release();
+    motion = false;
+    motion_score = 0;
+}
+
+bool MotionGate::update(const cv::Mat &gray)
+{
+    CV_Assert(gray.type() == CV_8UC1);
+
+    const int bx = gray.cols / BLOCK;
+    const int by = gray.rows / BLOCK;
+    if (previous.empty() || previous.size() != gray.size() || bx == 0 || by == 0)
+    {
+        // Primer frame (o cambio de resolución): no hay con qué comparar
+        blocks_x = bx;
+        blocks_y = by;
+        words_per_row = (bx + 63) / 64;
+        sad.assign(size_t(bx) * by, 0);
+        bitmap.assign(size_t(words_per_row) * by, 0);
+
+        // Bloques que tocan alguna zona activa
+        mask_bits.clear();
+        active_blocks = bx * by;
+        if (!mask.empty() && mask.size() == gray.size())
+        {
+            mask_bits.assign(size_t(words_per_row) * by, 0);
+            active_blocks = 0;
+            for (int y = 0; y < by; y++)
+            {
+                for (int x = 0; x < bx; x++)
+                {
+                    if (cv::countNonZero(mask(cv::Rect(x * BLOCK, y * BLOCK, BLOCK, BLOCK))) > 0)
+                    {
+                        mask_bits[size_t(y) * words_per_row + (x >> 6)] |= uint64_t(1) << (x & 63);
+                        active_blocks++;
+                    }
+                }
+            }
+        }
+
+        gray.copyTo(previous);
+        motion = false;
+        motion_score = 0;
+        return false;
+    }
+
+    const uint32_t block_threshold = uint32_t(pixel_threshold) * BLOCK * BLOCK;
+    int changed = 0;
+    for (int y = 0; y < by; y++)
+    {
+        uint32_t *row_sad = &sad[size_t(y) * bx];
+        const uint8_t *cur = gray.ptr<uint8_t>(y * BLOCK);
+        const uint8_t *prev = previous.ptr<uint8_t>(y * BLOCK);
+
+        // Solo se comparan los tramos de bloques activos; los enmascarados no se leen
+        int start = 0;
+        while (start < bx)
+        {
+            while (start < bx && !isActive(start, y))
+                start++;
+            int end = start;
+            while (end < bx && isActive(end, y))
+                end++;
+            if (end > start)
+                blockRowSad(cur + start * BLOCK, prev + start * BLOCK, gray.step, end - start, row_sad + start);
+            start = end;
+        }
+
+        uint64_t *row_bits = &bitmap[size_t(y) * words_per_row];
+        for (int w = 0; w < words_per_row; w++)
+            row_bits[w] = 0;
+        for (int x = 0; x < bx; x++)
+        {
+            if (isActive(x, y) && row_sad[x] > block_threshold)
+            {
+                row_bits[x >> 6] |= uint64_t(1) << (x & 63);
+                changed++;
+            }
+        }
+    }
+
+    gray.copyTo(previous);
+    motion_score = active_blocks > 0 ? double(changed) / active_blocks : 0;
+    motion = changed > 0 && motion_score >= min_score;
+    return motion;
+}
+
+std::vector<cv::Rect> MotionGate::changedRegions(double scale) const
+{
+    // Componentes conexas (4 vecinos) sobre la grilla de bloques
+    std::vector<cv::Rect> regions;
+    std::vector<uint8_t> visited(size_t(blocks_x) * blocks_y, 0);
+    std::vector<int> stack;
+
+    for (int y = 0; y < blocks_y; y++)
+    {
+        for (int x = 0; x < blocks_x; x++)
+        {
+            if (!isChanged(x, y) || visited[size_t(y) * blocks_x + x])
+                continue;
+
+            int x0 = x, y0 = y, x1 = x, y1 = y;
+            stack.clear();
+            stack.push_back(y * blocks_x + x);
+            visited[size_t(y) * blocks_x + x] = 1;
+            while (!stack.empty())
+            {
+                const int idx = stack.back();
+                stack.pop_back();
+                const int cx = idx % blocks_x;
+                const int cy = idx / blocks_x;
+                x0 = std::min(x0, cx);
+                x1 = std::max(x1, cx);
+                y0 = std::min(y0, cy);
+                y1 = std::max(y1, cy);
+
+                const int nx[4] = {cx - 1, cx + 1, cx, cx};
+                const int ny[4] = {cy, cy, cy - 1, cy + 1};
+                for (int k = 0; k < 4; k++)
+                {
+                    if (nx[k] < 0 || ny[k] < 0 || nx[k] >= blocks_x || ny[k] >= blocks_y)
+                        continue;
+                    const int n = ny[k] * blocks_x + nx[k];
+                    if (!visited[n] && isChanged(nx[k], ny[k]))
+                    {
+                        visited[n] = 1;
+                        stack.push_back(n);
+                    }
+                }
+            }
+
+            regions.push_back(cv::Rect(cvRound(x0 * BLOCK * scale),
+                                       cvRound(y0 * BLOCK * scale),
+                                       cvRound((x1 - x0 + 1) * BLOCK * scale),
+                                       cvRound((y1 - y0 + 1) * BLOCK * scale)));
+        }
+    }
+    return regions;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "opencv2/opencv.hpp"
+
+// Detector de movimiento barato para decidir si vale la pena correr el detector
+// de personas.
+//
+// Compara el gris reducido del frame actual con el anterior por bloques de
+// 16x16 (suma de diferencias absolutas, AVX2/SSE2/NEON con alternativa
+// portable). El resultado es un mapa de bits de bloques cambiados y un puntaje
+// (fracción de bloques cambiados).
+class MotionGate
+{
+public:
+    static const int BLOCK = 16;
+
+    MotionGate();
+
+    // pixel_threshold: diferencia media por píxel (0-255) para marcar un bloque.
+    // min_score: fracción de bloques cambiados para considerar que hay movimiento.
+    void configure(int pixel_threshold, double min_score);
+
+    // Máscara de zonas (CV_8UC1, mismo tamaño que las imágenes de update()).
+    // Los bloques sin ningún píxel activo no se comparan. Una máscara vacía
+    // desactiva el filtro.
+    void setMask(const cv::Mat &mask);
+
+    // Compara "gray" con el frame anterior. Devuelve true si hay movimiento.
+    bool update(const cv::Mat &gray);
+    void reset();
+
+    bool hasMotion() const { return motion; }
+    double score() const { return motion_score; }
+    int blocksX() const { return blocks_x; }
+    int blocksY() const { return blocks_y; }
+    bool isActive(int bx, int by) const
+    {
+        return mask_bits.empty() || ((mask_bits[by * words_per_row + (bx >> 6)] >> (bx & 63)) & 1);
+    }
+    bool isChanged(int bx, int by) const
+    {
+        return (bitmap[by * words_per_row + (bx >> 6)] >> (bx & 63)) & 1;
+    }
+
+    // Rectángulos que agrupan bloques cambiados vecinos, en coordenadas de la
+    // imagen de movimiento multiplicadas por "scale".
+    std::vector<cv::Rect> changedRegions(double scale) const;
+
+private:
+    int pixel_threshold;
+    double min_score;
+
+    cv::Mat previous;
+    int blocks_x, blocks_y, words_per_row;
+    std::vector<uint32_t> sad; // SAD por bloque
+    std::vector<uint64_t> bitmap; // 1 bit por bloque, filas de words_per_row palabras
+    cv::Mat mask;
+    std::vector<uint64_t> mask_bits; // bloques activos según la máscara (mismo formato)
+    int active_blocks;
+
+    bool motion;
+    double motion_score;
+};
@@ -0,0 +1,244 @@
+#include <QGridLayout>
+#include <QHBoxLayout>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QtConcurrent>
+#include <QPixmap>
+
+#include "utilities.h"
+#include "clip_export.h"
+#include "player_window.h"
+
+PlayerWindow::PlayerWindow(const QString &name, QWidget *parent) :
+    QWidget(parent, Qt::Window), direction(0), name(name), current_frame(0), mark_in(-1), mark_out(-1)
+{
+    setWindowTitle(name);
+    setAttribute(Qt::WA_DeleteOnClose);
+    resize(1000, 640);
+
+    QGridLayout *layout = new QGridLayout(this);
+    image_label = new QLabel(this);
+    image_label->setAlignment(Qt::AlignCenter);
+    image_label->setMinimumSize(320, 180);
+    layout->addWidget(image_label, 0, 0);
+
+    slider = new QSlider(Qt::Horizontal, this);
+    layout->addWidget(slider, 1, 0);
+
+    strip = new QLabel(this);
+    strip->setFixedHeight(48);
+    strip->setMouseTracking(true);
+    strip->installEventFilter(this);
+    layout->addWidget(strip, 2, 0);
+    preview = new QLabel(this);
+    preview->setFrameShape(QFrame::Box);
+    preview->hide();
+
+    QHBoxLayout *buttons = new QHBoxLayout();
+    layout->addLayout(buttons, 3, 0);
+    QPushButton *reverse_button = new QPushButton("<<", this);
+    QPushButton *back_button = new QPushButton("<|", this);
+    QPushButton *pause_button = new QPushButton("||", this);
+    QPushButton *forward_button = new QPushButton("|>", this);
+    QPushButton *play_button = new QPushButton(">>", this);
+    QPushButton *in_button = new QPushButton("[", this);
+    QPushButton *out_button = new QPushButton("]", this);
+    QPushButton *export_button = new QPushButton("Exportar", this);
+    time_label = new QLabel(this);
+    buttons->addWidget(reverse_button);
+    buttons->addWidget(back_button);
+    buttons->addWidget(pause_button);
+    buttons->addWidget(forward_button);
+    buttons->addWidget(play_button);
+    buttons->addStretch();
+    buttons->addWidget(in_button);
+    buttons->addWidget(out_button);
+    buttons->addWidget(export_button);
+    buttons->addWidget(time_label);
+
+    connect(reverse_button, &QPushButton::clicked, this, [this]() { direction = -1; player.play(-1); });
+    connect(play_button, &QPushButton::clicked, this, [this]() { direction = 1; player.play(1); });
+    connect(pause_button, &QPushButton::clicked, this, [this]() { direction = 0; player.pause(); });
+    connect(back_button, &QPushButton::clicked, this, [this]() { direction = 0; player.step(-1); });
+    connect(forward_button, &QPushButton::clicked, this, [this]() { direction = 0; player.step(1); });
+    connect(in_button, &QPushButton::clicked, this, [this]() { mark_in = current_frame; });
+    connect(out_button, &QPushButton::clicked, this, [this]() { mark_out = current_frame; });
+    connect(export_button, &QPushButton::clicked, this, &PlayerWindow::exportRange);
+    connect(slider, &QSlider::sliderMoved, this, [this](int frame) { player.seek(frame); });
+
+    connect(&player, &VideoPlayer::opened, this, &PlayerWindow::opened);
+    connect(&player, &VideoPlayer::frameReady, this, &PlayerWindow::showFrame);
+    connect(&player, &VideoPlayer::failed, this, &PlayerWindow::showError);
+
+    // Hasta que el reproductor tenga el índice no se puede ir a ningún lado
+    slider->setEnabled(false);
+    image_label->setText("Abriendo " + name + "...");
+
+    // Los frames en la caché se guardan al ancho de la vista, no al del video
+    player.open(name, Utilities::getParamInt("reproductor_ancho", 960));
+    if (!sprites.load(name))
+    {
+        strip->hide();
+    }
+}
+
+void PlayerWindow::opened(qint64 frame_count, double fps)
+{
+    Q_UNUSED(fps);
+    slider->setRange(0, int(qMax<qint64>(0, frame_count - 1)));
+    slider->setEnabled(true);
+    updateStrip();
+}
+
+void PlayerWindow::showFrame(QImage image, qint64 frame)
+{
+    current = image;
+    current_frame = frame;
+    updateImage();
+    if (!slider->isSliderDown())
+    {
+        slider->blockSignals(true);
+        slider->setValue(int(frame));
+        slider->blockSignals(false);
+    }
+    time_label->setText(clock(frame) + " / " + clock(player.frameCount()));
+}
+
+// Exporta el tramo marcado (o la grabación entera) copiando paquetes, en segundo plano
+void PlayerWindow::exportRange()
+{
+    QString output = QFileDialog::getSaveFileName(this, "Exportar", name + ".mp4", "Video (*.mp4)");
+    if (output.isEmpty())
+    {
+        return;
+    }
+    std::vector<ClipExport::Segment> segments;
+    const double fps = player.fps();
+    segments.push_back(ClipExport::Segment(name, mark_in < 0 ? 0 : qint64(mark_in * 1000 / fps),
+                                           mark_out < 0 ? -1 : qint64((mark_out + 1) * 1000 / fps)));
+
+    QFutureWatcher<QString> *watcher = new QFutureWatcher<QString>(this);
+    connect(watcher, &QFutureWatcher<QString>::finished, this, [this, watcher, output]() {
+        QString error = watcher->result();
+        watcher->deleteLater();
+        if (error.isEmpty())
+            QMessageBox::information(this, "Exportar", "Exportado en " + output);
+        else
+            QMessageBox::warning(this, "Exportar", error);
+    });
+    watcher->setFuture(QtConcurrent::run([segments, output]() {
+        QString error;
+        ClipExport::run(segments, output, &error);
+        return error;
+    }));
+}
+
+void PlayerWindow::showError(QString message)
+{
+    image_label->setText(message);
+}
+
+void PlayerWindow::updateImage()
+{
+    if (current.isNull())
+    {
+        return;
+    }
+    image_label->setPixmap(QPixmap::fromImage(current).scaled(image_label->size(), Qt::KeepAspectRatio,
+                                                              Qt::FastTransformation));
+}
+
+void PlayerWindow::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    updateImage();
+    updateStrip();
+}
+
+// Miniaturas repartidas a lo largo de la grabación, tantas como entren en el ancho
+void PlayerWindow::updateStrip()
+{
+    if (sprites.count() == 0 || strip->width() <= 0 || player.frameCount() == 0)
+    {
+        return;
+    }
+    QImage first = sprites.thumbnail(0);
+    const int height = strip->height();
+    const int tile = qMax(1, first.width() * height / qMax(1, first.height()));
+    QPixmap pixmap(strip->width(), height);
+    pixmap.fill(Qt::black);
+    QPainter painter(&pixmap);
+    for (int x = 0; x < pixmap.width(); x += tile)
+    {
+        painter.drawImage(QRect(x, 0, tile, height), sprites.thumbnailAt(stripTime(x + tile / 2)));
+    }
+    strip->setPixmap(pixmap);
+}
+
+qint64 PlayerWindow::stripTime(int x) const
+{
+    const double duration_ms = player.frameCount() * 1000.0 / player.fps();
+    return qint64(qBound(0.0, double(x) / qMax(1, strip->width()), 1.0) * duration_ms);
+}
+
+bool PlayerWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == strip && sprites.count() > 0 && player.frameCount() > 0)
+    {
+        if (event->type() == QEvent::MouseMove)
+        {
+            // Vista previa arriba de la tira, sin decodificar nada
+            const int x = static_cast<QMouseEvent *>(event)->pos().x();
+            QImage thumbnail = sprites.thumbnailAt(stripTime(x));
+            preview->setPixmap(QPixmap::fromImage(thumbnail));
+            preview->adjustSize();
+            QPoint pos = strip->mapTo(this, QPoint(x - preview->width() / 2, -preview->height() - 4));
+            preview->move(qBound(0, pos.x(), width() - preview->width()), pos.y());
+            preview->raise();
+            preview->show();
+        }
+        else if (event->type() == QEvent::MouseButtonPress)
+        {
+            const int x = static_cast<QMouseEvent *>(event)->pos().x();
+            player.seek(qint64(stripTime(x) * player.fps() / 1000));
+        }
+        else if (event->type() == QEvent::Leave)
+        {
+            preview->hide();
+        }
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+void PlayerWindow::keyPressEvent(QKeyEvent *event)
+{
+    switch (event->key())
+    {
+    case Qt::Key_Left:
+        direction = 0;
+        player.step(-1);
+        break;
+    case Qt::Key_Right:
+        direction = 0;
+        player.step(1);
+        break;
+    case Qt::Key_Space:
+        direction = direction == 0 ? 1 : 0;
+        if (direction == 0)
+            player.pause();
+        else
+            player.play(direction);
+        break;
+    default:
+        QWidget::keyPressEvent(event);
+    }
+}
+
+QString PlayerWindow::clock(qint64 frame) const
+{
+    const int s = int(frame / player.fps());
+    return QString("%1:%2:%3").arg(s / 3600).arg(s / 60 % 60, 2, 10, QChar('0')).arg(s % 60, 2, 10, QChar('0'));
+}
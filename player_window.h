@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QWidget>
+#include <QLabel>
+#include <QSlider>
+#include <QPushButton>
+#include <QImage>
+
+#include "video_player.h"
+#include "sprite_sheet.h"
+
+// Ventana para ver una grabación guardada: barra para recorrerla, reproducción
+// hacia adelante y hacia atrás y avance frame a frame (flechas y espacio).
+// Debajo, una tira con las miniaturas de la grabación: al pasar el mouse se
+// ve la vista previa de ese momento y con un clic se va ahí. "[" y "]" marcan
+// el tramo que se exporta con "Exportar" (sin recodificar, ver ClipExport).
+class PlayerWindow : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit PlayerWindow(const QString &name, QWidget *parent = nullptr);
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void opened(qint64 frame_count, double fps);
+    void showFrame(QImage image, qint64 frame);
+    void showError(QString message);
+    void exportRange();
+
+private:
+    QString clock(qint64 frame) const;
+    void updateImage();
+    void updateStrip();
+    qint64 stripTime(int x) const;
+
+    VideoPlayer player;
+    QLabel *image_label;
+    QSlider *slider;
+    QLabel *time_label;
+    QLabel *strip;
+    QLabel *preview;
+    SpriteSheet sprites;
+    QString name;
+    qint64 current_frame;
+    qint64 mark_in;  // frames; -1 = sin marcar
+    qint64 mark_out;
+    QImage current;
+    int direction;
+};
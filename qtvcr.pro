@@ -34,7 +34,16 @@ INCLUDEPATH += /usr/include/opencv4/
 DEFINES += OPENCV_DATA_DIR=\\\"/usr/include/opencv4/\\\"
 
 # Si necesitas enlazar bibliotecas de forma manual (por si pkg-config no funciona)
- LIBS += -lopencv_core -lopencv_imgproc -lopencv_highgui -lopencv_videoio
+ LIBS += -lopencv_core -lopencv_imgproc -lopencv_highgui -lopencv_imgcodecs -lopencv_videoio -lopencv_objdetect -lopencv_dnn
+
+# FFmpeg para el reproductor (índice de keyframes, decodificación y escalado)
+PKGCONFIG += libavformat libavcodec libavutil libswscale
+
+# Decodificación MJPEG con reducción en la IDCT (mjpeg_directo)
+PKGCONFIG += libturbojpeg
+
+# shm_open para el anillo de frames (glibc < 2.34)
+unix: LIBS += -lrt
 
 
 # You can make your code fail to compile if you use deprecated APIs.
@@ -46,7 +55,73 @@ DEFINES += OPENCV_DATA_DIR=\\\"/usr/include/opencv4/\\\"
 
 # Input
 HEADERS += mainwindow.h capture_thread.h utilities.h \
-    json_parser.h
+    json_parser.h \
+    video_recorder.h \
+    frame_kernels.h \
+    benchmarks.h \
+    motion_gate.h \
+    roi_mask.h \
+    metrics.h \
+    detection_scheduler.h \
+    frame_grabber.h \
+    load_shedder.h \
+    detector.h \
+    dnn_detector.h \
+    detection_service.h \
+    frame_ring.h \
+    frame_tap_format.h \
+    frame_tap_reader.h \
+    camera_worker.h \
+    worker_supervisor.h \
+    mjpeg_server.h \
+    event_stream.h \
+    detection_tracker.h \
+    track_file.h \
+    detection_index.h \
+    keyframe_index.h \
+    video_player.h \
+    player_window.h \
+    sprite_sheet.h \
+    clip_export.h \
+    libav_writer.h \
+    archive_transcoder.h \
+    async_io.h \
+    storage_file.h \
+    mjpeg_decoder.h \
+    thread_placement.h \
+    memory_budget.h
 SOURCES += main.cpp mainwindow.cpp capture_thread.cpp utilities.cpp \
-    json_parser.cpp
+    json_parser.cpp \
+    video_recorder.cpp \
+    frame_kernels.cpp \
+    benchmarks.cpp \
+    motion_gate.cpp \
+    roi_mask.cpp \
+    metrics.cpp \
+    detection_scheduler.cpp \
+    frame_grabber.cpp \
+    load_shedder.cpp \
+    detector.cpp \
+    dnn_detector.cpp \
+    detection_service.cpp \
+    frame_ring.cpp \
+    camera_worker.cpp \
+    worker_supervisor.cpp \
+    mjpeg_server.cpp \
+    event_stream.cpp \
+    detection_tracker.cpp \
+    track_file.cpp \
+    detection_index.cpp \
+    keyframe_index.cpp \
+    video_player.cpp \
+    player_window.cpp \
+    sprite_sheet.cpp \
+    clip_export.cpp \
+    libav_writer.cpp \
+    archive_transcoder.cpp \
+    async_io.cpp \
+    storage_file.cpp \
+    mjpeg_decoder.cpp \
+    thread_placement.cpp \
+    memory_budget.cpp
 
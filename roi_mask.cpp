@@ -0,0 +1,75 @@
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QDebug>
+
+#include <opencv2/imgproc.hpp>
+
+#include "utilities.h"
+#include "roi_mask.h"
+
+bool RoiMask::load(const QString &camera_key)
+{
+    zones.clear();
+    QJsonArray list = Utilities::getParamValue(camera_key + ".zonas").toArray();
+    for (int i = 0; i < list.size(); i++)
+    {
+        QJsonObject object = list.at(i).toObject();
+        QJsonArray points = object.value("puntos").toArray();
+        if (points.size() < 3)
+        {
+            qWarning() << "Zona" << i << "de" << camera_key << "ignorada: necesita al menos 3 puntos.";
+            continue;
+        }
+
+        Zone zone;
+        zone.include = object.value("tipo").toString() != QString("excluir");
+        for (int p = 0; p < points.size(); p++)
+        {
+            QJsonArray xy = points.at(p).toArray();
+            zone.points.push_back(cv::Point2f(float(xy.at(0).toDouble()), float(xy.at(1).toDouble())));
+        }
+        zones.push_back(zone);
+    }
+    qDebug() << "Zonas de interés de" << camera_key << ":" << int(zones.size());
+    return !zones.empty();
+}
+
+cv::Mat RoiMask::rasterize(cv::Size size) const
+{
+    bool has_include = false;
+    for (size_t i = 0; i < zones.size(); i++)
+        has_include = has_include || zones[i].include;
+
+    cv::Mat mask(size, CV_8UC1, cv::Scalar(has_include ? 0 : 255));
+
+    // Primero las zonas incluidas y después las excluidas, que tienen prioridad
+    for (int pass = 0; pass < 2; pass++)
+    {
+        const bool include = pass == 0;
+        for (size_t i = 0; i < zones.size(); i++)
+        {
+            if (zones[i].include != include)
+                continue;
+            std::vector<cv::Point> polygon;
+            for (size_t p = 0; p < zones[i].points.size(); p++)
+            {
+                polygon.push_back(cv::Point(cvRound(zones[i].points[p].x * size.width),
+                                            cvRound(zones[i].points[p].y * size.height)));
+            }
+            std::vector<std::vector<cv::Point>> polygons(1, polygon);
+            cv::fillPoly(mask, polygons, cv::Scalar(include ? 255 : 0));
+        }
+    }
+    return mask;
+}
+
+std::vector<cv::Rect> RoiMask::activeBounds(const cv::Mat &mask)
+{
+    std::vector<std::vector<cv::Point>> contours;
+    cv::findContours(mask.clone(), contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+
+    std::vector<cv::Rect> bounds;
+    for (size_t i = 0; i < contours.size(); i++)
+        bounds.push_back(cv::boundingRect(contours[i]));
+    return bounds;
+}
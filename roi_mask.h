@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <QString>
+#include "opencv2/opencv.hpp"
+
+// Zonas de interés de una cámara, definidas en config.cfg como polígonos con
+// coordenadas normalizadas (0 a 1) para no depender de la resolución:
+//
+//   "cam1": { ...,
+//     "zonas": [
+//       {"tipo": "incluir", "puntos": [[0.1, 0.3], [0.9, 0.3], [0.9, 1], [0.1, 1]]},
+//       {"tipo": "excluir", "puntos": [[0.6, 0.3], [0.9, 0.3], [0.9, 0.5]]}
+//     ]
+//   }
+//
+// Sin zonas "incluir" se considera activa toda la imagen menos las "excluir".
+class RoiMask
+{
+public:
+    // Lee <camera_key>.zonas. Devuelve false si la cámara no tiene zonas.
+    bool load(const QString &camera_key);
+    bool isEmpty() const { return zones.empty(); }
+
+    // Máscara CV_8UC1 (255 = activo) del tamaño pedido.
+    cv::Mat rasterize(cv::Size size) const;
+
+    // Rectángulos que contienen las áreas activas de una máscara.
+    static std::vector<cv::Rect> activeBounds(const cv::Mat &mask);
+
+private:
+    struct Zone
+    {
+        bool include;
+        std::vector<cv::Point2f> points;
+    };
+    std::vector<Zone> zones;
+};
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <QFile>
+#include <QImageReader>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "utilities.h"
+#include "async_io.h"
+#include "sprite_sheet.h"
+
+namespace {
+const int COLUMNS = 10;
+// Una grabación larga no puede generar una imagen enorme: al pasar este
+// número se descarta una de cada dos miniaturas y se duplica el intervalo.
+const size_t MAX_THUMBNAILS = 600;
+// Por presión de memoria el intervalo no pasa de este múltiplo del configurado
+const int MAX_PRESSURE_THINNING = 8;
+
+qint64 thumbnailBytes(const cv::Mat &thumbnail)
+{
+    return qint64(thumbnail.total() * thumbnail.elemSize());
+}
+}
+
+SpriteSheetBuilder::SpriteSheetBuilder() :
+    thumbnail_width(256), base_interval_ms(2000), interval_ms(2000), next_ms(0), thinned_under_pressure(false),
+    memory("miniaturas", MemoryBudget::CACHE)
+{
+}
+
+void SpriteSheetBuilder::configure(int thumbnail_width, int interval_ms)
+{
+    this->thumbnail_width = qMax(16, thumbnail_width);
+    this->base_interval_ms = this->interval_ms = qMax(100, interval_ms);
+}
+
+void SpriteSheetBuilder::reset()
+{
+    thumbnails.clear();
+    times.clear();
+    interval_ms = base_interval_ms;
+    next_ms = 0;
+    thinned_under_pressure = false;
+    memory.release(memory.used());
+}
+
+void SpriteSheetBuilder::add(const cv::Mat &frame, qint64 t_ms)
+{
+    if (t_ms < next_ms || frame.empty())
+    {
+        return;
+    }
+    const int height = qMax(1, frame.rows * thumbnail_width / frame.cols);
+    cv::Mat thumbnail;
+    cv::resize(frame, thumbnail, cv::Size(thumbnail_width, height), 0, 0, cv::INTER_AREA);
+    memory.charge(thumbnailBytes(thumbnail));
+    thumbnails.push_back(thumbnail);
+    times.push_back(t_ms);
+    next_ms = t_ms + interval_ms;
+
+    if (thumbnails.size() >= MAX_THUMBNAILS)
+    {
+        thin();
+        return;
+    }
+
+    // Con el presupuesto de memoria bajo presión también se ralea, una vez por
+    // episodio (la presión dura muchos frames) y hasta un tope de intervalo
+    const bool pressure = MemoryBudget::underPressure();
+    if (pressure && !thinned_under_pressure && thumbnails.size() >= 2 &&
+        interval_ms < base_interval_ms * MAX_PRESSURE_THINNING)
+    {
+        thin();
+    }
+    thinned_under_pressure = pressure;
+}
+
+// Descarta una de cada dos miniaturas y duplica el intervalo
+void SpriteSheetBuilder::thin()
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < thumbnails.size(); i++)
+    {
+        if (i % 2 != 0)
+        {
+            memory.release(thumbnailBytes(thumbnails[i]));
+            continue;
+        }
+        thumbnails[kept] = thumbnails[i];
+        times[kept] = times[i];
+        kept++;
+    }
+    thumbnails.resize(kept);
+    times.resize(kept);
+    interval_ms *= 2;
+    next_ms = times.back() + interval_ms;
+}
+
+bool SpriteSheetBuilder::save(const QString &name)
+{
+    if (thumbnails.empty())
+    {
+        return false;
+    }
+    const int width = thumbnails[0].cols;
+    const int height = thumbnails[0].rows;
+    const int columns = int(std::min<size_t>(COLUMNS, thumbnails.size()));
+    const int rows = int((thumbnails.size() + COLUMNS - 1) / COLUMNS);
+
+    cv::Mat sheet(rows * height, columns * width, thumbnails[0].type(), cv::Scalar::all(0));
+    QJsonArray t_ms;
+    for (size_t i = 0; i < thumbnails.size(); i++)
+    {
+        cv::Rect cell(int(i % COLUMNS) * width, int(i / COLUMNS) * height, width, height);
+        // Si cambió la resolución a mitad de grabación la miniatura se ajusta a la celda
+        if (thumbnails[i].size() == cell.size())
+            thumbnails[i].copyTo(sheet(cell));
+        else
+            cv::resize(thumbnails[i], sheet(cell), cell.size(), 0, 0, cv::INTER_AREA);
+        t_ms.append(double(times[i]));
+    }
+
+    std::vector<int> params;
+    params.push_back(cv::IMWRITE_JPEG_QUALITY);
+    params.push_back(80);
+    std::vector<uchar> jpeg;
+    if (!cv::imencode(".jpg", sheet, jpeg, params))
+    {
+        return false;
+    }
+    // La escritura va por AsyncIO para no frenar la captura
+    AsyncIO *io = AsyncIO::instance();
+    const QString jpeg_path = Utilities::getSavedVideoPath(name, "miniaturas.jpg");
+    io->replace(jpeg_path, QByteArray(reinterpret_cast<const char *>(jpeg.data()), int(jpeg.size())));
+    io->close(jpeg_path);
+
+    // La lista de videos solo necesita la portada: archivo aparte y chico
+    std::vector<uchar> cover;
+    if (cv::imencode(".jpg", thumbnails[0], cover, params))
+    {
+        const QString cover_path = Utilities::getSavedVideoPath(name, "portada.jpg");
+        io->replace(cover_path, QByteArray(reinterpret_cast<const char *>(cover.data()), int(cover.size())));
+        io->close(cover_path);
+    }
+
+    QJsonObject info;
+    info.insert("ancho", width);
+    info.insert("alto", height);
+    info.insert("columnas", columns);
+    info.insert("t_ms", t_ms);
+    const QString json_path = Utilities::getSavedVideoPath(name, "miniaturas.json");
+    io->replace(json_path, QJsonDocument(info).toJson(QJsonDocument::Compact));
+    io->close(json_path);
+    return true;
+}
+
+bool SpriteSheet::load(const QString &name)
+{
+    QFile file(Utilities::getSavedVideoPath(name, "miniaturas.json"));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    QJsonObject info = QJsonDocument::fromJson(file.readAll()).object();
+    width = info.value("ancho").toInt();
+    height = info.value("alto").toInt();
+    columns = qMax(1, info.value("columnas").toInt());
+    times.clear();
+    foreach (const QJsonValue &t, info.value("t_ms").toArray())
+    {
+        times.push_back(qint64(t.toDouble()));
+    }
+    sheet = QImage();
+    sheet_path = Utilities::getSavedVideoPath(name, "miniaturas.jpg");
+    if (width <= 0 || height <= 0 || times.empty() || !QFile::exists(sheet_path))
+    {
+        times.clear();
+        return false;
+    }
+    return true;
+}
+
+QImage SpriteSheet::cover(const QString &name)
+{
+    QImage image(Utilities::getSavedVideoPath(name, "portada.jpg"));
+    if (!image.isNull())
+    {
+        return image;
+    }
+    // Grabaciones sin portada: solo la primera celda de la grilla (el
+    // decodificador JPEG se detiene al terminar el recorte)
+    SpriteSheet sprites;
+    if (!sprites.load(name))
+    {
+        return QImage();
+    }
+    QImageReader reader(sprites.sheet_path);
+    reader.setClipRect(QRect(0, 0, sprites.width, sprites.height));
+    return reader.read();
+}
+
+QImage SpriteSheet::thumbnail(int i) const
+{
+    if (i < 0 || i >= count())
+    {
+        return QImage();
+    }
+    if (sheet.isNull() && !sheet.load(sheet_path))
+    {
+        return QImage();
+    }
+    return sheet.copy((i % columns) * width, (i / columns) * height, width, height);
+}
+
+QImage SpriteSheet::thumbnailAt(qint64 t_ms) const
+{
+    auto it = std::upper_bound(times.begin(), times.end(), t_ms);
+    return thumbnail(qMax(0, int(it - times.begin()) - 1));
+}
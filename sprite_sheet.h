@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <QString>
+#include <QImage>
+#include "opencv2/opencv.hpp"
+#include "memory_budget.h"
+
+// Miniaturas de una grabación tomadas cada miniatura_intervalo_s segundos
+// mientras se graba, juntas en una sola imagen:
+//
+//   <nombre>.miniaturas.jpg   grilla de miniaturas (columnas fijas, por filas)
+//   <nombre>.miniaturas.json  {"ancho":256,"alto":144,"columnas":10,"t_ms":[0,2000,...]}
+//   <nombre>.portada.jpg      la primera miniatura sola (portada de la lista)
+//
+// La lista de videos y el reproductor muestran la vista previa y la tira de
+// tiempo sin decodificar el video. La grilla se decodifica recién cuando se
+// pide una miniatura; la portada no la necesita.
+
+// Lado de la grabación: junta miniaturas de los frames que ya se están escribiendo
+class SpriteSheetBuilder
+{
+public:
+    SpriteSheetBuilder();
+
+    void configure(int thumbnail_width, int interval_ms);
+    void reset();
+
+    // t_ms: posición del frame en el video
+    void add(const cv::Mat &frame, qint64 t_ms);
+    bool save(const QString &name);
+
+    bool isEmpty() const { return thumbnails.empty(); }
+
+private:
+    void thin();
+
+    int thumbnail_width;
+    int base_interval_ms; // el configurado; interval_ms crece al ralear
+    int interval_ms;
+    qint64 next_ms;
+    bool thinned_under_pressure; // el episodio de presión actual ya se atendió
+    std::vector<cv::Mat> thumbnails;
+    std::vector<qint64> times;
+    MemoryBudget::Account memory; // miniaturas en memoria hasta save()
+};
+
+// Lado de la lectura (GUI)
+class SpriteSheet
+{
+public:
+    // Lee la descripción; la grilla se decodifica con la primera miniatura pedida
+    bool load(const QString &name);
+
+    // Primera miniatura sin decodificar la grilla (nula si no hay miniaturas)
+    static QImage cover(const QString &name);
+
+    int count() const { return int(times.size()); }
+    QImage thumbnail(int i) const;
+    QImage thumbnailAt(qint64 t_ms) const;
+    qint64 timeOf(int i) const { return times[size_t(i)]; }
+
+private:
+    QString sheet_path;
+    mutable QImage sheet;
+    int width = 0;
+    int height = 0;
+    int columns = 1;
+    std::vector<qint64> times;
+};
@@ -0,0 +1,219 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <map>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QDebug>
+
+#include "utilities.h"
+#include "metrics.h"
+#include "storage_file.h"
+
+namespace {
+// Balde de tokens por dispositivo: permite ráfagas de hasta un segundo de escritura
+struct Bucket
+{
+    double tokens;
+    double rate; // bytes por segundo
+    QElapsedTimer refill;
+};
+QMutex buckets_lock;
+std::map<std::pair<dev_t, bool>, Bucket> buckets; // (disco, de fondo)
+
+// Recarga y descuenta; devuelve los segundos hasta volver a cero
+double take(Bucket &bucket, double rate, double bytes)
+{
+    bucket.rate = rate;
+    if (!bucket.refill.isValid())
+    {
+        bucket.tokens = rate;
+        bucket.refill.start();
+    }
+    bucket.tokens = qMin(rate, bucket.tokens + bucket.refill.nsecsElapsed() * rate / 1e9);
+    bucket.refill.restart();
+    bucket.tokens -= bytes;
+    return bucket.tokens < 0 ? -bucket.tokens / rate : 0;
+}
+}
+
+StorageFile::Options StorageFile::optionsFromConfig(bool background)
+{
+    Options options;
+    options.prealloc_bytes = int64_t(qMax(0, Utilities::getParamInt("grabacion_prealoc_mb", 16))) << 20;
+    options.writeback_bytes = int64_t(qMax(0, Utilities::getParamInt("grabacion_writeback_mb", 8))) << 20;
+    options.drop_cache = Utilities::getParam("grabacion_descartar_cache") != QString("false");
+    options.max_mb_s = qMax(0.0, Utilities::getParamDouble("disco_mb_s", 0));
+    if (background)
+    {
+        options.background = true;
+        options.max_mb_s = qMax(0.0, Utilities::getParamDouble("archivo_disco_mb_s", options.max_mb_s / 4));
+    }
+    return options;
+}
+
+StorageFile::StorageFile() :
+    fd(-1), device(0), position(0), end(0), allocated(0), flushing(0), dropped(0)
+{
+}
+
+StorageFile::~StorageFile()
+{
+    close();
+}
+
+bool StorageFile::open(const QString &path, const Options &options)
+{
+    close();
+    this->options = options;
+    fd = ::open(QFile::encodeName(path).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        qWarning() << "No se pudo crear" << path << ":" << strerror(errno);
+        return false;
+    }
+    struct stat info;
+    device = fstat(fd, &info) == 0 ? info.st_dev : 0;
+    position = end = allocated = flushing = dropped = 0;
+    return true;
+}
+
+void StorageFile::close()
+{
+    if (fd < 0)
+    {
+        return;
+    }
+    // Lo reservado de más (FALLOC_FL_KEEP_SIZE) se devuelve al truncar al largo real
+    if (allocated > end)
+    {
+        ftruncate(fd, off_t(end));
+    }
+#ifdef Q_OS_LINUX
+    if (options.drop_cache)
+    {
+        // Sin esperar: se pide el writeback del final y se descarta lo que ya esté limpio
+        sync_file_range(fd, off_t(flushing), off_t(qMax<int64_t>(0, end - flushing)), SYNC_FILE_RANGE_WRITE);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+#endif
+    ::close(fd);
+    fd = -1;
+}
+
+bool StorageFile::write(const uint8_t *data, int size)
+{
+    if (fd < 0)
+    {
+        return false;
+    }
+    throttle(size);
+
+#ifdef Q_OS_LINUX
+    if (options.prealloc_bytes > 0 && position + size > allocated)
+    {
+        // Se reserva de a tramos enteros; si el sistema de archivos no lo soporta se sigue sin reservar
+        const int64_t chunk = ((position + size - allocated) / options.prealloc_bytes + 1) * options.prealloc_bytes;
+        if (fallocate(fd, FALLOC_FL_KEEP_SIZE, off_t(allocated), off_t(chunk)) == 0)
+            allocated += chunk;
+        else
+            options.prealloc_bytes = 0;
+    }
+#endif
+
+    int64_t offset = position;
+    while (size > 0)
+    {
+        const ssize_t n = ::pwrite(fd, data, size_t(size), off_t(offset));
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            qWarning() << "Error escribiendo la grabación:" << strerror(errno);
+            return false;
+        }
+        data += n;
+        offset += n;
+        size -= int(n);
+    }
+    position = offset;
+    end = qMax(end, position);
+    writeback();
+    return true;
+}
+
+int64_t StorageFile::seek(int64_t offset, int whence)
+{
+    switch (whence)
+    {
+    case SEEK_SET: position = offset; break;
+    case SEEK_CUR: position += offset; break;
+    case SEEK_END: position = end + offset; break;
+    default: return -1;
+    }
+    return position;
+}
+
+void StorageFile::checkpoint()
+{
+#ifdef Q_OS_LINUX
+    if (fd >= 0 && end > flushing)
+    {
+        sync_file_range(fd, off_t(flushing), off_t(end - flushing), SYNC_FILE_RANGE_WRITE);
+        flushing = end;
+    }
+#endif
+}
+
+// Pide el writeback del tramo nuevo y saca del cache el tramo anterior, que a
+// esta altura ya debería estar en disco (la espera casi nunca bloquea).
+void StorageFile::writeback()
+{
+#ifdef Q_OS_LINUX
+    if (options.writeback_bytes <= 0 || end - flushing < options.writeback_bytes)
+    {
+        return;
+    }
+    sync_file_range(fd, off_t(flushing), off_t(end - flushing), SYNC_FILE_RANGE_WRITE);
+    if (options.drop_cache && flushing > dropped)
+    {
+        sync_file_range(fd, off_t(dropped), off_t(flushing - dropped),
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        posix_fadvise(fd, off_t(dropped), off_t(flushing - dropped), POSIX_FADV_DONTNEED);
+        dropped = flushing;
+    }
+    flushing = end;
+#endif
+}
+
+// Límite de ancho de banda por disco: cada escritura descuenta del balde y, si
+// queda en negativo, espera lo que tarde en recargarse. Los archivos de fondo
+// usan su propio balde y esperan además lo que deban las grabaciones.
+void StorageFile::throttle(int64_t bytes)
+{
+    double wait_s = 0;
+    {
+        QMutexLocker locker(&buckets_lock);
+        if (options.max_mb_s > 0)
+            wait_s = take(buckets[std::make_pair(device, options.background)], options.max_mb_s * 1e6, double(bytes));
+        if (options.background)
+        {
+            auto live = buckets.find(std::make_pair(device, false));
+            if (live != buckets.end())
+            {
+                // Sin descontar: solo se mira si las grabaciones están en deuda
+                wait_s = qMax(wait_s, take(live->second, live->second.rate, 0));
+            }
+        }
+    }
+    if (wait_s > 0)
+    {
+        Metrics::add(options.background ? "disco.espera_fondo_ms" : "disco.espera_ms", wait_s * 1000);
+        QThread::usleep(ulong(wait_s * 1e6));
+    }
+}
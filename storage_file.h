@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <QString>
+
+// Archivo de grabación escrito de forma secuencial con control del page cache.
+//
+// Con muchas cámaras grabando a la vez el cache se llena de video que nadie
+// va a leer pronto y el writeback termina frenando a todo el sistema. Por eso:
+//
+// - Se reserva espacio de a grabacion_prealoc_mb con fallocate (menos
+//   fragmentación con varios archivos creciendo en paralelo). Al cerrar se
+//   libera lo que sobró.
+// - Cada grabacion_writeback_mb escritos se pide el writeback de ese tramo
+//   (sync_file_range) y el tramo anterior, ya en disco, se saca del cache
+//   (posix_fadvise DONTNEED). Así el cache sucio de cada archivo queda acotado
+//   a un par de tramos. grabacion_descartar_cache=false deja el cache.
+// - disco_mb_s limita el ancho de banda de escritura por disco, compartido
+//   por todos los archivos del proceso que van al mismo dispositivo.
+//   Los archivos de fondo (el archivado de ArchiveTranscoder) no descuentan
+//   de ese balde: tienen uno propio (archivo_disco_mb_s, por defecto la cuarta
+//   parte de disco_mb_s) y además esperan mientras las grabaciones en vivo
+//   estén esperando por el disco.
+//
+// LibavWriter lo usa como destino del mp4 (AVIOContext propio).
+class StorageFile
+{
+public:
+    struct Options
+    {
+        int64_t prealloc_bytes;  // 0 = sin fallocate
+        int64_t writeback_bytes; // 0 = lo decide el kernel
+        bool drop_cache;
+        double max_mb_s;         // por disco; 0 = sin límite
+        bool background;         // balde aparte, cede ante los demás
+
+        Options() : prealloc_bytes(0), writeback_bytes(0), drop_cache(false), max_mb_s(0), background(false) {}
+    };
+
+    static Options optionsFromConfig(bool background = false);
+
+    StorageFile();
+    ~StorageFile();
+
+    bool open(const QString &path, const Options &options);
+    bool isOpen() const { return fd >= 0; }
+    void close();
+
+    // En la posición actual
+    bool write(const uint8_t *data, int size);
+    // Como lseek(); SEEK_END toma el largo escrito (no lo reservado)
+    int64_t seek(int64_t offset, int whence);
+    int64_t size() const { return end; }
+
+    // Pide el writeback de todo lo escrito hasta ahora, sin esperar
+    void checkpoint();
+
+private:
+    void throttle(int64_t bytes);
+    void writeback();
+
+    Options options;
+    int fd;
+    dev_t device;
+    int64_t position;
+    int64_t end;        // largo real del archivo
+    int64_t allocated;  // reservado con fallocate
+    int64_t flushing;   // writeback pedido hasta acá
+    int64_t dropped;    // fuera del cache hasta acá
+};
@@ -0,0 +1,293 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <QStringList>
+#include <QDebug>
+
+#include "utilities.h"
+#include "metrics.h"
+#include "thread_placement.h"
+
+namespace {
+struct Settings
+{
+    QString cpus;
+    bool has_nice = false;
+    int nice = 0;
+    bool realtime = false;
+    int policy = 0;
+    int priority = 0;
+};
+
+QString param(ThreadPlacement::Stage stage, const QString &camera_key, const char *field)
+{
+    const QString name = QString("hilos_%1_%2").arg(ThreadPlacement::stageName(stage)).arg(field);
+    if (!camera_key.isEmpty())
+    {
+        const QString value = Utilities::getParam(camera_key + "." + name);
+        if (!value.isEmpty())
+            return value;
+    }
+    return Utilities::getParam(name);
+}
+
+void failed(const char *what, const QString &metric_key)
+{
+    qWarning() << "Hilos:" << what << "para" << metric_key << ":" << strerror(errno);
+    Metrics::add("hilos.errores", 1);
+}
+
+QString metricKey(ThreadPlacement::Stage stage, const QString &camera_key)
+{
+    const QString key = QString("hilos.") + ThreadPlacement::stageName(stage);
+    return camera_key.isEmpty() ? key : camera_key + "." + key;
+}
+
+#ifdef Q_OS_LINUX
+pid_t currentTid()
+{
+    return pid_t(syscall(SYS_gettid));
+}
+
+// CPUs del proceso antes de ubicar ningún hilo (el primero en llamar todavía
+// tiene las heredadas del hilo principal)
+const cpu_set_t &processCpus()
+{
+    static const cpu_set_t cpus = []() {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) != 0)
+        {
+            for (int i = 0; i < CPU_SETSIZE; i++)
+                CPU_SET(i, &set);
+        }
+        return set;
+    }();
+    return cpus;
+}
+
+// "0-3,8" -> conjunto; false si no se entiende
+bool parseCpus(const QString &text, cpu_set_t &set)
+{
+    CPU_ZERO(&set);
+    foreach (const QString &part, text.split(',', Qt::SkipEmptyParts))
+    {
+        const QStringList range = part.trimmed().split('-');
+        bool ok_first = false, ok_last = true;
+        const int first = range.value(0).toInt(&ok_first);
+        const int last = range.size() > 1 ? range.value(1).toInt(&ok_last) : first;
+        if (!ok_first || !ok_last || range.size() > 2 || first < 0 || last < first || last >= CPU_SETSIZE)
+            return false;
+        for (int cpu = first; cpu <= last; cpu++)
+            CPU_SET(cpu, &set);
+    }
+    return CPU_COUNT(&set) > 0;
+}
+
+QString formatCpus(const cpu_set_t &set)
+{
+    QStringList parts;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (!CPU_ISSET(cpu, &set))
+            continue;
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &set))
+            last++;
+        parts << (last == cpu ? QString::number(cpu) : QString("%1-%2").arg(cpu).arg(last));
+        cpu = last;
+    }
+    return parts.join(',');
+}
+
+Settings settingsFor(ThreadPlacement::Stage stage, const QString &camera_key)
+{
+    Settings s;
+    s.cpus = param(stage, camera_key, "cpus").trimmed();
+    const QString nice = param(stage, camera_key, "nice");
+    s.nice = nice.toInt(&s.has_nice);
+    const QString policy = param(stage, camera_key, "politica").trimmed().toLower();
+    if (policy == "fifo" || policy == "rr")
+    {
+        s.realtime = true;
+        s.policy = policy == "fifo" ? SCHED_FIFO : SCHED_RR;
+        bool ok = false;
+        s.priority = param(stage, camera_key, "prioridad").toInt(&ok);
+        s.priority = ok ? qBound(sched_get_priority_min(s.policy), s.priority, sched_get_priority_max(s.policy)) : 10;
+    }
+    else if (!policy.isEmpty())
+    {
+        qWarning() << "Hilos: política desconocida" << policy << "- se usa la normal";
+    }
+    return s;
+}
+
+// Lo que el kernel dice que quedó
+QString describe(pid_t tid)
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    sched_getaffinity(tid, sizeof(cpus), &cpus);
+    errno = 0;
+    const int nice = getpriority(PRIO_PROCESS, id_t(tid));
+    const int policy = sched_getscheduler(tid);
+    struct sched_param sp = {};
+    sched_getparam(tid, &sp);
+
+    QString name;
+    switch (policy)
+    {
+    case SCHED_FIFO: name = QString("fifo %1").arg(sp.sched_priority); break;
+    case SCHED_RR: name = QString("rr %1").arg(sp.sched_priority); break;
+    case SCHED_IDLE: name = "idle"; break;
+    case SCHED_BATCH: name = "batch"; break;
+    default: name = "normal"; break;
+    }
+    return QString("cpus %1, nice %2, %3").arg(formatCpus(cpus)).arg(nice).arg(name);
+}
+
+// Nice más bajo al que este hilo puede volver sin privilegios
+bool canLowerNiceTo(int nice)
+{
+    if (geteuid() == 0)
+        return true;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NICE, &limit) != 0)
+        return false;
+    return limit.rlim_cur == RLIM_INFINITY || 20 - int(limit.rlim_cur) <= nice;
+}
+
+void place(pid_t tid, const Settings &s, const QString &metric_key, bool apply_nice)
+{
+    cpu_set_t cpus;
+    if (s.cpus.isEmpty() || !parseCpus(s.cpus, cpus))
+    {
+        if (!s.cpus.isEmpty())
+            qWarning() << "Hilos: lista de CPUs inválida" << s.cpus << "para" << metric_key;
+        cpus = processCpus();
+    }
+    if (sched_setaffinity(tid, sizeof(cpus), &cpus) != 0)
+        failed("sched_setaffinity", metric_key);
+
+    struct sched_param sp = {};
+    if (s.realtime)
+    {
+        sp.sched_priority = s.priority;
+        if (sched_setscheduler(tid, s.policy, &sp) != 0)
+            failed("tiempo real", metric_key);
+    }
+    else
+    {
+        // Sin política configurada no se hereda el tiempo real del creador
+        const int current = sched_getscheduler(tid);
+        if ((current == SCHED_FIFO || current == SCHED_RR) && sched_setscheduler(tid, SCHED_OTHER, &sp) != 0)
+            failed("sched_setscheduler", metric_key);
+    }
+
+    if (s.has_nice && apply_nice && setpriority(PRIO_PROCESS, id_t(tid), qBound(-20, s.nice, 19)) != 0)
+        failed("nice", metric_key);
+}
+#endif
+}
+
+const char *ThreadPlacement::stageName(Stage stage)
+{
+    switch (stage)
+    {
+    case GRAB: return "captura";
+    case ANALYSIS: return "analisis";
+    case DETECTION: return "deteccion";
+    case ENCODING: return "codificacion";
+    case IO: return "io";
+    case GUI: return "gui";
+    }
+    return "";
+}
+
+void ThreadPlacement::apply(Stage stage, const QString &camera_key)
+{
+#ifdef Q_OS_LINUX
+    processCpus();
+    const QString metric_key = metricKey(stage, camera_key);
+    const pid_t tid = currentTid();
+    place(tid, settingsFor(stage, camera_key), metric_key, true);
+
+    const QString placed = describe(tid);
+    qDebug().noquote() << "Hilo" << metric_key << "(" << tid << "):" << placed;
+    Metrics::set(metric_key, placed);
+#else
+    Q_UNUSED(stage);
+    Q_UNUSED(camera_key);
+#endif
+}
+
+void ThreadPlacement::applyOnce(Stage stage, const QString &camera_key)
+{
+    thread_local bool placed = false;
+    if (!placed)
+    {
+        placed = true;
+        apply(stage, camera_key);
+    }
+}
+
+struct ThreadPlacement::Scope::Saved
+{
+#ifdef Q_OS_LINUX
+    pid_t tid;
+    cpu_set_t cpus;
+    int policy;
+    struct sched_param param;
+    int nice;
+    bool nice_changed;
+#endif
+};
+
+ThreadPlacement::Scope::Scope(Stage stage, const QString &camera_key) :
+    saved(nullptr)
+{
+#ifdef Q_OS_LINUX
+    processCpus();
+    saved = new Saved();
+    saved->tid = currentTid();
+    CPU_ZERO(&saved->cpus);
+    sched_getaffinity(saved->tid, sizeof(saved->cpus), &saved->cpus);
+    saved->policy = sched_getscheduler(saved->tid);
+    sched_getparam(saved->tid, &saved->param);
+    saved->nice = getpriority(PRIO_PROCESS, id_t(saved->tid));
+
+    const Settings s = settingsFor(stage, camera_key);
+    const QString metric_key = metricKey(stage, camera_key);
+    // Subir el nice es siempre posible; bajarlo de vuelta puede no serlo
+    saved->nice_changed = s.has_nice && s.nice != saved->nice &&
+                          (s.nice < saved->nice || canLowerNiceTo(saved->nice));
+    if (s.has_nice && !saved->nice_changed && s.nice != saved->nice)
+    {
+        static bool warned = false;
+        if (!warned)
+            qWarning().noquote() << "Hilos:" << metric_key << "sin permiso para restaurar el nice; se ignora"
+                                 << QString("hilos_%1_nice").arg(stageName(stage));
+        warned = true;
+    }
+    place(saved->tid, s, metric_key, saved->nice_changed);
+    Metrics::set(metric_key, describe(saved->tid));
+#else
+    Q_UNUSED(stage);
+    Q_UNUSED(camera_key);
+#endif
+}
+
+ThreadPlacement::Scope::~Scope()
+{
+#ifdef Q_OS_LINUX
+    sched_setaffinity(saved->tid, sizeof(saved->cpus), &saved->cpus);
+    if (sched_getscheduler(saved->tid) != saved->policy)
+        sched_setscheduler(saved->tid, saved->policy, &saved->param);
+    if (saved->nice_changed)
+        setpriority(PRIO_PROCESS, id_t(saved->tid), saved->nice);
+#endif
+    delete saved;
+}
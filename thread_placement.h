@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QString>
+
+// Ubicación de los hilos de cada etapa del pipeline: CPUs, nice y política.
+//
+// En máquinas con muchos núcleos la lectura de las cámaras compite con los
+// detectores y la GUI, y eso se nota como irregularidad en la captura. Cada
+// etapa se puede ubicar por separado en config.cfg; la clave de la cámara
+// tiene prioridad sobre la global:
+//
+//   hilos_<etapa>_cpus       lista de CPUs, ej. "0-3,8" (vacío = las del proceso)
+//   hilos_<etapa>_nice       -20..19 (vacío = sin cambio)
+//   hilos_<etapa>_politica   "fifo" o "rr" (tiempo real; pensado para captura)
+//   hilos_<etapa>_prioridad  1..99 para fifo/rr (10)
+//   <cam>.hilos_<etapa>_...  solo para esa cámara
+//
+// Etapas: captura (FrameGrabber), analisis (bucle de CaptureThread),
+// deteccion (despachador y pool de DetectionService), codificacion (hilos de
+// libav de las grabaciones), io (pool de AsyncIO) y gui (hilo principal).
+//
+// Los hilos nuevos heredan la ubicación de quien los crea, así que una etapa
+// sin cpus configuradas vuelve a todas las CPUs del proceso en vez de quedarse
+// con las de su creador. La ubicación real (leída del kernel después de
+// aplicarla) se informa en el log y en las métricas: hilos.<etapa> o
+// <cam>.hilos.<etapa>. Los pedidos que el kernel rechaza (tiempo real o nice
+// negativo sin CAP_SYS_NICE) suman a hilos.errores.
+class ThreadPlacement
+{
+public:
+    enum Stage
+    {
+        GRAB,
+        ANALYSIS,
+        DETECTION,
+        ENCODING,
+        IO,
+        GUI
+    };
+
+    // Ubica el hilo que llama
+    static void apply(Stage stage, const QString &camera_key = QString());
+
+    // Igual que apply() una sola vez por hilo (hilos de un pool)
+    static void applyOnce(Stage stage, const QString &camera_key = QString());
+
+    // Ubica el hilo que llama mientras exista: los hilos que se crean adentro
+    // (ej. los del encoder en avcodec_open2) nacen con la ubicación de la etapa.
+    // Al destruirse el hilo vuelve a como estaba. El nice se aplica solo si
+    // después se puede volver atrás (RLIMIT_NICE o root).
+    class Scope
+    {
+    public:
+        Scope(Stage stage, const QString &camera_key);
+        ~Scope();
+
+    private:
+        struct Saved;
+        Saved *saved;
+    };
+
+    static const char *stageName(Stage stage);
+};
@@ -0,0 +1,245 @@
+#include <string.h>
+#include <algorithm>
+#include <QStringList>
+#include <QDebug>
+
+#include "async_io.h"
+#include "track_file.h"
+
+using namespace qtvcr;
+
+TrackFileWriter::TrackFileWriter() :
+    offset(0)
+{
+    memset(&header, 0, sizeof(header));
+}
+
+TrackFileWriter::~TrackFileWriter()
+{
+    if (isOpen())
+    {
+        AsyncIO::instance()->close(path); // sin resumen: los lectores lo tratan como grabación cortada
+    }
+}
+
+bool TrackFileWriter::open(const QString &path, int width, int height, qint64 start_epoch_ms)
+{
+    if (isOpen())
+    {
+        AsyncIO::instance()->close(this->path);
+    }
+    this->path = path;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACK_FILE_MAGIC, sizeof(header.magic));
+    header.version = TRACK_FILE_VERSION;
+    header.header_size = sizeof(TrackFileHeader);
+    header.record_size = sizeof(TrackRecord);
+    header.summary_size = sizeof(TrackSecond);
+    header.width = uint16_t(width);
+    header.height = uint16_t(height);
+    header.start_epoch_ms = start_epoch_ms;
+    AsyncIO::instance()->replace(path, QByteArray(reinterpret_cast<const char *>(&header), sizeof(header)),
+                                 [path](bool ok) {
+                                     if (!ok)
+                                         qWarning() << "No se pudo escribir" << path;
+                                 });
+    offset = sizeof(header);
+
+    seconds.clear();
+    second_tracks.clear();
+    return true;
+}
+
+void TrackFileWriter::add(qint64 t_ms, qint64 frame, const std::vector<Detection> &detections)
+{
+    if (!isOpen() || detections.empty())
+    {
+        return;
+    }
+
+    const size_t second = size_t(t_ms / 1000);
+    if (second >= seconds.size())
+    {
+        TrackSecond empty = {0, 0, 0};
+        seconds.resize(second + 1, empty);
+        second_tracks.clear();
+    }
+    TrackSecond &summary = seconds[second];
+    summary.max_people = std::max<uint16_t>(summary.max_people, uint16_t(detections.size()));
+
+    std::vector<TrackRecord> records(detections.size());
+    for (size_t i = 0; i < detections.size(); i++)
+    {
+        const Detection &d = detections[i];
+        TrackRecord &r = records[i];
+        r.t_ms = uint32_t(t_ms);
+        r.frame = uint32_t(frame);
+        r.track_id = d.track_id;
+        r.x = int16_t(d.box.x);
+        r.y = int16_t(d.box.y);
+        r.width = int16_t(d.box.width);
+        r.height = int16_t(d.box.height);
+        r.score = d.score;
+
+        summary.max_score = std::max(summary.max_score, d.score);
+        if (d.track_id < 0 || std::find(second_tracks.begin(), second_tracks.end(), d.track_id) == second_tracks.end())
+        {
+            summary.tracks++;
+            if (d.track_id >= 0)
+                second_tracks.push_back(d.track_id);
+        }
+    }
+    header.record_count += records.size();
+    const QByteArray bytes(reinterpret_cast<const char *>(records.data()), int(records.size() * sizeof(TrackRecord)));
+    AsyncIO::instance()->write(path, offset, bytes);
+    offset += bytes.size();
+}
+
+void TrackFileWriter::close(qint64 duration_ms)
+{
+    if (!isOpen())
+    {
+        return;
+    }
+
+    // Un resumen por cada segundo de video, aunque los últimos no tengan personas
+    const size_t count = std::max(seconds.size(), size_t((duration_ms + 999) / 1000));
+    TrackSecond empty = {0, 0, 0};
+    seconds.resize(count, empty);
+
+    header.summary_offset = uint64_t(offset);
+    header.summary_count = uint32_t(count);
+    AsyncIO *io = AsyncIO::instance();
+    io->write(path, offset, QByteArray(reinterpret_cast<const char *>(seconds.data()), int(count * sizeof(TrackSecond))));
+    io->write(path, 0, QByteArray(reinterpret_cast<const char *>(&header), sizeof(header)));
+    io->close(path);
+    path.clear();
+}
+
+TrackFile::TrackFile() :
+    data(nullptr), header(nullptr), record_data(nullptr), record_count(0), second_data(nullptr), second_count(0)
+{
+}
+
+TrackFile::~TrackFile()
+{
+    close();
+}
+
+bool TrackFile::open(const QString &path)
+{
+    close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < qint64(sizeof(TrackFileHeader)))
+    {
+        file.close();
+        return false;
+    }
+    data = file.map(0, file.size());
+    if (data == nullptr)
+    {
+        file.close();
+        return false;
+    }
+
+    const TrackFileHeader *h = reinterpret_cast<const TrackFileHeader *>(data);
+    const quint64 size = quint64(file.size());
+    if (memcmp(h->magic, TRACK_FILE_MAGIC, sizeof(h->magic)) != 0 || h->version != TRACK_FILE_VERSION ||
+        h->header_size < sizeof(TrackFileHeader) || h->header_size > size || h->record_size != sizeof(TrackRecord) ||
+        h->summary_size != sizeof(TrackSecond))
+    {
+        close();
+        return false;
+    }
+
+    // Los conteos vienen del archivo: se comparan sin multiplicar para que no desborden
+    const quint64 max_records = (size - h->header_size) / sizeof(TrackRecord);
+    if (h->summary_offset != 0 && h->summary_offset <= size && h->record_count <= max_records &&
+        quint64(h->summary_count) <= (size - h->summary_offset) / sizeof(TrackSecond) &&
+        h->header_size + h->record_count * sizeof(TrackRecord) <= h->summary_offset)
+    {
+        record_count = size_t(h->record_count);
+        second_data = reinterpret_cast<const TrackSecond *>(data + h->summary_offset);
+        second_count = h->summary_count;
+    }
+    else
+    {
+        // Grabación cortada: los registros completos que hayan llegado al disco
+        record_count = size_t(max_records);
+    }
+    record_data = reinterpret_cast<const TrackRecord *>(data + h->header_size);
+    header = h;
+    return true;
+}
+
+void TrackFile::close()
+{
+    if (data != nullptr)
+    {
+        file.unmap(data);
+        data = nullptr;
+    }
+    file.close();
+    header = nullptr;
+    record_data = nullptr;
+    record_count = 0;
+    second_data = nullptr;
+    second_count = 0;
+}
+
+bool TrackFile::isComplete() const
+{
+    return second_data != nullptr;
+}
+
+std::vector<int> TrackFile::secondsWithPeople() const
+{
+    std::vector<int> result;
+    if (second_data != nullptr)
+    {
+        for (size_t s = 0; s < second_count; s++)
+        {
+            if (second_data[s].max_people > 0)
+                result.push_back(int(s));
+        }
+        return result;
+    }
+
+    // Los registros están ordenados por tiempo
+    for (size_t i = 0; i < record_count; i++)
+    {
+        int s = int(record_data[i].t_ms / 1000);
+        if (result.empty() || result.back() != s)
+            result.push_back(s);
+    }
+    return result;
+}
+
+QString TrackFile::describe(const QString &path)
+{
+    TrackFile track;
+    if (!track.open(path))
+    {
+        return QString();
+    }
+    std::vector<int> people = track.secondsWithPeople();
+    if (people.empty())
+    {
+        return QString("Sin personas");
+    }
+
+    auto clock = [](int s) { return QString("%1:%2").arg(s / 60).arg(s % 60, 2, 10, QChar('0')); };
+    QStringList ranges;
+    size_t start = 0;
+    for (size_t i = 1; i <= people.size(); i++)
+    {
+        if (i == people.size() || people[i] != people[i - 1] + 1)
+        {
+            ranges << (i - 1 == start ? clock(people[start])
+                                      : clock(people[start]) + "-" + clock(people[i - 1]));
+            start = i;
+        }
+    }
+    return "Personas: " + ranges.join(", ");
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <QString>
+#include <QFile>
+
+#include "detector.h"
+
+// Sidecar <nombre>.trk con las detecciones de una grabación.
+//
+//   [TrackFileHeader 64 B][TrackRecord 24 B] x record_count [TrackSecond 8 B] x summary_count
+//
+// Un registro por caja detectada (tiempo dentro del video, frame, pista, caja
+// en coordenadas del frame y score) y un resumen por segundo de video para
+// saber sin recorrer los registros en qué segundos hubo personas. Todo es de
+// tamaño fijo y little-endian: se lee mapeando el archivo, sin parsear.
+//
+// Los registros se agregan mientras se graba; el resumen y los totales del
+// encabezado se escriben al cerrar. Si el proceso murió antes (summary_offset
+// == 0) la cantidad de registros sale del tamaño del archivo y no hay resumen.
+
+namespace qtvcr {
+
+const char TRACK_FILE_MAGIC[8] = {'Q', 'V', 'C', 'R', 'T', 'R', 'K', '\0'};
+const uint32_t TRACK_FILE_VERSION = 1;
+
+struct TrackFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t record_size;
+    uint32_t summary_size;
+    uint64_t record_count;   // 0 mientras se graba
+    uint64_t summary_offset; // 0 mientras se graba
+    uint32_t summary_count;  // segundos de video
+    uint16_t width;          // tamaño del frame al que se refieren las cajas
+    uint16_t height;
+    int64_t start_epoch_ms;  // hora del primer frame
+    uint32_t reserved[2];
+};
+
+struct TrackRecord
+{
+    uint32_t t_ms;     // desde el comienzo del video
+    uint32_t frame;
+    int32_t track_id;  // -1 = sin seguimiento
+    int16_t x, y, width, height;
+    float score;
+};
+
+struct TrackSecond
+{
+    uint16_t max_people; // máximo de cajas en un mismo frame
+    uint16_t tracks;     // pistas distintas vistas en el segundo
+    float max_score;
+};
+
+static_assert(sizeof(TrackFileHeader) == 64, "TrackFileHeader cambió de tamaño");
+static_assert(sizeof(TrackRecord) == 24, "TrackRecord cambió de tamaño");
+static_assert(sizeof(TrackSecond) == 8, "TrackSecond cambió de tamaño");
+
+} // namespace qtvcr
+
+// Las escrituras van por AsyncIO: ninguna bloquea el hilo de captura
+class TrackFileWriter
+{
+public:
+    TrackFileWriter();
+    ~TrackFileWriter();
+
+    bool open(const QString &path, int width, int height, qint64 start_epoch_ms);
+    bool isOpen() const { return !path.isEmpty(); }
+
+    void add(qint64 t_ms, qint64 frame, const std::vector<Detection> &detections);
+
+    // Escribe el resumen por segundo y completa el encabezado. duration_ms: largo del video.
+    void close(qint64 duration_ms);
+
+private:
+    QString path;
+    qint64 offset; // próximo registro
+    qtvcr::TrackFileHeader header;
+    std::vector<qtvcr::TrackSecond> seconds;
+    std::vector<int> second_tracks; // pistas ya contadas en el último segundo
+};
+
+class TrackFile
+{
+public:
+    TrackFile();
+    ~TrackFile();
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    // false si la grabación no se cerró bien (no hay resumen)
+    bool isComplete() const;
+
+    const qtvcr::TrackFileHeader &info() const { return *header; }
+    const qtvcr::TrackRecord *records() const { return record_data; }
+    size_t recordCount() const { return record_count; }
+    const qtvcr::TrackSecond *seconds() const { return second_data; }
+    size_t secondCount() const { return second_count; }
+
+    // Segundos con al menos una persona (del resumen, o de los registros si no hay)
+    std::vector<int> secondsWithPeople() const;
+
+    // Texto corto para la lista de videos, ej. "Personas: 0:12-0:20, 1:03"
+    static QString describe(const QString &path);
+
+private:
+    QFile file;
+    uchar *data;
+    const qtvcr::TrackFileHeader *header;
+    const qtvcr::TrackRecord *record_data;
+    size_t record_count;
+    const qtvcr::TrackSecond *second_data;
+    size_t second_count;
+};
@@ -93,6 +93,25 @@ QString Utilities::getParam(const QString param)
     qDebug() << "JSON de Entrada: " << jsonString;
     return parser.getParam(jsonString, param);
 }
+int Utilities::getParamInt(const QString param, int defaultValue)
+{
+    // Devuelve defaultValue si el parámetro no existe o no es un número.
+    bool ok = false;
+    int value = getParam(param).toInt(&ok);
+    return ok ? value : defaultValue;
+}
+double Utilities::getParamDouble(const QString param, double defaultValue)
+{
+    bool ok = false;
+    double value = getParam(param).toDouble(&ok);
+    return ok ? value : defaultValue;
+}
+QJsonValue Utilities::getParamValue(const QString param)
+{
+    JsonParser parser;
+    QString jsonString = fileToString("config.cfg").replace("\n", "");
+    return parser.getValue(jsonString, param);
+}
 int Utilities::getParamCount()
 {
     JsonParser parser;
@@ -104,3 +123,14 @@ int Utilities::getParamCount()
     qDebug() << "JSON de Entrada: " << jsonString;
     return parser.getParamCount(jsonString);
 }
+
+// Cámara de este proceso: "source=camX" como primer argumento o "current" en config.cfg
+QString Utilities::currentCameraKey()
+{
+    QStringList args = QCoreApplication::arguments();
+    if (args.size() > 1 && args[1].startsWith("source="))
+    {
+        return args[1].mid(7);
+    }
+    return getParam("current");
+}
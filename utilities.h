@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QString>
+#include <QJsonValue>
 
 class Utilities
 {
@@ -11,5 +12,9 @@ class Utilities
     static QString fileToString(const QString &rutaArchivo);
     static void ejemploUso();
     static QString getParam(const QString param);
+    static int getParamInt(const QString param, int defaultValue);
+    static double getParamDouble(const QString param, double defaultValue);
+    static QJsonValue getParamValue(const QString param);
     static int getParamCount();
+    static QString currentCameraKey();
 };
@@ -0,0 +1,317 @@
+#include <iterator>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QDebug>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+#include "utilities.h"
+#include "metrics.h"
+#include "video_player.h"
+
+namespace {
+// Frames que quedan en la caché con el presupuesto de memoria bajo presión
+const int MIN_CACHE_FRAMES = 8;
+}
+
+VideoPlayer::VideoPlayer(QObject *parent) :
+    QThread(parent), frame_count(0), frame_rate(30), width(960), cache_frames(90), format(nullptr), codec(nullptr), decoded(nullptr),
+    packet(nullptr), scaler(nullptr), stream(-1), decoder_frame(-1), draining(false), focus(0),
+    memory("reproductor.cache", MemoryBudget::CACHE), stopping(false), target_pending(false), target(0), direction(0), playhead(0)
+{
+}
+
+VideoPlayer::~VideoPlayer()
+{
+    close();
+}
+
+void VideoPlayer::open(const QString &name, int width)
+{
+    close();
+    this->name = name;
+    path = Utilities::getSavedVideoPath(name, "mp4");
+    this->width = width;
+    cache_frames = qMax(8, Utilities::getParamInt("reproductor_cache_frames", 90));
+
+    stopping = false;
+    target_pending = true;
+    target = 0;
+    direction = 0;
+    playhead = 0;
+    start();
+}
+
+void VideoPlayer::close()
+{
+    {
+        QMutexLocker locker(&lock);
+        stopping = true;
+        wake.wakeAll();
+    }
+    wait();
+}
+
+void VideoPlayer::seek(int64_t frame)
+{
+    QMutexLocker locker(&lock);
+    target = qBound<int64_t>(0, frame, qMax<int64_t>(0, frameCount() - 1));
+    target_pending = true;
+    wake.wakeAll();
+}
+
+void VideoPlayer::play(int direction)
+{
+    QMutexLocker locker(&lock);
+    this->direction = direction;
+    wake.wakeAll();
+}
+
+void VideoPlayer::pause()
+{
+    QMutexLocker locker(&lock);
+    direction = 0;
+    wake.wakeAll();
+}
+
+void VideoPlayer::step(int delta)
+{
+    QMutexLocker locker(&lock);
+    direction = 0;
+    target = qBound<int64_t>(0, (target_pending ? target : playhead) + delta, qMax<int64_t>(0, frameCount() - 1));
+    target_pending = true;
+    wake.wakeAll();
+}
+
+void VideoPlayer::run()
+{
+    // Generar el índice recorre todo el archivo: va acá y no en la GUI
+    if (!index.loadOrBuild(name))
+    {
+        emit failed("No se pudo abrir " + name);
+        return;
+    }
+    frame_count = index.frameCount();
+    frame_rate = index.fps();
+    if (!openDecoder())
+    {
+        closeDecoder();
+        emit failed("No se pudo abrir " + path);
+        return;
+    }
+    emit opened(frame_count.load(), frame_rate.load());
+
+    const int frame_ms = qMax(1, int(1000 / index.fps()));
+    QElapsedTimer clock;
+    clock.start();
+    QMutexLocker locker(&lock);
+    while (!stopping)
+    {
+        int64_t want;
+        if (target_pending)
+        {
+            want = target;
+            target_pending = false;
+        }
+        else if (direction != 0)
+        {
+            // Reproducción: un frame cada 1/fps, para los dos lados
+            const qint64 remaining = frame_ms - clock.elapsed();
+            if (remaining > 0)
+            {
+                wake.wait(&lock, remaining);
+                continue;
+            }
+            want = playhead + direction;
+            if (want < 0 || want >= index.frameCount())
+            {
+                direction = 0;
+                continue;
+            }
+        }
+        else
+        {
+            // Quieto: se adelanta la decodificación mientras no haya pedidos
+            locker.unlock();
+            bool more = prefetch();
+            locker.relock();
+            if (!more && !stopping && !target_pending && direction == 0)
+                wake.wait(&lock);
+            continue;
+        }
+
+        playhead = want;
+        locker.unlock();
+        clock.restart();
+        show(want);
+        locker.relock();
+    }
+    locker.unlock();
+    closeDecoder();
+}
+
+bool VideoPlayer::openDecoder()
+{
+    if (avformat_open_input(&format, path.toUtf8().constData(), nullptr, nullptr) < 0 ||
+        avformat_find_stream_info(format, nullptr) < 0)
+    {
+        return false;
+    }
+    stream = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (stream < 0)
+    {
+        return false;
+    }
+    const AVCodecParameters *parameters = format->streams[stream]->codecpar;
+    const AVCodec *decoder = avcodec_find_decoder(parameters->codec_id);
+    if (decoder == nullptr)
+    {
+        return false;
+    }
+    codec = avcodec_alloc_context3(decoder);
+    avcodec_parameters_to_context(codec, parameters);
+    codec->thread_count = 0; // automático: el decodificado es el cuello de botella de los seeks
+    if (avcodec_open2(codec, decoder, nullptr) < 0)
+    {
+        return false;
+    }
+    decoded = av_frame_alloc();
+    packet = av_packet_alloc();
+    decoder_frame = -1;
+    draining = false;
+    return true;
+}
+
+void VideoPlayer::closeDecoder()
+{
+    sws_freeContext(scaler);
+    scaler = nullptr;
+    av_packet_free(&packet);
+    av_frame_free(&decoded);
+    avcodec_free_context(&codec);
+    avformat_close_input(&format);
+    cache.clear();
+    memory.release(memory.used());
+}
+
+void VideoPlayer::show(int64_t frame)
+{
+    focus = frame;
+    auto it = cache.find(frame);
+    if (it == cache.end())
+    {
+        decodeTo(frame);
+        // Si el contenedor saltea números de frame se muestra el anterior más cercano
+        it = cache.upper_bound(frame);
+        if (it == cache.begin())
+            return;
+        --it;
+    }
+    emit frameReady(it->second, qint64(frame));
+}
+
+void VideoPlayer::decodeTo(int64_t frame)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Dentro del mismo GOP y hacia adelante se sigue decodificando; si no, seek al keyframe
+    const qtvcr::KeyframeIndexEntry &keyframe = index.keyframeFor(frame);
+    if (decoder_frame < 0 || frame <= decoder_frame || int64_t(keyframe.frame) > decoder_frame + 1)
+    {
+        av_seek_frame(format, stream, keyframe.timestamp, AVSEEK_FLAG_BACKWARD);
+        avcodec_flush_buffers(codec);
+        decoder_frame = -1;
+        draining = false;
+    }
+    while (decoder_frame < frame)
+    {
+        if (!decodeNext())
+            break;
+    }
+    Metrics::set("reproductor.busqueda_ms", double(timer.elapsed()));
+}
+
+// Decodifica el próximo frame y lo guarda en la caché. false al final del archivo.
+bool VideoPlayer::decodeNext()
+{
+    while (true)
+    {
+        int r = avcodec_receive_frame(codec, decoded);
+        if (r == 0)
+        {
+            const int64_t pts = decoded->best_effort_timestamp;
+            decoder_frame = pts == AV_NOPTS_VALUE ? decoder_frame + 1 : index.frameOfPts(pts);
+            remember(decoder_frame);
+            av_frame_unref(decoded);
+            return true;
+        }
+        if (r != AVERROR(EAGAIN) || draining)
+        {
+            return false;
+        }
+
+        if (av_read_frame(format, packet) < 0)
+        {
+            // Fin del archivo: se vacían los frames que el decodificador tenga retenidos
+            avcodec_send_packet(codec, nullptr);
+            draining = true;
+            continue;
+        }
+        if (packet->stream_index == stream)
+        {
+            avcodec_send_packet(codec, packet);
+        }
+        av_packet_unref(packet);
+    }
+}
+
+// Un frame más hacia adelante si el decodificador está justo después de la posición actual
+bool VideoPlayer::prefetch()
+{
+    if (decoder_frame < focus || decoder_frame >= focus + cache_frames / 3 ||
+        decoder_frame + 1 >= index.frameCount())
+    {
+        return false;
+    }
+    return decodeNext();
+}
+
+void VideoPlayer::remember(int64_t frame)
+{
+    const int src_width = decoded->width;
+    const int src_height = decoded->height;
+    const int out_width = qMin(width, src_width) & ~1;
+    const int out_height = int(int64_t(src_height) * out_width / qMax(1, src_width)) & ~1;
+    scaler = sws_getCachedContext(scaler, src_width, src_height, AVPixelFormat(decoded->format),
+                                  out_width, out_height, AV_PIX_FMT_RGB24, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (scaler == nullptr)
+    {
+        return;
+    }
+    QImage image(out_width, out_height, QImage::Format_RGB888);
+    uint8_t *dst[1] = {image.bits()};
+    int dst_stride[1] = {int(image.bytesPerLine())};
+    sws_scale(scaler, decoded->data, decoded->linesize, 0, src_height, dst, dst_stride);
+    auto previous = cache.find(frame);
+    if (previous != cache.end())
+        memory.release(previous->second.sizeInBytes());
+    memory.charge(image.sizeInBytes());
+    cache[frame] = image;
+
+    // Se descarta lo más lejano a la posición pedida. Con el presupuesto de
+    // memoria bajo presión la caché se reduce a lo mínimo.
+    const int limit = MemoryBudget::underPressure() ? qMin(cache_frames, MIN_CACHE_FRAMES) : cache_frames;
+    while (int(cache.size()) > limit)
+    {
+        auto first = cache.begin();
+        auto last = std::prev(cache.end());
+        auto farthest = focus - first->first > last->first - focus ? first : last;
+        memory.release(farthest->second.sizeInBytes());
+        cache.erase(farthest);
+    }
+}
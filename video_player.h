@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <atomic>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QImage>
+
+#include "keyframe_index.h"
+#include "memory_budget.h"
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+// Decodifica una grabación en su propio hilo para el reproductor.
+//
+// Para ir a un frame se busca en el índice de keyframes (.kfi) el keyframe
+// anterior y se decodifica desde ahí; todos los frames del camino quedan en
+// una caché chica alrededor de la posición actual, así que retroceder o ir
+// frame a frame dentro del mismo GOP no decodifica nada. Con el reproductor
+// quieto se siguen decodificando unos frames hacia adelante.
+//
+// Los pedidos (seek, play, step) solo guardan el destino: si llegan varios
+// mientras se decodifica (arrastrar la barra) se atiende el último.
+//
+// El índice se lee (o se genera, si falta) en el hilo del reproductor: la
+// GUI no se traba con grabaciones largas. Cuando está listo se emite opened();
+// antes de eso frameCount() es 0.
+class VideoPlayer : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit VideoPlayer(QObject *parent = nullptr);
+    ~VideoPlayer();
+
+    // Arranca el hilo, que carga (o genera) el índice y emite opened() o
+    // failed(). width: ancho de los frames entregados.
+    void open(const QString &name, int width);
+    void close();
+
+    void seek(int64_t frame);
+    void play(int direction); // 1 adelante, -1 hacia atrás
+    void pause();
+    void step(int delta);
+
+    int64_t frameCount() const { return frame_count.load(); }
+    double fps() const { return frame_rate.load(); }
+
+signals:
+    void opened(qint64 frame_count, double fps);
+    void frameReady(QImage image, qint64 frame);
+    void failed(QString message);
+
+protected:
+    void run() override;
+
+private:
+    bool openDecoder();
+    void closeDecoder();
+    void show(int64_t frame);
+    void decodeTo(int64_t frame);
+    bool decodeNext();
+    bool prefetch();
+    void remember(int64_t frame);
+
+    QString name;
+    QString path;
+    KeyframeIndex index; // solo desde el hilo
+    std::atomic<int64_t> frame_count;
+    std::atomic<double> frame_rate;
+    int width;
+    int cache_frames;
+
+    // Decodificador: solo se usa desde el hilo
+    AVFormatContext *format;
+    AVCodecContext *codec;
+    AVFrame *decoded;
+    AVPacket *packet;
+    SwsContext *scaler;
+    int stream;
+    int64_t decoder_frame; // último frame decodificado; -1 después de un seek
+    bool draining;
+    int64_t focus;         // frame pedido: la caché descarta lo más lejano
+    std::map<int64_t, QImage> cache;
+    MemoryBudget::Account memory; // la caché, en el presupuesto de memoria
+
+    // Pedidos desde la GUI
+    QMutex lock;
+    QWaitCondition wake;
+    bool stopping;
+    bool target_pending;
+    int64_t target;
+    int direction;
+    int64_t playhead;
+};
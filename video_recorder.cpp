@@ -0,0 +1,400 @@
+#include <errno.h>
+#include <signal.h>
+#include <QtConcurrent>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QDebug>
+
+#include "utilities.h"
+#include "metrics.h"
+#include "async_io.h"
+#include "keyframe_index.h"
+#include "video_recorder.h"
+
+namespace {
+// Muestra para comparar frames en modo VFR: un píxel cada SAMPLE_STEP en x e y
+const int SAMPLE_STEP = 16;
+// Diferencia de brillo (0-255) para contar una muestra como cambiada
+const int SAMPLE_THRESHOLD = 16;
+
+// nullptr si no se pudo abrir (no queda ningún archivo)
+LibavWriter *createWriter(const QString &path, const LibavWriter::Options &options)
+{
+    LibavWriter *writer = new LibavWriter();
+    if (!writer->open(path, options))
+    {
+        qWarning() << "No se pudo abrir el encoder para" << path;
+        delete writer;
+        QFile::remove(path);
+        return nullptr;
+    }
+    return writer;
+}
+
+bool sameOptions(const LibavWriter::Options &a, const LibavWriter::Options &b)
+{
+    return a.fps == b.fps && a.size == b.size && a.gop == b.gop && a.preset == b.preset && a.crf == b.crf &&
+           a.fragment_ms == b.fragment_ms;
+}
+}
+
+VideoRecorder::VideoRecorder(QObject *parent) :
+    QObject(parent), fps(30), merge_gap_ms(0), vfr(false), vfr_threshold(0), vfr_max_gap_ms(1000),
+    last_encoded_ms(0), skipped_ms(0), frames_encoded(0), writer(nullptr), writing(false),
+    frames_written(0), event_count(0), spare_seq(0)
+{
+    spare_requested = false;
+}
+
+VideoRecorder::~VideoRecorder()
+{
+    shutdown();
+}
+
+void VideoRecorder::configure(double fps, cv::Size size, int merge_gap_ms)
+{
+    this->fps = fps > 0 ? fps : 30;
+    this->frame_size = size;
+    this->merge_gap_ms = merge_gap_ms;
+
+    // Un keyframe por segundo (grabacion_gop, en frames) para que el reproductor
+    // vaya a cualquier punto decodificando pocos frames. Es una opción de cada
+    // writer: las cámaras de un mismo proceso no se pisan (<cam>.grabacion_gop
+    // tiene prioridad sobre la global).
+    writer_options.camera_key = Utilities::currentCameraKey();
+    writer_options.fps = this->fps;
+    writer_options.size = size;
+    const QString camera_gop = Utilities::getParam(writer_options.camera_key + ".grabacion_gop");
+    writer_options.gop = qMax(1, camera_gop.isEmpty() ? Utilities::getParamInt("grabacion_gop", qRound(this->fps))
+                                                      : camera_gop.toInt());
+    writer_options.preset = Utilities::getParam("grabacion_preset");
+    if (writer_options.preset.isEmpty())
+        writer_options.preset = "veryfast";
+    writer_options.crf = Utilities::getParamInt("grabacion_crf", 23);
+    writer_options.storage = StorageFile::optionsFromConfig();
+    writer_options.fragment_ms = qMax(0, Utilities::getParamInt("grabacion_fragmento_s", 2)) * 1000;
+
+    vfr = Utilities::getParam("grabacion_vfr") == QString("true");
+    vfr_threshold = Utilities::getParamDouble("grabacion_vfr_umbral", 0.005);
+    vfr_max_gap_ms = Utilities::getParamInt("grabacion_vfr_max_ms", 1000);
+
+    sprites.configure(Utilities::getParamInt("miniatura_ancho", 256),
+                      Utilities::getParamInt("miniatura_intervalo_s", 2) * 1000);
+}
+
+void VideoRecorder::removeStaleSpares()
+{
+    QDir dir(Utilities::getDataPath());
+    const QStringList filters = QStringList() << ".spare-*.mp4.tmp" << ".spare-*.mp4";
+    foreach (const QFileInfo &file, dir.entryInfoList(filters, QDir::Files | QDir::Hidden))
+    {
+        // Los de un proceso vivo (trabajador de otra cámara) se dejan
+        const qint64 pid = file.fileName().section('-', 1, 1).toLongLong();
+        if (pid > 0 && (::kill(pid_t(pid), 0) == 0 || errno == EPERM))
+            continue;
+        if (QFile::remove(file.absoluteFilePath()))
+            qDebug() << "Encoder de repuesto abandonado borrado:" << file.fileName();
+    }
+}
+
+bool VideoRecorder::beginEvent(cv::Mat &firstFrame)
+{
+    if (writer != nullptr)
+    {
+        if (!writing)
+        {
+            // El archivo sigue abierto dentro del intervalo de unión: se continúa en él.
+            writing = true;
+            event_count++;
+            addMarker("inicio");
+            qDebug() << "Evento unido a la grabación" << name << "(evento" << event_count << ")";
+        }
+        return true;
+    }
+
+    name = Utilities::newSavedVideoName();
+
+    QString path = Utilities::getSavedVideoPath(name, "mp4");
+    writer = takeSpare(path);
+    if (writer == nullptr)
+    {
+        writer = createWriter(path, writer_options);
+    }
+    if (writer == nullptr)
+    {
+        Metrics::add("grabacion.errores_escritura", 1);
+        return false;
+    }
+    last_samples.clear(); // el primer frame del archivo siempre se codifica
+    skipped_frame.release();
+    frames_encoded = 0;
+
+    if (!tracks.open(Utilities::getSavedVideoPath(name, "trk"), frame_size.width, frame_size.height,
+                     QDateTime::currentMSecsSinceEpoch()))
+    {
+        qWarning() << "No se pudo crear el archivo de detecciones de" << name;
+    }
+
+    // La portada es la primera miniatura; las demás se toman en write()
+    sprites.reset();
+    sprites.add(firstFrame, 0);
+
+    writing = true;
+    frames_written = 0;
+    event_count = 1;
+    markers.clear();
+    addMarker("inicio");
+    return true;
+}
+
+bool VideoRecorder::write(cv::Mat &frame)
+{
+    if (writer == nullptr || !writing)
+    {
+        return true;
+    }
+    const qint64 t_ms = qint64(frames_written * 1000.0 / fps);
+    sprites.add(frame, t_ms);
+    frames_written++;
+
+    if (vfr && !changedEnough(frame, t_ms))
+    {
+        // Referencia, sin copia: la captura arma un buffer nuevo en cada frame
+        skipped_frame = frame;
+        skipped_ms = t_ms;
+        Metrics::add("grabacion.frames_omitidos", 1);
+        return true;
+    }
+    skipped_frame.release();
+    if (!writer->write(frame, t_ms))
+    {
+        return writeFailed(frame);
+    }
+    frames_encoded++;
+    return true;
+}
+
+// El encoder o el disco fallaron: se cierra el archivo (lo ya escrito se puede
+// ver) y se sigue en uno nuevo desde este frame. Si tampoco se puede escribir
+// el primer frame del archivo nuevo, la grabación se detiene y devuelve false.
+bool VideoRecorder::writeFailed(cv::Mat &frame)
+{
+    const bool fresh = frames_encoded == 0;
+    qWarning() << "Error escribiendo la grabación" << name << (fresh ? "- se detiene" : "- se sigue en un archivo nuevo");
+    Metrics::add("grabacion.errores_escritura", 1);
+    writing = false;
+    finalize();
+    return !fresh && beginEvent(frame) && write(frame);
+}
+
+// Puntaje de cambio barato: fracción de muestras cuyo brillo cambió respecto
+// del último frame codificado. Solo toca 1 de cada SAMPLE_STEP² píxeles.
+bool VideoRecorder::changedEnough(const cv::Mat &frame, qint64 t_ms)
+{
+    samples.clear();
+    for (int y = SAMPLE_STEP / 2; y < frame.rows; y += SAMPLE_STEP)
+    {
+        const uchar *row = frame.ptr<uchar>(y);
+        for (int x = SAMPLE_STEP / 2; x < frame.cols; x += SAMPLE_STEP)
+        {
+            const uchar *p = row + x * 3;
+            samples.push_back(uint8_t((p[0] + 2 * p[1] + p[2]) >> 2));
+        }
+    }
+
+    bool changed = samples.size() != last_samples.size() || t_ms - last_encoded_ms >= vfr_max_gap_ms;
+    if (!changed)
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            if (std::abs(int(samples[i]) - int(last_samples[i])) > SAMPLE_THRESHOLD)
+                count++;
+        }
+        changed = count > vfr_threshold * samples.size();
+    }
+    if (changed)
+    {
+        last_samples.swap(samples);
+        last_encoded_ms = t_ms;
+    }
+    return changed;
+}
+
+void VideoRecorder::addDetections(const std::vector<Detection> &detections)
+{
+    if (writer == nullptr || !writing)
+    {
+        return;
+    }
+    tracks.add(qint64(frames_written * 1000.0 / fps), frames_written, detections);
+}
+
+void VideoRecorder::endEvent()
+{
+    if (!writing)
+    {
+        return;
+    }
+    writing = false;
+    addMarker("fin");
+
+    if (merge_gap_ms <= 0)
+    {
+        finalize();
+    }
+    else
+    {
+        gap_timer.start();
+    }
+}
+
+void VideoRecorder::poll()
+{
+    if (writer != nullptr && !writing && gap_timer.elapsed() > merge_gap_ms)
+    {
+        finalize();
+    }
+    prepareSpare();
+}
+
+void VideoRecorder::shutdown()
+{
+    if (writer != nullptr)
+    {
+        writing = false;
+        finalize();
+    }
+    if (spare_requested)
+    {
+        LibavWriter *spare = spare_future.result();
+        spare_requested = false;
+        if (spare != nullptr)
+        {
+            spare->release();
+            delete spare;
+        }
+        QFile::remove(spare_path);
+    }
+    foreach (QFuture<void> future, saving)
+    {
+        future.waitForFinished();
+    }
+    saving.clear();
+}
+
+void VideoRecorder::finalize()
+{
+    // Si el final fue estático, el último frame fija la duración del video
+    if (!skipped_frame.empty())
+    {
+        if (writer->write(skipped_frame, skipped_ms))
+        {
+            frames_encoded++;
+        }
+        else
+        {
+            qWarning() << "Error escribiendo el último frame de" << name;
+            Metrics::add("grabacion.errores_escritura", 1);
+        }
+        skipped_frame.release();
+    }
+    QElapsedTimer close_timer;
+    close_timer.start();
+    writer->release();
+    Metrics::set("grabacion.cierre_ms", double(close_timer.elapsed()));
+    delete writer;
+    writer = nullptr;
+    tracks.close(qint64(frames_written * 1000.0 / fps));
+    sprites.save(name);
+
+    const QString events_path = Utilities::getSavedVideoPath(name, "evt");
+    if (event_count > 0)
+    {
+        AsyncIO::instance()->replace(events_path, (markers.join("\n") + "\n").toUtf8());
+        AsyncIO::instance()->close(events_path);
+    }
+
+    qDebug() << "saved_video_name: " << name << "eventos:" << event_count
+             << "frames:" << frames_written << "codificados:" << frames_encoded;
+
+    // El aviso sale cuando los archivos auxiliares ya están en disco (AsyncIO), y
+    // después se arma el índice de keyframes; en segundo plano para no frenar la captura
+    for (int i = saving.size() - 1; i >= 0; i--)
+    {
+        if (saving[i].isFinished())
+            saving.removeAt(i);
+    }
+    QString saved = name;
+    QStringList sidecars;
+    sidecars << Utilities::getSavedVideoPath(name, "trk") << Utilities::getSavedVideoPath(name, "miniaturas.jpg")
+             << Utilities::getSavedVideoPath(name, "miniaturas.json") << Utilities::getSavedVideoPath(name, "portada.jpg")
+             << events_path;
+    saving << QtConcurrent::run([this, saved, sidecars]() {
+        AsyncIO::instance()->waitFor(sidecars);
+        emit videoSaved(saved);
+        KeyframeIndex index;
+        index.loadOrBuild(saved);
+    });
+}
+
+void VideoRecorder::addMarker(const char *type)
+{
+    qint64 t_ms = qint64(frames_written * 1000.0 / fps);
+    markers << QString("{\"evento\":\"%1\",\"t_ms\":%2,\"hora\":\"%3\"}")
+               .arg(type)
+               .arg(t_ms)
+               .arg(QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss.zzz"));
+}
+
+// Abre en segundo plano un LibavWriter con nombre temporal para tener el
+// encoder listo antes de que empiece el próximo evento.
+void VideoRecorder::prepareSpare()
+{
+    if (spare_requested || frame_size.area() == 0)
+    {
+        return;
+    }
+
+    // Con otra extensión que las grabaciones: no aparece en la lista ni en el archivado
+    spare_path = Utilities::getSavedVideoPath(
+        QString(".spare-%1-%2").arg(QCoreApplication::applicationPid()).arg(spare_seq++), "mp4.tmp");
+    spare_options = writer_options;
+
+    QString path = spare_path;
+    LibavWriter::Options options = writer_options;
+    spare_future = QtConcurrent::run([path, options]() {
+        return createWriter(path, options);
+    });
+    spare_requested = true;
+}
+
+// Devuelve el encoder de repuesto renombrado a "path", o nullptr si todavía
+// no está listo o no sirve (se abrió con otros FPS o tamaño).
+LibavWriter *VideoRecorder::takeSpare(const QString &path)
+{
+    if (!spare_requested || !spare_future.isFinished())
+    {
+        return nullptr;
+    }
+
+    LibavWriter *spare = spare_future.result();
+    spare_requested = false;
+    if (spare == nullptr)
+    {
+        return nullptr;
+    }
+
+    // El writer mantiene el descriptor abierto, así que se puede renombrar el archivo.
+    if (spare->isOpened() && sameOptions(spare_options, writer_options) && QFile::rename(spare_path, path))
+    {
+        return spare;
+    }
+
+    spare->release();
+    delete spare;
+    QFile::remove(spare_path);
+    return nullptr;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QList>
+#include "opencv2/opencv.hpp"
+
+#include "detector.h"
+#include "libav_writer.h"
+#include "track_file.h"
+#include "sprite_sheet.h"
+
+// Administra el encoder (LibavWriter) de las grabaciones de un CaptureThread.
+//
+// - Une eventos: cuando un evento termina, el archivo queda abierto durante
+//   "union_ms". Si otro evento empieza antes de que expire, se sigue
+//   escribiendo en el mismo archivo y se agrega una marca de evento.
+// - Encoder en caliente: mantiene un LibavWriter de repuesto ya abierto
+//   (x264 inicializado) para que el próximo evento no pague la inicialización.
+// - Tiempos variables (grabacion_vfr): los frames que casi no cambian respecto
+//   del último codificado no se codifican; el anterior queda en pantalla hasta
+//   el siguiente. Cada grabacion_vfr_max_ms se codifica uno igual.
+// - mp4 fragmentado (grabacion_fragmento_s, 0 = mp4 normal): si el proceso
+//   muere o se corta la luz la grabación se puede ver hasta el último
+//   fragmento, y cerrar no depende del largo del evento (grabacion.cierre_ms).
+//
+// Las marcas se guardan en <nombre>.evt (una línea JSON por evento). Las cajas
+// detectadas van a <nombre>.trk (ver track_file.h) y las miniaturas para la
+// vista previa a <nombre>.miniaturas.jpg (ver sprite_sheet.h). Todos se
+// escriben con AsyncIO: el hilo de captura solo toca el disco con el video.
+class VideoRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit VideoRecorder(QObject *parent = nullptr);
+    ~VideoRecorder();
+
+    void configure(double fps, cv::Size size, int merge_gap_ms);
+
+    // Borra los encoders de repuesto (.spare-<pid>-<n>.mp4.tmp) que dejó un
+    // proceso que ya no existe. Se llama al arrancar.
+    static void removeStaleSpares();
+
+    // false si no se pudo abrir el archivo o la grabación se detuvo por errores
+    // de escritura: quien llama la da por terminada (se puede volver a empezar)
+    bool beginEvent(cv::Mat &firstFrame);
+    bool write(cv::Mat &frame);
+    // Detecciones del próximo frame a escribir (llamar antes de write)
+    void addDetections(const std::vector<Detection> &detections);
+    void endEvent();
+
+    // Debe llamarse en cada vuelta del bucle de captura: cierra el archivo
+    // cuando vence el intervalo de unión y prepara el encoder de repuesto.
+    void poll();
+
+    // Cierra todo inmediatamente (al terminar el hilo de captura).
+    void shutdown();
+
+    bool isWriting() const { return writing; }
+
+signals:
+    void videoSaved(QString name);
+
+private:
+    void finalize();
+    bool writeFailed(cv::Mat &frame);
+    void prepareSpare();
+    LibavWriter *takeSpare(const QString &path);
+    void addMarker(const char *type);
+    bool changedEnough(const cv::Mat &frame, qint64 t_ms);
+
+    double fps;
+    cv::Size frame_size;
+    int merge_gap_ms;
+    LibavWriter::Options writer_options;
+
+    // Tiempos variables: muestra de píxeles del último frame codificado
+    bool vfr;
+    double vfr_threshold;    // fracción de muestras que tienen que cambiar
+    int vfr_max_gap_ms;
+    std::vector<uint8_t> samples;
+    std::vector<uint8_t> last_samples;
+    qint64 last_encoded_ms;
+    cv::Mat skipped_frame;   // último omitido: se codifica al cerrar para que la duración sea la real
+    qint64 skipped_ms;
+    qint64 frames_encoded;
+
+    // Archivo actual
+    LibavWriter *writer;
+    QString name;
+    bool writing;
+    qint64 frames_written;
+    int event_count;
+    QElapsedTimer gap_timer;
+    QStringList markers;
+    TrackFileWriter tracks;
+    SpriteSheetBuilder sprites;
+
+    // Encoder de repuesto abierto con un nombre temporal
+    QFuture<LibavWriter *> spare_future;
+
+    // Cierres en curso: esperan a AsyncIO, avisan videoSaved y arman el .kfi
+    QList<QFuture<void>> saving;
+    bool spare_requested;
+    QString spare_path;
+    LibavWriter::Options spare_options;
+    int spare_seq;
+};
@@ -0,0 +1,208 @@
+#include <QCoreApplication>
+#include <QImage>
+#include <QDebug>
+
+#include "utilities.h"
+#include "metrics.h"
+#include "video_recorder.h"
+#include "worker_supervisor.h"
+
+namespace {
+const int MIN_RESTART_DELAY_MS = 200;
+const int MAX_RESTART_DELAY_MS = 5000;
+const int STABLE_AFTER_MS = 30000; // vivo más que esto: el próximo reinicio vuelve a ser rápido
+}
+
+WorkerSupervisor::WorkerSupervisor(const QString &camera_key, QObject *parent) :
+    QObject(parent), camera_key(camera_key), process(nullptr), last_frame(0),
+    restart_delay_ms(MIN_RESTART_DELAY_MS), stopping(false), motion_detecting(false), recording(false)
+{
+    ring_name = QString("/qtvcr-%1-%2").arg(camera_key).arg(QCoreApplication::applicationPid());
+    stall_timeout_ms = Utilities::getParamInt("trabajador_sin_frames_ms", 10000);
+
+    // Se sondea el anillo al ritmo de la pantalla; solo se dibujan frames nuevos
+    poll_timer.setInterval(15);
+    connect(&poll_timer, &QTimer::timeout, this, &WorkerSupervisor::pollFrames);
+    restart_timer.setSingleShot(true);
+    connect(&restart_timer, &QTimer::timeout, this, &WorkerSupervisor::launch);
+}
+
+WorkerSupervisor::~WorkerSupervisor()
+{
+    stop();
+}
+
+bool WorkerSupervisor::enabledInConfig()
+{
+    return Utilities::getParam("trabajadores") == QString("true");
+}
+
+void WorkerSupervisor::start()
+{
+    stopping = false;
+    launch();
+    poll_timer.start();
+}
+
+void WorkerSupervisor::stop()
+{
+    stopping = true;
+    poll_timer.stop();
+    restart_timer.stop();
+    if (process != nullptr)
+    {
+        QProcess *p = process;
+        process = nullptr;
+        disconnect(p, nullptr, this, nullptr);
+
+        // Cerrar stdin le pide al trabajador que termine y cierre la grabación
+        p->closeWriteChannel();
+        if (!p->waitForFinished(5000))
+        {
+            p->kill();
+            p->waitForFinished(1000);
+        }
+        delete p;
+    }
+    ring.close();
+}
+
+void WorkerSupervisor::launch()
+{
+    if (stopping)
+    {
+        return;
+    }
+
+    process = new QProcess(this);
+    // stdout es el protocolo; los mensajes del trabajador (stderr) salen por la consola de la GUI
+    process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    connect(process, &QProcess::readyReadStandardOutput, this, &WorkerSupervisor::readWorkerOutput);
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &WorkerSupervisor::workerFinished);
+
+    QStringList args;
+    args << "source=" + camera_key << "worker" << "ring=" + ring_name;
+    process->start(QCoreApplication::applicationFilePath(), args);
+    running_since.start();
+    qDebug() << "Trabajador de" << camera_key << "iniciado";
+
+    // El estado de la ventana se restaura en el proceso nuevo
+    if (motion_detecting)
+        send("monitor 1");
+    if (recording)
+        send("grabar 1");
+}
+
+void WorkerSupervisor::send(const QString &line)
+{
+    if (process != nullptr && process->state() != QProcess::NotRunning)
+    {
+        process->write((line + "\n").toUtf8());
+    }
+}
+
+void WorkerSupervisor::setMotionDetecting(bool status)
+{
+    motion_detecting = status;
+    send(status ? "monitor 1" : "monitor 0");
+}
+
+void WorkerSupervisor::setRecording(bool status)
+{
+    recording = status;
+    send(status ? "grabar 1" : "grabar 0");
+}
+
+void WorkerSupervisor::calculateFPS()
+{
+    send("fps");
+}
+
+void WorkerSupervisor::readWorkerOutput()
+{
+    while (process != nullptr && process->canReadLine())
+    {
+        QString line = QString::fromUtf8(process->readLine()).trimmed();
+        QString value = line.section(' ', 1);
+        if (line.startsWith("anillo "))
+        {
+            // Segmento nuevo (primer frame o trabajador reiniciado)
+            if (ring.open(value))
+            {
+                last_frame = 0;
+            }
+        }
+        else if (line.startsWith("fps "))
+        {
+            emit fpsChanged(value.toFloat());
+        }
+        else if (line.startsWith("video "))
+        {
+            emit videoSaved(value);
+        }
+    }
+}
+
+void WorkerSupervisor::pollFrames()
+{
+    // Trabajador colgado: sin frames nuevos durante demasiado tiempo
+    if (process != nullptr && process->state() == QProcess::Running &&
+        running_since.elapsed() > stall_timeout_ms &&
+        (!ring.isOpen() || FrameRing::monotonicMs() - ring.heartbeatMs() > stall_timeout_ms))
+    {
+        qWarning() << "El trabajador de" << camera_key << "no publica frames, se reinicia";
+        process->kill();
+        return;
+    }
+
+    FrameRing::View view;
+    if (!ring.latest(view, last_frame))
+    {
+        return;
+    }
+
+    // La imagen apunta a la memoria compartida; la única copia es la de QPixmap
+    QImage image(view.image.data, view.image.cols, view.image.rows, int(view.image.step), QImage::Format_BGR888);
+    QPixmap pixmap = QPixmap::fromImage(image);
+    if (!ring.isValid(view))
+    {
+        // El trabajador reescribió el slot mientras se copiaba: se espera al próximo
+        return;
+    }
+    last_frame = view.frame_number;
+    Metrics::set(camera_key + ".gui_retraso_ms", double(FrameRing::monotonicMs() - view.timestamp_ms));
+    Metrics::writeIfDue();
+    emit frameReady(pixmap);
+}
+
+void WorkerSupervisor::workerFinished(int exit_code, QProcess::ExitStatus status)
+{
+    if (process != nullptr)
+    {
+        process->deleteLater();
+        process = nullptr;
+    }
+    if (stopping)
+    {
+        return;
+    }
+
+    qWarning() << "El trabajador de" << camera_key << "terminó"
+               << (status == QProcess::CrashExit ? "por un fallo" : "con código") << exit_code;
+    Metrics::add(camera_key + ".trabajador_reinicios", 1);
+    // El proceso nuevo tiene otro pid: el archivo de métricas del caído no se actualiza más
+    Metrics::removeStale();
+    VideoRecorder::removeStaleSpares(); // el encoder de repuesto que tenía abierto
+    scheduleRestart();
+}
+
+void WorkerSupervisor::scheduleRestart()
+{
+    if (running_since.elapsed() > STABLE_AFTER_MS)
+    {
+        restart_delay_ms = MIN_RESTART_DELAY_MS;
+    }
+    restart_timer.start(restart_delay_ms);
+    restart_delay_ms = qMin(restart_delay_ms * 2, MAX_RESTART_DELAY_MS);
+}
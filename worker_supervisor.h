@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QObject>
+#include <QProcess>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QPixmap>
+
+#include "frame_ring.h"
+
+// Lado GUI del modo trabajadores ("trabajadores": true en config.cfg).
+//
+// Lanza un proceso "qtvcr source=<cam> worker" por cámara, lee la vista previa
+// del FrameRing que publica y le reenvía los comandos de la ventana. Si el
+// proceso muere o deja de publicar frames (trabajador_sin_frames_ms) se
+// reinicia, con espera creciente si se cae seguido, y se le restaura el
+// estado de monitor/grabación.
+class WorkerSupervisor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WorkerSupervisor(const QString &camera_key, QObject *parent = nullptr);
+    ~WorkerSupervisor();
+
+    static bool enabledInConfig();
+
+    void start();
+    void stop();
+
+    void setMotionDetecting(bool status);
+    void setRecording(bool status);
+    void calculateFPS();
+
+signals:
+    void frameReady(QPixmap image);
+    void fpsChanged(float fps);
+    void videoSaved(QString name);
+
+private slots:
+    void readWorkerOutput();
+    void workerFinished(int exit_code, QProcess::ExitStatus status);
+    void pollFrames();
+    void launch();
+
+private:
+    void send(const QString &line);
+    void scheduleRestart();
+
+    QString camera_key;
+    QString ring_name;
+    QProcess *process;
+    FrameRing ring;
+    uint64_t last_frame;
+    QTimer poll_timer;
+    QTimer restart_timer;
+    QElapsedTimer running_since;
+    int restart_delay_ms;
+    int stall_timeout_ms;
+    bool stopping;
+
+    // Estado a restaurar después de un reinicio
+    bool motion_detecting;
+    bool recording;
+};